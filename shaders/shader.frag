@@ -1,14 +1,25 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
 
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	uint object_id;
+} ubo;
+
 layout(binding = 1) uniform sampler2D tex_sampler;
 
 layout(location = 0) in vec3 frag_color;
 layout(location = 1) in vec2 frag_tex_coord;
 
 layout(location = 0) out vec4 out_color;
+// Dropped when the render pass has no object ID attachment
+layout(location = 1) out uint out_object_id;
 
 void main()
 {
 	out_color = texture(tex_sampler, frag_tex_coord);
+	out_object_id = ubo.object_id;
 }
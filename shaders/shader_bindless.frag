@@ -0,0 +1,27 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+	uint object_id;
+} ubo;
+
+layout(set = 1, binding = 0) uniform sampler2D textures[];
+
+layout(location = 0) in vec3 frag_color;
+layout(location = 1) in vec2 frag_tex_coord;
+layout(location = 2) flat in uint frag_material_index;
+
+layout(location = 0) out vec4 out_color;
+// Dropped when the render pass has no object ID attachment
+layout(location = 1) out uint out_object_id;
+
+void main()
+{
+	out_color = texture(textures[nonuniformEXT(frag_material_index)], frag_tex_coord);
+	out_object_id = ubo.object_id;
+}
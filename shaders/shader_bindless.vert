@@ -0,0 +1,29 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+} ubo;
+
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec3 in_color;
+layout(location = 2) in vec2 in_tex_coord;
+
+layout(location = 0) out vec3 frag_color;
+layout(location = 1) out vec2 frag_tex_coord;
+layout(location = 2) flat out uint frag_material_index;
+
+void main()
+{
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(in_position, 1.0);
+
+	frag_color = in_color;
+
+	frag_tex_coord = in_tex_coord;
+
+	// Indirect draws carry the material index in firstInstance
+	frag_material_index = uint(gl_InstanceIndex);
+}
@@ -0,0 +1,38 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 projection;
+} ubo;
+
+// CompactVertex: unorm position inside the mesh bounds (undone by the model matrix), octahedral normal, half float UV
+layout(location = 0) in vec3 in_position;
+layout(location = 1) in vec2 in_normal;
+layout(location = 2) in vec2 in_tex_coord;
+
+layout(location = 0) out vec3 frag_color;
+layout(location = 1) out vec2 frag_tex_coord;
+layout(location = 3) out vec3 frag_normal;
+
+vec3 DecodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float t = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -t : t;
+	normal.y += normal.y >= 0.0 ? -t : t;
+	return normalize(normal);
+}
+
+void main()
+{
+	gl_Position = ubo.projection * ubo.view * ubo.model * vec4(in_position, 1.0);
+
+	frag_color = vec3(1.0);
+
+	frag_tex_coord = in_tex_coord;
+
+	frag_normal = DecodeOctahedral(in_normal);
+}
@@ -0,0 +1,189 @@
+#include "async_compute.hpp"
+#include "utils.hpp"
+
+vkpg::AsyncCompute::AsyncCompute(VulkanDevice& vulkan_device) : vulkan_device(vulkan_device)
+{
+
+}
+
+void vkpg::AsyncCompute::Create(uint32_t frame_count)
+{
+	supported = vulkan_device.queue_family_indices.compute_family.has_value();
+	frames.clear();
+	if(!supported)
+	{
+		return;
+	}
+
+	VkCommandPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	pool_info.queueFamilyIndex = vulkan_device.queue_family_indices.compute_family.value();
+	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+	auto result = vkCreateCommandPool(vulkan_device.logical_device, &pool_info, nullptr, &command_pool);
+	CheckVkResult(result, "Failed to create compute command pool");
+
+	frames.resize(frame_count);
+
+	std::vector<VkCommandBuffer> command_buffers(frame_count);
+	VkCommandBufferAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.commandPool = command_pool;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandBufferCount = frame_count;
+
+	result = vkAllocateCommandBuffers(vulkan_device.logical_device, &alloc_info, command_buffers.data());
+	CheckVkResult(result, "Failed to allocate compute command buffers");
+
+	VkSemaphoreCreateInfo semaphore_info{};
+	semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+	for(uint32_t i = 0; i < frame_count; i++)
+	{
+		frames[i].command_buffer = command_buffers[i];
+
+		result = vkCreateSemaphore(vulkan_device.logical_device, &semaphore_info, nullptr, &frames[i].semaphore);
+		CheckVkResult(result, "Failed to create compute semaphore");
+	}
+}
+
+void vkpg::AsyncCompute::Cleanup()
+{
+	for(const auto& frame : frames)
+	{
+		vkDestroySemaphore(vulkan_device.logical_device, frame.semaphore, nullptr);
+	}
+	frames.clear();
+
+	// Frees the command buffers with it
+	vkDestroyCommandPool(vulkan_device.logical_device, command_pool, nullptr);
+	command_pool = VK_NULL_HANDLE;
+}
+
+bool vkpg::AsyncCompute::IsSupported() const
+{
+	return supported;
+}
+
+VkCommandBuffer vkpg::AsyncCompute::Begin(uint32_t frame_index)
+{
+	auto command_buffer = frames[frame_index].command_buffer;
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	auto result = vulkan_device.dispatch.begin_command_buffer(command_buffer, &begin_info);
+	CheckVkResult(result, "Failed to begin recording compute command buffer");
+
+	return command_buffer;
+}
+
+void vkpg::AsyncCompute::Submit(uint32_t frame_index)
+{
+	auto& frame = frames[frame_index];
+
+	auto result = vulkan_device.dispatch.end_command_buffer(frame.command_buffer);
+	CheckVkResult(result, "Failed to record compute command buffer");
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &frame.command_buffer;
+	submit_info.signalSemaphoreCount = 1;
+	submit_info.pSignalSemaphores = &frame.semaphore;
+
+	// No fence, the graphics submission waiting on the semaphore finishes after it
+	result = vulkan_device.dispatch.queue_submit(vulkan_device.compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+	CheckVkResult(result, "Failed to submit compute command buffer");
+
+	frame.submitted = true;
+}
+
+VkSemaphore vkpg::AsyncCompute::TakeSemaphore(uint32_t frame_index)
+{
+	if(frames.empty() || !frames[frame_index].submitted)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	frames[frame_index].submitted = false;
+	return frames[frame_index].semaphore;
+}
+
+void vkpg::AsyncCompute::RunOnce(const std::function<void(VkCommandBuffer)>& record)
+{
+	VkCommandBufferAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.commandPool = command_pool;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandBufferCount = 1;
+
+	VkCommandBuffer command_buffer;
+	auto result = vkAllocateCommandBuffers(vulkan_device.logical_device, &alloc_info, &command_buffer);
+	CheckVkResult(result, "Failed to allocate compute command buffer");
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	vulkan_device.dispatch.begin_command_buffer(command_buffer, &begin_info);
+	record(command_buffer);
+	vulkan_device.dispatch.end_command_buffer(command_buffer);
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &command_buffer;
+
+	vulkan_device.dispatch.queue_submit(vulkan_device.compute_queue, 1, &submit_info, VK_NULL_HANDLE);
+	vulkan_device.dispatch.queue_wait_idle(vulkan_device.compute_queue);
+
+	vkFreeCommandBuffers(vulkan_device.logical_device, command_pool, 1, &command_buffer);
+}
+
+void vkpg::AsyncCompute::Release(VkCommandBuffer command_buffer, QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+                                 VkPipelineStageFlags stages, VkAccessFlags access) const
+{
+	// The destination half of a release is ignored, the acquire makes the writes visible
+	auto barriers = GetOwnershipBarriers(transfer, buffers, access, 0);
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, stages, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+	                                            0, nullptr,
+	                                            static_cast<uint32_t>(barriers.size()), barriers.data(),
+	                                            0, nullptr);
+}
+
+void vkpg::AsyncCompute::Acquire(VkCommandBuffer command_buffer, QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+                                 VkPipelineStageFlags stages, VkAccessFlags access) const
+{
+	// And the source half of an acquire, the semaphore wait orders it after the release
+	auto barriers = GetOwnershipBarriers(transfer, buffers, 0, access);
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, stages, 0,
+	                                            0, nullptr,
+	                                            static_cast<uint32_t>(barriers.size()), barriers.data(),
+	                                            0, nullptr);
+}
+
+std::vector<VkBufferMemoryBarrier> vkpg::AsyncCompute::GetOwnershipBarriers(QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+                                                                            VkAccessFlags source_access, VkAccessFlags destination_access) const
+{
+	auto graphics_family = vulkan_device.queue_family_indices.graphics_family.value();
+	auto compute_family = vulkan_device.queue_family_indices.compute_family.value();
+	bool to_compute = transfer == QueueTransfer::GraphicsToCompute;
+
+	std::vector<VkBufferMemoryBarrier> barriers;
+	for(auto buffer : buffers)
+	{
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = source_access;
+		barrier.dstAccessMask = destination_access;
+		barrier.srcQueueFamilyIndex = to_compute ? graphics_family : compute_family;
+		barrier.dstQueueFamilyIndex = to_compute ? compute_family : graphics_family;
+		barrier.buffer = buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barriers.push_back(barrier);
+	}
+	return barriers;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace vkpg
+{
+
+// Direction of a queue family ownership transfer
+enum class QueueTransfer
+{
+	GraphicsToCompute,
+	ComputeToGraphics
+};
+
+// Compute work on the device's dedicated compute queue. Every swap chain image has a command buffer that is
+// submitted ahead of the image's graphics work and signals a semaphore the graphics submission waits on, so the
+// compute work can overlap whatever graphics work is still running from earlier frames.
+//
+// Exclusive resources keep their contents across the queues only through an ownership transfer: a release on the
+// queue giving them up and a matching acquire on the queue taking them, ordered by a semaphore or a host wait.
+class AsyncCompute
+{
+public:
+	explicit AsyncCompute(vkpg::VulkanDevice& vulkan_device);
+
+	void Create(uint32_t frame_count);
+	void Cleanup();
+
+	// False without a dedicated compute queue family
+	bool IsSupported() const;
+
+	// Begins the frame's command buffer, the frame's previous graphics submission has to have finished
+	VkCommandBuffer Begin(uint32_t frame_index);
+	// Submits the frame's command buffer, has to happen before the graphics submission that waits on it
+	void Submit(uint32_t frame_index);
+	// The semaphore the frame's graphics submission has to wait on, VK_NULL_HANDLE if nothing was submitted for
+	// the frame since the last call
+	VkSemaphore TakeSemaphore(uint32_t frame_index);
+
+	// Records commands into a new command buffer, runs it on the compute queue and waits for it
+	void RunOnce(const std::function<void(VkCommandBuffer)>& record);
+
+	// Release after the last access on the queue giving the buffers up, stages and access are that last access
+	void Release(VkCommandBuffer command_buffer, vkpg::QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+	             VkPipelineStageFlags stages, VkAccessFlags access) const;
+	// Acquire before the first access on the queue taking the buffers, stages and access are that first access
+	void Acquire(VkCommandBuffer command_buffer, vkpg::QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+	             VkPipelineStageFlags stages, VkAccessFlags access) const;
+
+private:
+	struct Frame
+	{
+		VkCommandBuffer command_buffer{VK_NULL_HANDLE};
+		VkSemaphore semaphore{VK_NULL_HANDLE};
+		bool submitted = false;
+	};
+
+	std::vector<VkBufferMemoryBarrier> GetOwnershipBarriers(vkpg::QueueTransfer transfer, const std::vector<VkBuffer>& buffers,
+	                                                        VkAccessFlags source_access, VkAccessFlags destination_access) const;
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	VkCommandPool command_pool{VK_NULL_HANDLE};
+	std::vector<Frame> frames;
+	bool supported = false;
+};
+
+} // namespace vkpg
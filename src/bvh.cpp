@@ -0,0 +1,450 @@
+#include "bvh.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace
+{
+
+// Distance along the ray to where it enters the box, FLT_MAX on a miss
+float IntersectAabb(const vkpg::Aabb& bounds, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance)
+{
+	auto t0 = (bounds.min - origin) * inverse_direction;
+	auto t1 = (bounds.max - origin) * inverse_direction;
+
+	auto t_near = glm::min(t0, t1);
+	auto t_far = glm::max(t0, t1);
+
+	auto enter = std::max(std::max(t_near.x, t_near.y), std::max(t_near.z, 0.0f));
+	auto exit = std::min(std::min(t_far.x, t_far.y), std::min(t_far.z, max_distance));
+
+	return enter <= exit ? enter : FLT_MAX;
+}
+
+} // namespace
+
+void vkpg::Aabb::Grow(const glm::vec3& point)
+{
+	min = glm::min(min, point);
+	max = glm::max(max, point);
+}
+
+void vkpg::Aabb::Grow(const Aabb& bounds)
+{
+	min = glm::min(min, bounds.min);
+	max = glm::max(max, bounds.max);
+}
+
+glm::vec3 vkpg::Aabb::GetCenter() const
+{
+	return (min + max) * 0.5f;
+}
+
+float vkpg::Aabb::GetSurfaceArea() const
+{
+	if(max.x < min.x)
+	{
+		return 0.0f;
+	}
+
+	auto extent = max - min;
+	return 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+vkpg::Aabb vkpg::Aabb::Transform(const glm::mat4& transform) const
+{
+	auto center = glm::vec3(transform * glm::vec4(GetCenter(), 1.0f));
+	auto half_extent = (max - min) * 0.5f;
+
+	// Each axis of the new box gets the absolute contributions of all the old axes
+	glm::mat3 basis(transform);
+	auto new_half_extent = glm::abs(basis[0]) * half_extent.x + glm::abs(basis[1]) * half_extent.y + glm::abs(basis[2]) * half_extent.z;
+
+	return {center - new_half_extent, center + new_half_extent};
+}
+
+void vkpg::Bvh::Build(const std::vector<Aabb>& primitive_bounds)
+{
+	auto primitive_count = static_cast<uint32_t>(primitive_bounds.size());
+
+	nodes.clear();
+	primitive_indices.clear();
+	leaf_bounds.clear();
+
+	if(primitive_count == 0)
+	{
+		return;
+	}
+
+	// Partitioned in place while building, so binning walks memory linearly instead of jumping through indices
+	struct BuildPrimitive
+	{
+		Aabb bounds;
+		glm::vec3 center;
+		uint32_t index;
+	};
+
+	std::vector<BuildPrimitive> primitives(primitive_count);
+	for(uint32_t i = 0; i < primitive_count; i++)
+	{
+		primitives[i] = {primitive_bounds[i], primitive_bounds[i].GetCenter(), i};
+	}
+
+	auto NodeBounds = [&](uint32_t first, uint32_t count)
+	{
+		Aabb bounds;
+		for(uint32_t i = first; i < first + count; i++)
+		{
+			bounds.Grow(primitives[i].bounds);
+		}
+		return bounds;
+	};
+
+	// A binary tree with one primitive per leaf has 2n - 1 nodes
+	nodes.reserve(2 * static_cast<size_t>(primitive_count) - 1);
+
+	Node root;
+	root.first = 0;
+	root.count = primitive_count;
+	root.bounds = NodeBounds(root.first, root.count);
+	nodes.push_back(root);
+
+	std::vector<uint32_t> stack{0};
+	while(!stack.empty())
+	{
+		auto node_index = stack.back();
+		stack.pop_back();
+
+		auto node = nodes[node_index];
+		if(node.count <= 2)
+		{
+			continue;
+		}
+
+		auto begin = primitives.begin() + node.first;
+		auto end = begin + node.count;
+
+		Aabb centroid_bounds;
+		for(auto it = begin; it != end; it++)
+		{
+			centroid_bounds.Grow(it->center);
+		}
+		auto extent = centroid_bounds.max - centroid_bounds.min;
+
+		struct Bin
+		{
+			Aabb bounds;
+			uint32_t count = 0;
+		};
+
+		// All three axes are binned in the same pass over the primitives
+		std::array<std::array<Bin, bin_count>, 3> bins{};
+		glm::vec3 scale(0.0f);
+		for(int axis = 0; axis < 3; axis++)
+		{
+			scale[axis] = extent[axis] > 0.0f ? bin_count / extent[axis] : 0.0f;
+		}
+
+		auto BinIndex = [&](const glm::vec3& center, int axis)
+		{
+			return std::min(bin_count - 1, static_cast<uint32_t>((center[axis] - centroid_bounds.min[axis]) * scale[axis]));
+		};
+
+		for(auto it = begin; it != end; it++)
+		{
+			for(int axis = 0; axis < 3; axis++)
+			{
+				auto& bin = bins[axis][BinIndex(it->center, axis)];
+				bin.count++;
+				bin.bounds.Grow(it->bounds);
+			}
+		}
+
+		auto best_cost = FLT_MAX;
+		int best_axis = -1;
+		uint32_t best_split = 0;
+
+		for(int axis = 0; axis < 3; axis++)
+		{
+			if(extent[axis] <= 0.0f)
+			{
+				continue;
+			}
+
+			// Left side costs of every split plane, then the right sides are swept back to front
+			std::array<float, bin_count - 1> left_costs;
+			std::array<uint32_t, bin_count - 1> left_counts;
+			Aabb left_bounds;
+			uint32_t left_count = 0;
+			for(uint32_t i = 0; i < bin_count - 1; i++)
+			{
+				left_bounds.Grow(bins[axis][i].bounds);
+				left_count += bins[axis][i].count;
+				left_costs[i] = left_count * left_bounds.GetSurfaceArea();
+				left_counts[i] = left_count;
+			}
+
+			Aabb right_bounds;
+			uint32_t right_count = 0;
+			for(uint32_t i = bin_count - 1; i > 0; i--)
+			{
+				right_bounds.Grow(bins[axis][i].bounds);
+				right_count += bins[axis][i].count;
+
+				auto cost = left_costs[i - 1] + right_count * right_bounds.GetSurfaceArea();
+				if(left_counts[i - 1] > 0 && right_count > 0 && cost < best_cost)
+				{
+					best_cost = cost;
+					best_axis = axis;
+					best_split = i;
+				}
+			}
+		}
+
+		// Splitting only pays off if it is cheaper than testing every primitive of the node
+		auto leaf_cost = node.count * node.bounds.GetSurfaceArea();
+		if(node.count <= max_leaf_size && (best_axis < 0 || best_cost >= leaf_cost))
+		{
+			continue;
+		}
+
+		Node left;
+		Node right;
+		left.first = node.first;
+
+		if(best_axis >= 0)
+		{
+			auto middle = std::partition(begin, end, [&](const BuildPrimitive& primitive)
+			{
+				return BinIndex(primitive.center, best_axis) < best_split;
+			});
+			left.count = static_cast<uint32_t>(middle - begin);
+
+			// The bins on either side of the split hold exactly the children's primitives
+			for(uint32_t i = 0; i < bin_count; i++)
+			{
+				(i < best_split ? left : right).bounds.Grow(bins[best_axis][i].bounds);
+			}
+		}
+		else
+		{
+			// All centroids in one spot, any split by count is as good as another
+			left.count = node.count / 2;
+			left.bounds = NodeBounds(left.first, left.count);
+			right.bounds = NodeBounds(left.first + left.count, node.count - left.count);
+		}
+
+		right.first = node.first + left.count;
+		right.count = node.count - left.count;
+
+		auto left_index = static_cast<uint32_t>(nodes.size());
+		nodes.push_back(left);
+		nodes.push_back(right);
+
+		nodes[node_index].first = left_index;
+		nodes[node_index].count = 0;
+
+		stack.push_back(left_index);
+		stack.push_back(left_index + 1);
+	}
+
+	primitive_indices.resize(primitive_count);
+	leaf_bounds.resize(primitive_count);
+	for(uint32_t i = 0; i < primitive_count; i++)
+	{
+		primitive_indices[i] = primitives[i].index;
+		leaf_bounds[i] = primitives[i].bounds;
+	}
+}
+
+void vkpg::Bvh::Refit(const std::vector<Aabb>& primitive_bounds)
+{
+	if(primitive_bounds.size() != primitive_indices.size())
+	{
+		throw std::invalid_argument("BVH refit needs as many primitives as it was built with");
+	}
+
+	for(size_t i = 0; i < primitive_indices.size(); i++)
+	{
+		leaf_bounds[i] = primitive_bounds[primitive_indices[i]];
+	}
+
+	for(size_t i = nodes.size(); i-- > 0;)
+	{
+		auto& node = nodes[i];
+		if(node.count > 0)
+		{
+			UpdateNodeBounds(node, primitive_bounds);
+		}
+		else
+		{
+			node.bounds = nodes[node.first].bounds;
+			node.bounds.Grow(nodes[node.first + 1].bounds);
+		}
+	}
+}
+
+void vkpg::Bvh::QueryFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& primitives) const
+{
+	if(nodes.empty())
+	{
+		return;
+	}
+
+	enum class Containment { outside, intersecting, inside };
+
+	auto Classify = [&](const Aabb& bounds)
+	{
+		auto containment = Containment::inside;
+		for(const auto& plane : planes)
+		{
+			auto normal = glm::vec3(plane);
+
+			// The corners furthest along and against the plane normal
+			auto positive = glm::vec3(normal.x >= 0.0f ? bounds.max.x : bounds.min.x,
+			                          normal.y >= 0.0f ? bounds.max.y : bounds.min.y,
+			                          normal.z >= 0.0f ? bounds.max.z : bounds.min.z);
+			auto negative = bounds.min + bounds.max - positive;
+
+			if(glm::dot(normal, positive) + plane.w < 0.0f)
+			{
+				return Containment::outside;
+			}
+			if(glm::dot(normal, negative) + plane.w < 0.0f)
+			{
+				containment = Containment::intersecting;
+			}
+		}
+
+		return containment;
+	};
+
+	// Subtrees fully inside the frustum are collected without testing them any further
+	std::vector<std::pair<uint32_t, bool>> stack;
+	stack.reserve(64);
+	stack.emplace_back(0, false);
+
+	while(!stack.empty())
+	{
+		auto [node_index, inside] = stack.back();
+		stack.pop_back();
+
+		const auto& node = nodes[node_index];
+		if(!inside)
+		{
+			auto containment = Classify(node.bounds);
+			if(containment == Containment::outside)
+			{
+				continue;
+			}
+			inside = containment == Containment::inside;
+		}
+
+		if(node.count == 0)
+		{
+			stack.emplace_back(node.first, inside);
+			stack.emplace_back(node.first + 1, inside);
+			continue;
+		}
+
+		for(uint32_t i = node.first; i < node.first + node.count; i++)
+		{
+			if(inside || Classify(leaf_bounds[i]) != Containment::outside)
+			{
+				primitives.push_back(primitive_indices[i]);
+			}
+		}
+	}
+}
+
+std::optional<vkpg::RayHit> vkpg::Bvh::Raycast(const Ray& ray, float max_distance) const
+{
+	if(nodes.empty())
+	{
+		return std::nullopt;
+	}
+
+	// Zero components become infinities, which the slab test handles
+	auto inverse_direction = 1.0f / ray.direction;
+
+	std::optional<RayHit> hit;
+	auto closest = max_distance;
+
+	std::vector<std::pair<uint32_t, float>> stack;
+	stack.reserve(64);
+
+	auto root_distance = IntersectAabb(nodes.front().bounds, ray.origin, inverse_direction, closest);
+	if(root_distance != FLT_MAX)
+	{
+		stack.emplace_back(0, root_distance);
+	}
+
+	while(!stack.empty())
+	{
+		auto [node_index, distance] = stack.back();
+		stack.pop_back();
+
+		// Something closer was found since the node was pushed
+		if(distance > closest)
+		{
+			continue;
+		}
+
+		const auto& node = nodes[node_index];
+		if(node.count > 0)
+		{
+			for(uint32_t i = node.first; i < node.first + node.count; i++)
+			{
+				auto primitive_distance = IntersectAabb(leaf_bounds[i], ray.origin, inverse_direction, closest);
+				if(primitive_distance != FLT_MAX && (!hit || primitive_distance < closest))
+				{
+					closest = primitive_distance;
+					hit = RayHit{primitive_indices[i], primitive_distance};
+				}
+			}
+			continue;
+		}
+
+		auto left_distance = IntersectAabb(nodes[node.first].bounds, ray.origin, inverse_direction, closest);
+		auto right_distance = IntersectAabb(nodes[node.first + 1].bounds, ray.origin, inverse_direction, closest);
+
+		// The nearer child goes on top so it is visited first and can prune the other one
+		std::pair<uint32_t, float> near_child{node.first, left_distance};
+		std::pair<uint32_t, float> far_child{node.first + 1, right_distance};
+		if(right_distance < left_distance)
+		{
+			std::swap(near_child, far_child);
+		}
+
+		if(far_child.second != FLT_MAX)
+		{
+			stack.push_back(far_child);
+		}
+		if(near_child.second != FLT_MAX)
+		{
+			stack.push_back(near_child);
+		}
+	}
+
+	return hit;
+}
+
+size_t vkpg::Bvh::GetNodeCount() const
+{
+	return nodes.size();
+}
+
+bool vkpg::Bvh::IsEmpty() const
+{
+	return nodes.empty();
+}
+
+void vkpg::Bvh::UpdateNodeBounds(Node& node, const std::vector<Aabb>& primitive_bounds) const
+{
+	node.bounds = Aabb{};
+	for(uint32_t i = node.first; i < node.first + node.count; i++)
+	{
+		node.bounds.Grow(primitive_bounds[primitive_indices[i]]);
+	}
+}
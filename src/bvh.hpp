@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cfloat>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace vkpg
+{
+
+struct Aabb
+{
+	glm::vec3 min{FLT_MAX};
+	glm::vec3 max{-FLT_MAX};
+
+	void Grow(const glm::vec3& point);
+	void Grow(const Aabb& bounds);
+
+	glm::vec3 GetCenter() const;
+	float GetSurfaceArea() const;
+
+	// Bounds of the transformed box, a little larger than the transformed contents for rotations
+	Aabb Transform(const glm::mat4& transform) const;
+};
+
+struct Ray
+{
+	glm::vec3 origin{0.0f};
+	// Doesn't need to be normalized, hit distances are in multiples of it
+	glm::vec3 direction{0.0f, 0.0f, -1.0f};
+};
+
+struct RayHit
+{
+	uint32_t primitive = 0;
+	// Where the ray enters the primitive's bounds, 0 if it starts inside
+	float distance = 0.0f;
+};
+
+// Bounding volume hierarchy over primitive bounds, built top down with binned SAH. Children are stored after
+// their parent, so a refit is one backwards pass over the nodes.
+class Bvh
+{
+public:
+	void Build(const std::vector<Aabb>& primitive_bounds);
+
+	// Updates the node bounds for moved primitives without changing the tree, the count has to stay the same.
+	// Quality degrades as primitives move far from where they were at build time.
+	void Refit(const std::vector<Aabb>& primitive_bounds);
+
+	// Appends the primitives whose bounds are not fully outside one of the planes (xyz pointing inside)
+	void QueryFrustum(const std::array<glm::vec4, 6>& planes, std::vector<uint32_t>& primitives) const;
+
+	// Nearest primitive whose bounds the ray hits before max_distance
+	std::optional<RayHit> Raycast(const Ray& ray, float max_distance = FLT_MAX) const;
+
+	size_t GetNodeCount() const;
+	bool IsEmpty() const;
+
+private:
+	static constexpr uint32_t bin_count = 16;
+	static constexpr uint32_t max_leaf_size = 8;
+
+	struct Node
+	{
+		Aabb bounds;
+		// Leaves: primitive_indices[first, first + count), interior nodes: children first and first + 1, count 0
+		uint32_t first = 0;
+		uint32_t count = 0;
+	};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> primitive_indices;
+	// Primitive bounds in primitive_indices order, so a leaf's bounds are contiguous
+	std::vector<Aabb> leaf_bounds;
+
+	void UpdateNodeBounds(Node& node, const std::vector<Aabb>& primitive_bounds) const;
+};
+
+} // namespace vkpg
@@ -20,6 +20,30 @@ float vkpg::Camera::GetFarClip() const
 	return z_far;
 }
 
+float vkpg::Camera::GetFov() const
+{
+	return fov;
+}
+
+glm::vec3 vkpg::Camera::GetEyePosition() const
+{
+	return glm::vec3(glm::inverse(matrices.view)[3]);
+}
+
+std::array<glm::vec4, 6> vkpg::Camera::GetFrustumPlanes() const
+{
+	// Rows of the view projection matrix, clip space depth is 0..1
+	auto m = glm::transpose(matrices.perspective * matrices.view);
+
+	std::array<glm::vec4, 6> planes{{m[3] + m[0], m[3] - m[0], m[3] + m[1], m[3] - m[1], m[2], m[3] - m[2]}};
+	for(auto& plane : planes)
+	{
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return planes;
+}
+
 void vkpg::Camera::SetPerspective(float fov, float aspect, float znear, float zfar)
 {
 	this->fov = fov;
@@ -2,6 +2,7 @@
 
 #include <glm/glm.hpp>
 
+#include <array>
 #include <chrono>
 
 namespace vkpg
@@ -43,6 +44,14 @@ public:
 
 	float GetNearClip() const;
 	float GetFarClip() const;
+	// Vertical field of view in degrees
+	float GetFov() const;
+
+	// position is the view translation, this is where the eye actually is in world space
+	glm::vec3 GetEyePosition() const;
+
+	// World space frustum planes (left, right, bottom, top, near, far), xyz normalized and pointing inside
+	std::array<glm::vec4, 6> GetFrustumPlanes() const;
 
 	void SetPerspective(float fov, float aspect, float znear, float zfar);
 
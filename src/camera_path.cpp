@@ -0,0 +1,142 @@
+#include "camera_path.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+vkpg::CameraPath vkpg::CameraPath::Load(const std::string& path)
+{
+	std::ifstream file(path);
+	if(!file)
+	{
+		throw std::runtime_error("Failed to open camera path " + path);
+	}
+
+	CameraPath camera_path;
+
+	std::string line;
+	for(uint32_t line_number = 1; std::getline(file, line); line_number++)
+	{
+		// Empty lines and comments
+		auto first = line.find_first_not_of(" \t\r");
+		if(first == std::string::npos || line[first] == '#')
+		{
+			continue;
+		}
+
+		std::istringstream stream(line);
+		Keyframe keyframe;
+		stream >> keyframe.time
+		       >> keyframe.position.x >> keyframe.position.y >> keyframe.position.z
+		       >> keyframe.rotation.x >> keyframe.rotation.y >> keyframe.rotation.z;
+
+		if(!stream)
+		{
+			throw std::runtime_error("Malformed keyframe in " + path + ":" + std::to_string(line_number));
+		}
+		if(!camera_path.keyframes.empty() && keyframe.time <= camera_path.keyframes.back().time)
+		{
+			throw std::runtime_error("Keyframe times don't increase in " + path + ":" + std::to_string(line_number));
+		}
+
+		camera_path.keyframes.push_back(keyframe);
+	}
+
+	return camera_path;
+}
+
+void vkpg::CameraPath::Save(const std::string& path) const
+{
+	std::ofstream file(path);
+	if(!file)
+	{
+		throw std::runtime_error("Failed to write camera path " + path);
+	}
+
+	// Enough digits to read back the same floats
+	file << std::setprecision(9);
+	file << "# time position.x position.y position.z rotation.x rotation.y rotation.z\n";
+	for(const auto& keyframe : keyframes)
+	{
+		file << keyframe.time << ' '
+		     << keyframe.position.x << ' ' << keyframe.position.y << ' ' << keyframe.position.z << ' '
+		     << keyframe.rotation.x << ' ' << keyframe.rotation.y << ' ' << keyframe.rotation.z << '\n';
+	}
+}
+
+void vkpg::CameraPath::AddKeyframe(const Keyframe& keyframe)
+{
+	if(!keyframes.empty() && keyframe.time <= keyframes.back().time)
+	{
+		throw std::invalid_argument("Keyframes have to be added in time order");
+	}
+
+	keyframes.push_back(keyframe);
+}
+
+bool vkpg::CameraPath::IsEmpty() const
+{
+	return keyframes.empty();
+}
+
+size_t vkpg::CameraPath::GetKeyframeCount() const
+{
+	return keyframes.size();
+}
+
+const vkpg::CameraPath::Keyframe& vkpg::CameraPath::GetKeyframe(size_t index) const
+{
+	return keyframes[index];
+}
+
+float vkpg::CameraPath::GetDuration() const
+{
+	return keyframes.empty() ? 0.0f : keyframes.back().time - keyframes.front().time;
+}
+
+vkpg::CameraPath::Keyframe vkpg::CameraPath::Sample(float time) const
+{
+	if(keyframes.empty())
+	{
+		return {};
+	}
+
+	auto start_time = keyframes.front().time;
+	time += start_time;
+	if(time <= start_time || time >= keyframes.back().time)
+	{
+		auto keyframe = time <= start_time ? keyframes.front() : keyframes.back();
+		keyframe.time -= start_time;
+		return keyframe;
+	}
+
+	// First keyframe after the time, there is always one before it
+	auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time, [](float time, const Keyframe& keyframe)
+	{
+		return time < keyframe.time;
+	});
+	auto index = static_cast<size_t>(next - keyframes.begin()) - 1;
+
+	const auto& a = keyframes[index];
+	const auto& b = keyframes[index + 1];
+	auto t = (time - a.time) / (b.time - a.time);
+
+	// The end points are repeated for the outer tangents
+	const auto& p0 = keyframes[index > 0 ? index - 1 : index].position;
+	const auto& p3 = keyframes[std::min(index + 2, keyframes.size() - 1)].position;
+	const auto& p1 = a.position;
+	const auto& p2 = b.position;
+
+	auto t2 = t * t;
+	auto t3 = t2 * t;
+
+	Keyframe keyframe;
+	keyframe.time = time - start_time;
+	keyframe.position = 0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+	                            (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3);
+	keyframe.rotation = glm::mix(a.rotation, b.rotation, t);
+
+	return keyframe;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+
+namespace vkpg
+{
+
+// Camera keyframes for repeatable fly-throughs. Positions and rotations are the Camera's own values, so a path
+// recorded from live input plays back exactly. Stored as text, one "time px py pz rx ry rz" line per keyframe.
+class CameraPath
+{
+public:
+	struct Keyframe
+	{
+		// Seconds, increasing along the path
+		float time = 0.0f;
+		glm::vec3 position{0.0f};
+		// Degrees, as in Camera::SetRotation
+		glm::vec3 rotation{0.0f};
+	};
+
+	// Throws if the file can't be read or a line is malformed
+	static CameraPath Load(const std::string& path);
+	void Save(const std::string& path) const;
+
+	// Has to be later than the last keyframe
+	void AddKeyframe(const Keyframe& keyframe);
+
+	bool IsEmpty() const;
+	size_t GetKeyframeCount() const;
+	const Keyframe& GetKeyframe(size_t index) const;
+	float GetDuration() const;
+
+	// Time in seconds since the first keyframe, clamped to the path. Catmull-Rom through the positions and
+	// linear between rotations.
+	Keyframe Sample(float time) const;
+
+private:
+	std::vector<Keyframe> keyframes;
+};
+
+} // namespace vkpg
@@ -0,0 +1,428 @@
+#include "capture.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace
+{
+
+uint32_t Crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+	static const auto table = []
+	{
+		std::array<uint32_t, 256> table{};
+		for(uint32_t i = 0; i < 256; i++)
+		{
+			auto value = i;
+			for(int bit = 0; bit < 8; bit++)
+			{
+				value = value & 1 ? 0xedb88320u ^ (value >> 1) : value >> 1;
+			}
+			table[i] = value;
+		}
+		return table;
+	}();
+
+	crc = ~crc;
+	for(size_t i = 0; i < size; i++)
+	{
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return ~crc;
+}
+
+void AppendBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(static_cast<uint8_t>(value >> 24));
+	out.push_back(static_cast<uint8_t>(value >> 16));
+	out.push_back(static_cast<uint8_t>(value >> 8));
+	out.push_back(static_cast<uint8_t>(value));
+}
+
+void AppendChunk(std::vector<uint8_t>& out, const char *type, const std::vector<uint8_t>& data)
+{
+	AppendBigEndian(out, static_cast<uint32_t>(data.size()));
+	auto type_begin = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	AppendBigEndian(out, Crc32(out.data() + type_begin, out.size() - type_begin));
+}
+
+// 8 bit RGB PNG. The zlib stream uses stored blocks, encoding speed matters more than size for frame sequences.
+std::vector<uint8_t> EncodePng(const uint8_t *pixels, uint32_t width, uint32_t height, bool bgra)
+{
+	// Each row starts with filter type 0, alpha is dropped, swap chain images are opaque
+	std::vector<uint8_t> raw;
+	raw.reserve(static_cast<size_t>(width * 3 + 1) * height);
+	for(uint32_t y = 0; y < height; y++)
+	{
+		raw.push_back(0);
+		auto row = pixels + static_cast<size_t>(y) * width * 4;
+		for(uint32_t x = 0; x < width; x++)
+		{
+			auto pixel = row + x * 4;
+			raw.push_back(bgra ? pixel[2] : pixel[0]);
+			raw.push_back(pixel[1]);
+			raw.push_back(bgra ? pixel[0] : pixel[2]);
+		}
+	}
+
+	constexpr size_t max_block_size = 65535;
+
+	std::vector<uint8_t> zlib;
+	zlib.reserve(raw.size() + raw.size() / max_block_size * 5 + 16);
+	zlib.push_back(0x78);
+	zlib.push_back(0x01);
+
+	uint32_t adler_a = 1;
+	uint32_t adler_b = 0;
+	for(size_t offset = 0; offset == 0 || offset < raw.size(); offset += max_block_size)
+	{
+		auto block_size = std::min(max_block_size, raw.size() - offset);
+		auto last = offset + block_size == raw.size();
+
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(static_cast<uint8_t>(block_size));
+		zlib.push_back(static_cast<uint8_t>(block_size >> 8));
+		zlib.push_back(static_cast<uint8_t>(~block_size));
+		zlib.push_back(static_cast<uint8_t>(~block_size >> 8));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + block_size);
+
+		for(size_t i = offset; i < offset + block_size; i++)
+		{
+			adler_a = (adler_a + raw[i]) % 65521;
+			adler_b = (adler_b + adler_a) % 65521;
+		}
+	}
+	AppendBigEndian(zlib, (adler_b << 16) | adler_a);
+
+	std::vector<uint8_t> header;
+	AppendBigEndian(header, width);
+	AppendBigEndian(header, height);
+	header.push_back(8); // Bit depth
+	header.push_back(2); // RGB
+	header.push_back(0);
+	header.push_back(0);
+	header.push_back(0);
+
+	std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	AppendChunk(png, "IHDR", header);
+	AppendChunk(png, "IDAT", zlib);
+	AppendChunk(png, "IEND", {});
+
+	return png;
+}
+
+} // namespace
+
+vkpg::FrameCapture::FrameCapture(VulkanDevice& vulkan_device) : vulkan_device(vulkan_device)
+{
+	writer = std::thread(&FrameCapture::WriterLoop, this);
+}
+
+vkpg::FrameCapture::~FrameCapture()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	condition.notify_one();
+	writer.join();
+}
+
+void vkpg::FrameCapture::Create(uint32_t frame_count, VkExtent2D extent, VkFormat format)
+{
+	this->extent = extent;
+
+	switch(format)
+	{
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+		bgra = true;
+		supported = true;
+		break;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_A8B8G8R8_UNORM_PACK32:
+	case VK_FORMAT_A8B8G8R8_SRGB_PACK32:
+		bgra = false;
+		supported = true;
+		break;
+	default:
+		std::cout << "Frame capture: swap chain format " << format << " is not supported" << std::endl;
+		supported = false;
+		return;
+	}
+
+	// Cached memory makes reading the copies on the CPU a lot faster where it exists
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(vulkan_device.physical_device, &memory_properties);
+
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if((memory_properties.memoryTypes[i].propertyFlags & (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT)) ==
+		   (properties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT))
+		{
+			properties |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		}
+	}
+
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	frames.resize(frame_count);
+	for(auto& frame : frames)
+	{
+		vulkan_device.CreateBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, properties, frame.buffer, frame.memory);
+
+		void *data;
+		vulkan_device.dispatch.map_memory(vulkan_device.logical_device, frame.memory, 0, size, 0, &data);
+		frame.data = static_cast<const uint8_t*>(data);
+		frame.path.clear();
+	}
+}
+
+void vkpg::FrameCapture::Cleanup()
+{
+	for(auto& frame : frames)
+	{
+		QueueFrame(frame);
+
+		vkDestroyBuffer(vulkan_device.logical_device, frame.buffer, nullptr);
+		vkFreeMemory(vulkan_device.logical_device, frame.memory, nullptr);
+	}
+	frames.clear();
+	supported = false;
+}
+
+bool vkpg::FrameCapture::IsSupported() const
+{
+	return supported;
+}
+
+uint32_t vkpg::FrameCapture::RequestScreenshot(const std::string& path)
+{
+	auto ticket = next_ticket++;
+	if(!supported)
+	{
+		FinishScreenshot(ticket, false);
+		return ticket;
+	}
+
+	if(screenshot_ticket != 0)
+	{
+		FinishScreenshot(screenshot_ticket, false);
+	}
+
+	screenshot_path = path;
+	screenshot_ticket = ticket;
+	return ticket;
+}
+
+std::optional<bool> vkpg::FrameCapture::GetScreenshotResult(uint32_t ticket)
+{
+	std::lock_guard lock(mutex);
+	auto result = screenshot_results.find(ticket);
+	if(result == screenshot_results.end())
+	{
+		return std::nullopt;
+	}
+
+	return result->second;
+}
+
+void vkpg::FrameCapture::FinishScreenshot(uint32_t ticket, bool written)
+{
+	std::lock_guard lock(mutex);
+	screenshot_results[ticket] = written;
+}
+
+void vkpg::FrameCapture::StartSequence(const std::string& directory)
+{
+	std::filesystem::create_directories(directory);
+	sequence_directory = directory;
+	sequence_frame = 0;
+}
+
+void vkpg::FrameCapture::StopSequence()
+{
+	sequence_directory.clear();
+}
+
+bool vkpg::FrameCapture::IsRecordingSequence() const
+{
+	return !sequence_directory.empty();
+}
+
+bool vkpg::FrameCapture::WantsFrame() const
+{
+	return supported && (!screenshot_path.empty() || !sequence_directory.empty());
+}
+
+void vkpg::FrameCapture::Record(VkCommandBuffer command_buffer, uint32_t frame_index, VkImage image, VkImageLayout layout)
+{
+	if(!WantsFrame())
+	{
+		return;
+	}
+
+	auto& frame = frames[frame_index];
+	if(!screenshot_path.empty())
+	{
+		frame.path = screenshot_path;
+		frame.ticket = screenshot_ticket;
+		screenshot_path.clear();
+		screenshot_ticket = 0;
+	}
+	else
+	{
+		frame.ticket = 0;
+		std::array<char, 32> name;
+		std::snprintf(name.data(), name.size(), "frame_%05u.png", sequence_frame++);
+		frame.path = (std::filesystem::path(sequence_directory) / name.data()).string();
+	}
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.oldLayout = layout;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer,
+	                     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = {0, 0, 0};
+	region.imageExtent = {extent.width, extent.height, 1};
+
+	vulkan_device.dispatch.cmd_copy_image_to_buffer(command_buffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.buffer, 1, &region);
+
+	// Back for the UI render pass or presenting, and the copy made visible to the host read after the fence
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	barrier.newLayout = layout;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	VkMemoryBarrier host_barrier{};
+	host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer,
+	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0,
+	                     1, &host_barrier,
+	                     0, nullptr,
+	                     1, &barrier);
+}
+
+void vkpg::FrameCapture::CollectResults(uint32_t frame_index)
+{
+	if(frame_index < frames.size())
+	{
+		QueueFrame(frames[frame_index]);
+	}
+}
+
+void vkpg::FrameCapture::QueueFrame(Frame& frame)
+{
+	if(frame.path.empty())
+	{
+		return;
+	}
+
+	Job job;
+	job.path = std::move(frame.path);
+	job.width = extent.width;
+	job.height = extent.height;
+	job.bgra = bgra;
+	job.ticket = frame.ticket;
+	frame.path.clear();
+	frame.ticket = 0;
+
+	bool dropped = false;
+	{
+		std::lock_guard lock(mutex);
+		dropped = jobs.size() >= max_queued_frames;
+	}
+
+	if(dropped)
+	{
+		skipped_frames++;
+		if(job.ticket != 0)
+		{
+			FinishScreenshot(job.ticket, false);
+		}
+		return;
+	}
+
+	// Copied out so the buffer can take the next frame while the writer is still busy
+	job.pixels.assign(frame.data, frame.data + static_cast<size_t>(job.width) * job.height * 4);
+
+	{
+		std::lock_guard lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	condition.notify_one();
+}
+
+void vkpg::FrameCapture::WriterLoop()
+{
+	while(true)
+	{
+		Job job;
+		{
+			std::unique_lock lock(mutex);
+			condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+			// Queued frames are still written when shutting down
+			if(jobs.empty())
+			{
+				return;
+			}
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		auto png = EncodePng(job.pixels.data(), job.width, job.height, job.bgra);
+
+		std::ofstream file(job.path, std::ios::binary);
+		file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+		if(!file)
+		{
+			std::cerr << "Frame capture: failed to write " << job.path << std::endl;
+		}
+		else
+		{
+			written_frames++;
+		}
+
+		if(job.ticket != 0)
+		{
+			FinishScreenshot(job.ticket, static_cast<bool>(file));
+		}
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vkpg
+{
+
+// Copies swap chain images into a ring of host visible buffers, one per image. A copy is read once the image's
+// previous frame has finished and handed to a background thread that writes it as a PNG, so capturing never
+// waits for the GPU or the disk.
+class FrameCapture
+{
+public:
+	explicit FrameCapture(vkpg::VulkanDevice& vulkan_device);
+	~FrameCapture();
+
+	FrameCapture(const FrameCapture&) = delete;
+	FrameCapture& operator=(const FrameCapture&) = delete;
+
+	// The images have to be created with VK_IMAGE_USAGE_TRANSFER_SRC_BIT, unsupported formats disable capturing
+	void Create(uint32_t frame_count, VkExtent2D extent, VkFormat format);
+	// Hands finished copies to the writer first, the device has to be idle
+	void Cleanup();
+
+	bool IsSupported() const;
+
+	// Writes the next recorded frame to path. The ticket identifies this request in GetScreenshotResult, a newer
+	// request replaces one that hasn't been recorded yet.
+	uint32_t RequestScreenshot(const std::string& path);
+	// Empty while the screenshot is pending, then whether it was written. Replaced and dropped requests weren't.
+	std::optional<bool> GetScreenshotResult(uint32_t ticket);
+	// Writes every recorded frame to directory/frame_00000.png and so on until StopSequence
+	void StartSequence(const std::string& directory);
+	void StopSequence();
+	bool IsRecordingSequence() const;
+
+	// Whether the next recorded frame is captured
+	bool WantsFrame() const;
+
+	// Records the copy if a capture is wanted, the image is left in the layout it is in
+	void Record(VkCommandBuffer command_buffer, uint32_t frame_index, VkImage image, VkImageLayout layout);
+
+	// Queues the frame's previous copy for writing, call after its fence has been waited on
+	void CollectResults(uint32_t frame_index);
+
+	// Frames dropped because the writer fell behind
+	uint32_t skipped_frames = 0;
+	std::atomic<uint32_t> written_frames = 0;
+
+private:
+	// Frames waiting for the writer, beyond that new ones are dropped instead of piling up memory
+	static constexpr size_t max_queued_frames = 8;
+
+	struct Frame
+	{
+		VkBuffer buffer{VK_NULL_HANDLE};
+		VkDeviceMemory memory{VK_NULL_HANDLE};
+		const uint8_t *data = nullptr;
+		// Empty if no copy was recorded
+		std::string path;
+		// Of the screenshot request, 0 for sequence frames
+		uint32_t ticket = 0;
+	};
+
+	struct Job
+	{
+		std::string path;
+		uint32_t width = 0;
+		uint32_t height = 0;
+		bool bgra = false;
+		std::vector<uint8_t> pixels;
+		uint32_t ticket = 0;
+	};
+
+	void QueueFrame(Frame& frame);
+	void FinishScreenshot(uint32_t ticket, bool written);
+	void WriterLoop();
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	std::vector<Frame> frames;
+	VkExtent2D extent{};
+	bool bgra = false;
+	bool supported = false;
+
+	std::string screenshot_path;
+	uint32_t screenshot_ticket = 0;
+	uint32_t next_ticket = 1;
+	std::string sequence_directory;
+	uint32_t sequence_frame = 0;
+
+	std::mutex mutex;
+	std::condition_variable condition;
+	std::deque<Job> jobs;
+	// Finished screenshot requests by ticket, written by the writer thread
+	std::unordered_map<uint32_t, bool> screenshot_results;
+	bool stopping = false;
+	std::thread writer;
+};
+
+} // namespace vkpg
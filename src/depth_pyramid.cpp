@@ -0,0 +1,318 @@
+#include "depth_pyramid.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+
+vkpg::DepthPyramid::DepthPyramid(VulkanDevice& vulkan_device, PipelineCache& pipelines, DescriptorLayoutCache& descriptor_layout_cache) :
+    vulkan_device(vulkan_device), pipelines(pipelines), descriptor_layout_cache(descriptor_layout_cache)
+{
+
+}
+
+void vkpg::DepthPyramid::Create()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(Constants);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &pipeline_layout);
+	CheckVkResult(result, "Failed to create depth pyramid pipeline layout");
+
+	// MSAA can be changed at runtime, so both are kept
+	pipeline = pipelines.GetComputePipeline("shaders/depth_pyramid.comp.spv", pipeline_layout);
+	multisampled_pipeline = pipelines.GetComputePipeline("shaders/depth_pyramid_multisampled.comp.spv", pipeline_layout);
+
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_NEAREST;
+	sampler_info.minFilter = VK_FILTER_NEAREST;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.minLod = 0.0f;
+	sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+
+	result = vkCreateSampler(vulkan_device.logical_device, &sampler_info, nullptr, &sampler);
+	CheckVkResult(result, "Failed to create depth pyramid sampler");
+}
+
+void vkpg::DepthPyramid::Cleanup()
+{
+	DestroyResources();
+
+	// The pipelines belong to the pipeline cache and the set layout to the layout cache
+	vkDestroyPipelineLayout(vulkan_device.logical_device, pipeline_layout, nullptr);
+	vkDestroySampler(vulkan_device.logical_device, sampler, nullptr);
+	pipeline_layout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	multisampled_pipeline = VK_NULL_HANDLE;
+	sampler = VK_NULL_HANDLE;
+}
+
+bool vkpg::DepthPyramid::IsSupported(VkFormat depth_format) const
+{
+	if(!vulkan_device.storage_image_extended_formats_enabled)
+	{
+		return false;
+	}
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.physical_device, format, &format_properties);
+	VkFormatProperties depth_format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.physical_device, depth_format, &depth_format_properties);
+
+	VkFormatFeatureFlags features = VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT;
+	return (format_properties.optimalTilingFeatures & features) == features &&
+	       (depth_format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
+}
+
+void vkpg::DepthPyramid::CreateResources(VkImageView depth_view, VkExtent2D extent)
+{
+	DestroyResources();
+
+	auto level_extent = GetLevelExtent(extent);
+	level_count = static_cast<uint32_t>(std::floor(std::log2(std::max(level_extent.width, level_extent.height)))) + 1;
+
+	VkImageCreateInfo image_info{};
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.extent.width = level_extent.width;
+	image_info.extent.height = level_extent.height;
+	image_info.extent.depth = 1;
+	image_info.mipLevels = level_count;
+	image_info.arrayLayers = 1;
+	image_info.format = format;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_info.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	auto result = vkCreateImage(vulkan_device.logical_device, &image_info, nullptr, &image);
+	CheckVkResult(result, "Failed to create depth pyramid image");
+
+	VkMemoryRequirements memory_requirements;
+	vkGetImageMemoryRequirements(vulkan_device.logical_device, image, &memory_requirements);
+
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = memory_requirements.size;
+	alloc_info.memoryTypeIndex = vulkan_device.FindMemoryType(memory_requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	result = vkAllocateMemory(vulkan_device.logical_device, &alloc_info, nullptr, &image_memory);
+	CheckVkResult(result, "Failed to allocate depth pyramid memory");
+
+	result = vkBindImageMemory(vulkan_device.logical_device, image, image_memory, 0);
+	CheckVkResult(result, "Failed to bind depth pyramid memory");
+
+	view = CreateView(0, level_count);
+	for(uint32_t level = 0; level < level_count; level++)
+	{
+		level_views.push_back(CreateView(level, 1));
+	}
+
+	DescriptorAllocator::PoolSizes pool_sizes =
+	{
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f}
+	};
+	descriptor_pool = DescriptorAllocator::CreatePool(vulkan_device.logical_device, pool_sizes, level_count);
+
+	std::vector<VkDescriptorSetLayout> layouts(level_count, descriptor_set_layout);
+	descriptor_sets.resize(level_count);
+
+	VkDescriptorSetAllocateInfo set_alloc_info{};
+	set_alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	set_alloc_info.descriptorPool = descriptor_pool;
+	set_alloc_info.descriptorSetCount = level_count;
+	set_alloc_info.pSetLayouts = layouts.data();
+
+	result = vulkan_device.dispatch.allocate_descriptor_sets(vulkan_device.logical_device, &set_alloc_info, descriptor_sets.data());
+	CheckVkResult(result, "Failed to allocate depth pyramid descriptor sets");
+
+	for(uint32_t level = 0; level < level_count; level++)
+	{
+		VkDescriptorImageInfo source_info{};
+		source_info.imageView = level == 0 ? depth_view : level_views[level - 1];
+		source_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		VkDescriptorImageInfo destination_info{};
+		destination_info.imageView = level_views[level];
+		destination_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
+		descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_writes[0].dstSet = descriptor_sets[level];
+		descriptor_writes[0].dstBinding = 0;
+		descriptor_writes[0].descriptorCount = 1;
+		descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		descriptor_writes[0].pImageInfo = &source_info;
+		descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_writes[1].dstSet = descriptor_sets[level];
+		descriptor_writes[1].dstBinding = 1;
+		descriptor_writes[1].descriptorCount = 1;
+		descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptor_writes[1].pImageInfo = &destination_info;
+
+		vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+		                                              descriptor_writes.data(), 0, nullptr);
+	}
+
+	std::cout << "Depth pyramid: " << level_extent.width << "x" << level_extent.height << ", " << level_count << " levels, "
+	          << static_cast<double>(memory_requirements.size) / (1024.0 * 1024.0) << " MiB" << std::endl;
+}
+
+void vkpg::DepthPyramid::DestroyResources()
+{
+	for(auto level_view : level_views)
+	{
+		vkDestroyImageView(vulkan_device.logical_device, level_view, nullptr);
+	}
+	level_views.clear();
+
+	// Frees the sets with it
+	vkDestroyDescriptorPool(vulkan_device.logical_device, descriptor_pool, nullptr);
+	descriptor_pool = VK_NULL_HANDLE;
+	descriptor_sets.clear();
+
+	vkDestroyImageView(vulkan_device.logical_device, view, nullptr);
+	vkDestroyImage(vulkan_device.logical_device, image, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, image_memory, nullptr);
+	view = VK_NULL_HANDLE;
+	image = VK_NULL_HANDLE;
+	image_memory = VK_NULL_HANDLE;
+	level_count = 0;
+}
+
+void vkpg::DepthPyramid::Record(VkCommandBuffer command_buffer, VkExtent2D render_extent, bool multisampled,
+                                VkPipelineStageFlags reader_stages) const
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = level_count;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// The previous contents are rebuilt, only the previous frame's readers have to be done with them
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, reader_stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+	                                            0, nullptr,
+	                                            0, nullptr,
+	                                            1, &barrier);
+
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, multisampled ? multisampled_pipeline : pipeline);
+
+	auto source_extent = render_extent;
+	auto destination_extent = GetLevelExtent(render_extent);
+	for(uint32_t level = 0; level < level_count; level++)
+	{
+		if(level == 1 && multisampled)
+		{
+			vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+		}
+
+		Constants constants;
+		constants.source_width = static_cast<int32_t>(source_extent.width);
+		constants.source_height = static_cast<int32_t>(source_extent.height);
+		constants.destination_width = static_cast<int32_t>(destination_extent.width);
+		constants.destination_height = static_cast<int32_t>(destination_extent.height);
+		constants.depth_source = level == 0 ? 1 : 0;
+
+		vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1,
+		                                                &descriptor_sets[level], 0, nullptr);
+		vulkan_device.dispatch.cmd_push_constants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+		vulkan_device.dispatch.cmd_dispatch(command_buffer, (destination_extent.width + group_size - 1) / group_size,
+		                                    (destination_extent.height + group_size - 1) / group_size, 1);
+
+		// Read by the next level and by everything after the pyramid
+		barrier.subresourceRange.baseMipLevel = level;
+		barrier.subresourceRange.levelCount = 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | reader_stages, 0,
+		                                            0, nullptr,
+		                                            0, nullptr,
+		                                            1, &barrier);
+
+		source_extent = destination_extent;
+		destination_extent.width = std::max(destination_extent.width / 2, 1u);
+		destination_extent.height = std::max(destination_extent.height / 2, 1u);
+	}
+}
+
+VkImageView vkpg::DepthPyramid::GetView() const
+{
+	return view;
+}
+
+VkSampler vkpg::DepthPyramid::GetSampler() const
+{
+	return sampler;
+}
+
+uint32_t vkpg::DepthPyramid::GetLevelCount() const
+{
+	return level_count;
+}
+
+VkExtent2D vkpg::DepthPyramid::GetLevelExtent(VkExtent2D render_extent)
+{
+	return {std::max(render_extent.width / 2, 1u), std::max(render_extent.height / 2, 1u)};
+}
+
+VkImageView vkpg::DepthPyramid::CreateView(uint32_t base_level, uint32_t count) const
+{
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.baseMipLevel = base_level;
+	view_info.subresourceRange.levelCount = count;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	VkImageView image_view;
+	auto result = vkCreateImageView(vulkan_device.logical_device, &view_info, nullptr, &image_view);
+	CheckVkResult(result, "Failed to create depth pyramid view");
+
+	return image_view;
+}
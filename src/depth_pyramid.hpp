@@ -0,0 +1,88 @@
+#pragma once
+
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "pipeline.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+// Hierarchical depth (Hi-Z) of the scene for occlusion culling and screen space effects, rebuilt from the depth
+// attachment every frame. Level 0 has half the resolution of the depth attachment, every texel holds the nearest
+// (red) and farthest (green) depth of the texels it covers. Each level takes a dispatch, the last texel of an odd
+// sized level also covers its last row or column so the bounds stay conservative.
+class DepthPyramid
+{
+public:
+	DepthPyramid(vkpg::VulkanDevice& vulkan_device, vkpg::PipelineCache& pipelines, vkpg::DescriptorLayoutCache& descriptor_layout_cache);
+
+	// Pipelines and the sampler, they don't depend on the extent
+	void Create();
+	void Cleanup();
+
+	// Needs storage images of extended formats and a depth format that can be sampled
+	bool IsSupported(VkFormat depth_format) const;
+
+	// The pyramid of a depth attachment of extent, sampled through depth_view
+	void CreateResources(VkImageView depth_view, VkExtent2D extent);
+	void DestroyResources();
+
+	// The depth attachment is read in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and its writes have to be visible to
+	// compute shaders, only its render_extent part is reduced. Readers in reader_stages are waited for before the
+	// pyramid is overwritten, afterwards every level is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL and visible to them.
+	void Record(VkCommandBuffer command_buffer, VkExtent2D render_extent, bool multisampled, VkPipelineStageFlags reader_stages) const;
+
+	// All levels, to be sampled with textureLod and GetSampler()
+	VkImageView GetView() const;
+	// Nearest and clamped to the edge, the bounds of neighbouring texels must not be blended
+	VkSampler GetSampler() const;
+	uint32_t GetLevelCount() const;
+	// Written part of level 0 for a depth attachment rendered at render_extent, each level after it halves it.
+	// Record transitions the image from UNDEFINED every frame, so texels outside the written part are undefined:
+	// readers have to scale UVs by render_extent / extent and clamp them to the written region.
+	static VkExtent2D GetLevelExtent(VkExtent2D render_extent);
+
+private:
+	static constexpr VkFormat format = VK_FORMAT_R32G32_SFLOAT;
+	// Matches depth_pyramid.comp
+	static constexpr uint32_t group_size = 8;
+
+	struct Constants
+	{
+		int32_t source_width = 0;
+		int32_t source_height = 0;
+		int32_t destination_width = 0;
+		int32_t destination_height = 0;
+		int32_t depth_source = 0;
+	};
+
+	VkImageView CreateView(uint32_t base_level, uint32_t count) const;
+
+	vkpg::VulkanDevice& vulkan_device;
+	vkpg::PipelineCache& pipelines;
+	vkpg::DescriptorLayoutCache& descriptor_layout_cache;
+
+	VkDescriptorSetLayout descriptor_set_layout{VK_NULL_HANDLE};
+	VkPipelineLayout pipeline_layout{VK_NULL_HANDLE};
+	VkPipeline pipeline{VK_NULL_HANDLE};
+	VkPipeline multisampled_pipeline{VK_NULL_HANDLE};
+	VkSampler sampler{VK_NULL_HANDLE};
+
+	VkImage image{VK_NULL_HANDLE};
+	VkDeviceMemory image_memory{VK_NULL_HANDLE};
+	VkImageView view{VK_NULL_HANDLE};
+	uint32_t level_count = 0;
+
+	// Per level
+	std::vector<VkImageView> level_views;
+	VkDescriptorPool descriptor_pool{VK_NULL_HANDLE};
+	// Level 0 reads the depth attachment, the others the level before them
+	std::vector<VkDescriptorSet> descriptor_sets;
+};
+
+} // namespace vkpg
@@ -0,0 +1,224 @@
+#include "descriptors.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+vkpg::DescriptorAllocator::DescriptorAllocator(VulkanDevice& vulkan_device, uint32_t sets_per_pool) :
+    vulkan_device(vulkan_device), sets_per_pool(sets_per_pool)
+{
+
+}
+
+void vkpg::DescriptorAllocator::Cleanup()
+{
+	for(auto pool : free_pools)
+	{
+		vkDestroyDescriptorPool(vulkan_device.logical_device, pool, nullptr);
+	}
+
+	for(auto pool : used_pools)
+	{
+		vkDestroyDescriptorPool(vulkan_device.logical_device, pool, nullptr);
+	}
+
+	free_pools.clear();
+	used_pools.clear();
+	current_pool = VK_NULL_HANDLE;
+}
+
+void vkpg::DescriptorAllocator::ResetPools()
+{
+	for(auto pool : used_pools)
+	{
+		vulkan_device.dispatch.reset_descriptor_pool(vulkan_device.logical_device, pool, 0);
+		free_pools.push_back(pool);
+	}
+
+	used_pools.clear();
+	current_pool = VK_NULL_HANDLE;
+}
+
+VkDescriptorSet vkpg::DescriptorAllocator::Allocate(VkDescriptorSetLayout layout)
+{
+	if(current_pool == VK_NULL_HANDLE)
+	{
+		current_pool = GrabPool();
+		used_pools.push_back(current_pool);
+	}
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = current_pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &layout;
+
+	VkDescriptorSet descriptor_set;
+	auto result = vulkan_device.dispatch.allocate_descriptor_sets(vulkan_device.logical_device, &alloc_info, &descriptor_set);
+
+	if(result == VK_ERROR_OUT_OF_POOL_MEMORY || result == VK_ERROR_FRAGMENTED_POOL)
+	{
+		// The current pool is exhausted, continue in a fresh one
+		current_pool = GrabPool();
+		used_pools.push_back(current_pool);
+
+		alloc_info.descriptorPool = current_pool;
+		result = vulkan_device.dispatch.allocate_descriptor_sets(vulkan_device.logical_device, &alloc_info, &descriptor_set);
+	}
+
+	CheckVkResult(result, "Failed to allocate descriptor set");
+
+	return descriptor_set;
+}
+
+VkDescriptorPool vkpg::DescriptorAllocator::CreatePool(VkDevice device, const PoolSizes& pool_sizes, uint32_t max_sets,
+                                                      VkDescriptorPoolCreateFlags flags)
+{
+	std::vector<VkDescriptorPoolSize> sizes;
+	sizes.reserve(pool_sizes.size());
+
+	for(const auto& [type, ratio] : pool_sizes)
+	{
+		auto count = static_cast<uint32_t>(ratio * static_cast<float>(max_sets));
+		sizes.push_back({type, std::max(count, 1u)});
+	}
+
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.flags = flags;
+	pool_info.poolSizeCount = static_cast<uint32_t>(sizes.size());
+	pool_info.pPoolSizes = sizes.data();
+	pool_info.maxSets = max_sets;
+
+	VkDescriptorPool pool;
+	auto result = vkCreateDescriptorPool(device, &pool_info, nullptr, &pool);
+	CheckVkResult(result, "Failed to create descriptor pool");
+
+	return pool;
+}
+
+VkDescriptorPool vkpg::DescriptorAllocator::GrabPool()
+{
+	if(!free_pools.empty())
+	{
+		auto pool = free_pools.back();
+		free_pools.pop_back();
+		return pool;
+	}
+
+	auto pool = CreatePool(vulkan_device.logical_device, pool_sizes, sets_per_pool);
+
+	// Every new pool is twice as large, so heavy scenes settle on a handful of pools
+	sets_per_pool = std::min(sets_per_pool * 2, max_sets_per_pool);
+
+	return pool;
+}
+
+vkpg::DescriptorLayoutCache::DescriptorLayoutCache(VulkanDevice& vulkan_device) :
+    vulkan_device(vulkan_device)
+{
+
+}
+
+void vkpg::DescriptorLayoutCache::Cleanup()
+{
+	for(const auto& [info, layout] : layout_cache)
+	{
+		vkDestroyDescriptorSetLayout(vulkan_device.logical_device, layout, nullptr);
+	}
+
+	layout_cache.clear();
+}
+
+VkDescriptorSetLayout vkpg::DescriptorLayoutCache::CreateDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+                                                                            VkDescriptorSetLayoutCreateFlags flags,
+                                                                            const std::vector<VkDescriptorBindingFlags>& binding_flags)
+{
+	if(!binding_flags.empty() && binding_flags.size() != bindings.size())
+	{
+		throw std::invalid_argument("Descriptor binding flags must match the bindings");
+	}
+
+	// Bindings are sorted by their number so the same layout declared in a different order hits the cache
+	std::vector<size_t> order(bindings.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::sort(order.begin(), order.end(), [&bindings](size_t lhs, size_t rhs)
+	{
+		return bindings[lhs].binding < bindings[rhs].binding;
+	});
+
+	LayoutInfo info;
+	info.flags = flags;
+	for(auto i : order)
+	{
+		info.bindings.push_back(bindings[i]);
+		if(!binding_flags.empty())
+		{
+			info.binding_flags.push_back(binding_flags[i]);
+		}
+	}
+
+	auto it = layout_cache.find(info);
+	if(it != layout_cache.end())
+	{
+		return it->second;
+	}
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo binding_flags_info{};
+	binding_flags_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	binding_flags_info.bindingCount = static_cast<uint32_t>(info.binding_flags.size());
+	binding_flags_info.pBindingFlags = info.binding_flags.data();
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.pNext = info.binding_flags.empty() ? nullptr : &binding_flags_info;
+	layout_info.flags = flags;
+	layout_info.bindingCount = static_cast<uint32_t>(info.bindings.size());
+	layout_info.pBindings = info.bindings.data();
+
+	VkDescriptorSetLayout layout;
+	auto result = vkCreateDescriptorSetLayout(vulkan_device.logical_device, &layout_info, nullptr, &layout);
+	CheckVkResult(result, "Failed to create descriptor set layout");
+
+	layout_cache.emplace(std::move(info), layout);
+
+	return layout;
+}
+
+bool vkpg::DescriptorLayoutCache::LayoutInfo::operator==(const LayoutInfo& other) const
+{
+	if(flags != other.flags || binding_flags != other.binding_flags || bindings.size() != other.bindings.size())
+	{
+		return false;
+	}
+
+	return std::equal(bindings.cbegin(), bindings.cend(), other.bindings.cbegin(), [](const auto& lhs, const auto& rhs)
+	{
+		return lhs.binding == rhs.binding &&
+		       lhs.descriptorType == rhs.descriptorType &&
+		       lhs.descriptorCount == rhs.descriptorCount &&
+		       lhs.stageFlags == rhs.stageFlags &&
+		       lhs.pImmutableSamplers == rhs.pImmutableSamplers;
+	});
+}
+
+size_t vkpg::DescriptorLayoutCache::LayoutInfo::Hash() const
+{
+	size_t result = 0;
+	HashCombine(result, flags);
+
+	for(const auto& binding : bindings)
+	{
+		HashCombine(result, binding.binding);
+		HashCombine(result, binding.descriptorType);
+		HashCombine(result, binding.descriptorCount);
+		HashCombine(result, binding.stageFlags);
+	}
+
+	for(auto flag : binding_flags)
+	{
+		HashCombine(result, flag);
+	}
+
+	return result;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vkpg
+{
+
+// Hands out descriptor sets from a list of pools, a new (larger) pool is created when the current one runs out.
+// ResetPools() recycles every pool at once, which is how per-frame transient sets are released.
+class DescriptorAllocator
+{
+public:
+	// Descriptors of each type per set in a pool
+	using PoolSizes = std::vector<std::pair<VkDescriptorType, float>>;
+
+	DescriptorAllocator(vkpg::VulkanDevice& vulkan_device, uint32_t sets_per_pool = 64);
+
+	void Cleanup();
+	void ResetPools();
+
+	VkDescriptorSet Allocate(VkDescriptorSetLayout layout);
+
+	static VkDescriptorPool CreatePool(VkDevice device, const PoolSizes& pool_sizes, uint32_t max_sets,
+	                                   VkDescriptorPoolCreateFlags flags = 0);
+
+	PoolSizes pool_sizes =
+	{
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 0.5f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2.0f},
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 0.5f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 0.5f}
+	};
+
+private:
+	static constexpr uint32_t max_sets_per_pool = 4096;
+
+	VkDescriptorPool GrabPool();
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	uint32_t sets_per_pool;
+
+	VkDescriptorPool current_pool{VK_NULL_HANDLE};
+	std::vector<VkDescriptorPool> used_pools;
+	std::vector<VkDescriptorPool> free_pools;
+};
+
+// Deduplicates descriptor set layouts by their bindings, so equal layouts share one VkDescriptorSetLayout
+class DescriptorLayoutCache
+{
+public:
+	explicit DescriptorLayoutCache(vkpg::VulkanDevice& vulkan_device);
+
+	void Cleanup();
+
+	// binding_flags is either empty or has one entry per binding
+	VkDescriptorSetLayout CreateDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings,
+	                                                VkDescriptorSetLayoutCreateFlags flags = 0,
+	                                                const std::vector<VkDescriptorBindingFlags>& binding_flags = {});
+
+private:
+	struct LayoutInfo
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		std::vector<VkDescriptorBindingFlags> binding_flags;
+		VkDescriptorSetLayoutCreateFlags flags = 0;
+
+		bool operator==(const LayoutInfo& other) const;
+		size_t Hash() const;
+	};
+
+	struct LayoutHash
+	{
+		size_t operator()(const LayoutInfo& info) const
+		{
+			return info.Hash();
+		}
+	};
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	std::unordered_map<LayoutInfo, VkDescriptorSetLayout, LayoutHash> layout_cache;
+};
+
+} // namespace vkpg
@@ -3,8 +3,12 @@
 #include "swapchain.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <cctype>
+#include <cstring>
 #include <iostream>
 #include <set>
+#include <tuple>
 #include <vulkan/vk_enum_string_helper.h>
 
 vkpg::VulkanDevice::VulkanDevice(const VkInstance& instance, VulkanSwapChain& swap_chain, VkSurfaceKHR& surface) :
@@ -28,6 +32,13 @@ void vkpg::VulkanDevice::CreateLogicalDevice()
 		queue_family_indices.graphics_family.value(),
 		queue_family_indices.present_family.value()
 	};
+	for(const auto& family : {queue_family_indices.compute_family, queue_family_indices.transfer_family})
+	{
+		if(family.has_value())
+		{
+			unique_queue_families.insert(*family);
+		}
+	}
 
 	float queue_priority = 1.0f;
 	for(auto queue_family : unique_queue_families)
@@ -40,17 +51,205 @@ void vkpg::VulkanDevice::CreateLogicalDevice()
 		queue_create_infos.emplace_back(queueCreateInfo);
 	}
 
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
+
 	VkPhysicalDeviceFeatures device_features{};
 	device_features.samplerAnisotropy = VK_TRUE;
 	device_features.sampleRateShading = VK_TRUE;
+	device_features.multiDrawIndirect = supported_features.multiDrawIndirect;
+	device_features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+	device_features.shaderStorageImageExtendedFormats = supported_features.shaderStorageImageExtendedFormats;
+	device_features.fillModeNonSolid = supported_features.fillModeNonSolid;
+
+	multi_draw_indirect_enabled = supported_features.multiDrawIndirect == VK_TRUE;
+	storage_image_extended_formats_enabled = supported_features.shaderStorageImageExtendedFormats == VK_TRUE;
+	fill_mode_non_solid_enabled = supported_features.fillModeNonSolid == VK_TRUE;
+
+	std::vector<const char*> enabled_extensions = device_extensions;
+
+	VkPhysicalDeviceProperties physical_device_properties;
+	vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+
+	// Extension features are queried through vkGetPhysicalDeviceFeatures2, which needs 1.1 on both the instance and the device
+	bool features2_supported = api_version >= VK_API_VERSION_1_1 && physical_device_properties.apiVersion >= VK_API_VERSION_1_1;
+
+	// Descriptor indexing is core since 1.2, before that it needs VK_EXT_descriptor_indexing
+	bool descriptor_indexing_core = api_version >= VK_API_VERSION_1_2 && physical_device_properties.apiVersion >= VK_API_VERSION_1_2;
+	bool descriptor_indexing_extension = features2_supported && IsExtensionSupported(physical_device, VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+	bool extended_dynamic_state_extension = features2_supported && IsExtensionSupported(physical_device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+	// Mesh shaders are SPIR-V 1.4, which is core on the same 1.2 instance and device that make descriptor indexing core
+	bool mesh_shader_extension = descriptor_indexing_core && IsExtensionSupported(physical_device, VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	// Dynamic rendering and synchronization2 are core in 1.3, on 1.2 their extensions only depend on what is core there
+	bool vulkan_1_3_core = api_version >= VK_API_VERSION_1_3 && physical_device_properties.apiVersion >= VK_API_VERSION_1_3;
+	bool dynamic_rendering_extension = descriptor_indexing_core && IsExtensionSupported(physical_device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+	bool synchronization2_extension = descriptor_indexing_core && IsExtensionSupported(physical_device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
+	// Structures of the supported extension features, chained into vkGetPhysicalDeviceFeatures2
+	void *supported_features_chain = nullptr;
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT supported_mesh_shader{};
+	supported_mesh_shader.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+	if(mesh_shader_extension)
+	{
+		supported_mesh_shader.pNext = supported_features_chain;
+		supported_features_chain = &supported_mesh_shader;
+	}
+
+	VkPhysicalDeviceDynamicRenderingFeatures supported_dynamic_rendering{};
+	supported_dynamic_rendering.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+
+	if(vulkan_1_3_core || dynamic_rendering_extension)
+	{
+		supported_dynamic_rendering.pNext = supported_features_chain;
+		supported_features_chain = &supported_dynamic_rendering;
+	}
+
+	VkPhysicalDeviceSynchronization2Features supported_synchronization2{};
+	supported_synchronization2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+
+	if(vulkan_1_3_core || synchronization2_extension)
+	{
+		supported_synchronization2.pNext = supported_features_chain;
+		supported_features_chain = &supported_synchronization2;
+	}
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supported_extended_dynamic_state{};
+	supported_extended_dynamic_state.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+	if(extended_dynamic_state_extension)
+	{
+		supported_extended_dynamic_state.pNext = supported_features_chain;
+		supported_features_chain = &supported_extended_dynamic_state;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingFeatures supported_descriptor_indexing{};
+	supported_descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	if(descriptor_indexing_core || descriptor_indexing_extension)
+	{
+		supported_descriptor_indexing.pNext = supported_features_chain;
+		supported_features_chain = &supported_descriptor_indexing;
+	}
+
+	if(features2_supported)
+	{
+		VkPhysicalDeviceFeatures2 supported_features2{};
+		supported_features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supported_features2.pNext = supported_features_chain;
+		vkGetPhysicalDeviceFeatures2(physical_device, &supported_features2);
+	}
+
+	// Structures of the enabled extension features, chained into VkDeviceCreateInfo
+	void *enabled_features_chain = nullptr;
+
+	// Bindless textures index a partially bound sampler array with the material index passed as firstInstance
+	descriptor_indexing_enabled = supported_descriptor_indexing.shaderSampledImageArrayNonUniformIndexing &&
+	                              supported_descriptor_indexing.descriptorBindingSampledImageUpdateAfterBind &&
+	                              supported_descriptor_indexing.descriptorBindingPartiallyBound &&
+	                              supported_descriptor_indexing.runtimeDescriptorArray &&
+	                              supported_features.drawIndirectFirstInstance;
+
+	VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_features{};
+	descriptor_indexing_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+	if(descriptor_indexing_enabled)
+	{
+		descriptor_indexing_features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptor_indexing_features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+		descriptor_indexing_features.descriptorBindingPartiallyBound = VK_TRUE;
+		descriptor_indexing_features.runtimeDescriptorArray = VK_TRUE;
+		descriptor_indexing_features.pNext = enabled_features_chain;
+		enabled_features_chain = &descriptor_indexing_features;
+
+		if(!descriptor_indexing_core)
+		{
+			enabled_extensions.push_back(VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME);
+		}
+	}
+
+	// Cull mode, front face and depth state set at record time instead of being baked into every pipeline
+	extended_dynamic_state_enabled = supported_extended_dynamic_state.extendedDynamicState == VK_TRUE;
+
+	VkPhysicalDeviceExtendedDynamicStateFeaturesEXT extended_dynamic_state_features{};
+	extended_dynamic_state_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT;
+
+	if(extended_dynamic_state_enabled)
+	{
+		extended_dynamic_state_features.extendedDynamicState = VK_TRUE;
+		extended_dynamic_state_features.pNext = enabled_features_chain;
+		enabled_features_chain = &extended_dynamic_state_features;
+
+		enabled_extensions.push_back(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+	}
+
+	// Meshlets are drawn with a task and a mesh shader instead of compute culling into an index buffer
+	mesh_shader_enabled = supported_mesh_shader.taskShader == VK_TRUE && supported_mesh_shader.meshShader == VK_TRUE;
+
+	VkPhysicalDeviceMeshShaderFeaturesEXT mesh_shader_features{};
+	mesh_shader_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT;
+
+	if(mesh_shader_enabled)
+	{
+		mesh_shader_features.taskShader = VK_TRUE;
+		mesh_shader_features.meshShader = VK_TRUE;
+		mesh_shader_features.pNext = enabled_features_chain;
+		enabled_features_chain = &mesh_shader_features;
+
+		enabled_extensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	}
+
+	// Render passes and framebuffers can be replaced by vkCmdBeginRendering
+	dynamic_rendering_enabled = supported_dynamic_rendering.dynamicRendering == VK_TRUE;
+
+	VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features{};
+	dynamic_rendering_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+
+	if(dynamic_rendering_enabled)
+	{
+		dynamic_rendering_features.dynamicRendering = VK_TRUE;
+		dynamic_rendering_features.pNext = enabled_features_chain;
+		enabled_features_chain = &dynamic_rendering_features;
+
+		if(!vulkan_1_3_core)
+		{
+			enabled_extensions.push_back(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+		}
+	}
+
+	// Barriers with stages and accesses per image instead of merged into one pair per command
+	synchronization2_enabled = supported_synchronization2.synchronization2 == VK_TRUE;
+
+	VkPhysicalDeviceSynchronization2Features synchronization2_features{};
+	synchronization2_features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+
+	if(synchronization2_enabled)
+	{
+		synchronization2_features.synchronization2 = VK_TRUE;
+		synchronization2_features.pNext = enabled_features_chain;
+		enabled_features_chain = &synchronization2_features;
+
+		if(!vulkan_1_3_core)
+		{
+			enabled_extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		}
+	}
+
+	std::cout << "Bindless textures: " << (descriptor_indexing_enabled ? "enabled" : "not supported") << std::endl;
+	std::cout << "Extended dynamic state: " << (extended_dynamic_state_enabled ? "enabled" : "not supported") << std::endl;
+	std::cout << "Mesh shaders: " << (mesh_shader_enabled ? "enabled" : "not supported") << std::endl;
+	std::cout << "Dynamic rendering: " << (dynamic_rendering_enabled ? "enabled" : "not supported") << std::endl;
+	std::cout << "Synchronization2: " << (synchronization2_enabled ? "enabled" : "not supported") << std::endl;
 
 	VkDeviceCreateInfo create_info{};
 	create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+	create_info.pNext = enabled_features_chain;
 	create_info.pQueueCreateInfos = queue_create_infos.data();
 	create_info.queueCreateInfoCount = static_cast<uint32_t>(queue_create_infos.size());
 	create_info.pEnabledFeatures = &device_features;
-	create_info.enabledExtensionCount = static_cast<uint32_t>(device_extensions.size());
-	create_info.ppEnabledExtensionNames = device_extensions.data();
+	create_info.enabledExtensionCount = static_cast<uint32_t>(enabled_extensions.size());
+	create_info.ppEnabledExtensionNames = enabled_extensions.data();
 
 	if(vkpg::Debug::enable_validation_layers)
 	{
@@ -68,6 +267,52 @@ void vkpg::VulkanDevice::CreateLogicalDevice()
 
 	vkGetDeviceQueue(logical_device, queue_family_indices.graphics_family.value(), 0, &swap_chain.graphics_queue);
 	vkGetDeviceQueue(logical_device, queue_family_indices.present_family.value(), 0, &swap_chain.present_queue);
+
+	if(queue_family_indices.compute_family.has_value())
+	{
+		vkGetDeviceQueue(logical_device, queue_family_indices.compute_family.value(), 0, &compute_queue);
+	}
+	if(queue_family_indices.transfer_family.has_value())
+	{
+		vkGetDeviceQueue(logical_device, queue_family_indices.transfer_family.value(), 0, &transfer_queue);
+	}
+
+	auto FamilyName = [](const std::optional<uint32_t>& family)
+	{
+		return family.has_value() ? std::to_string(*family) : std::string("none");
+	};
+	std::cout << "Queue families: graphics " << FamilyName(queue_family_indices.graphics_family)
+	          << ", present " << FamilyName(queue_family_indices.present_family)
+	          << ", compute " << FamilyName(queue_family_indices.compute_family)
+	          << ", transfer " << FamilyName(queue_family_indices.transfer_family) << std::endl;
+
+	dispatch.Load(logical_device);
+
+	if(extended_dynamic_state_enabled)
+	{
+		cmd_set_cull_mode = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdSetCullModeEXT"));
+		cmd_set_front_face = reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdSetFrontFaceEXT"));
+		cmd_set_depth_test_enable = reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdSetDepthTestEnableEXT"));
+		cmd_set_depth_write_enable = reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdSetDepthWriteEnableEXT"));
+		cmd_set_depth_compare_op = reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdSetDepthCompareOpEXT"));
+	}
+
+	if(mesh_shader_enabled)
+	{
+		cmd_draw_mesh_tasks = reinterpret_cast<PFN_vkCmdDrawMeshTasksEXT>(vkGetDeviceProcAddr(logical_device, "vkCmdDrawMeshTasksEXT"));
+	}
+
+	// The extension commands have the same signatures as the core ones
+	if(dynamic_rendering_enabled)
+	{
+		cmd_begin_rendering = reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(logical_device, vulkan_1_3_core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"));
+		cmd_end_rendering = reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(logical_device, vulkan_1_3_core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"));
+	}
+
+	if(synchronization2_enabled)
+	{
+		cmd_pipeline_barrier2 = reinterpret_cast<PFN_vkCmdPipelineBarrier2>(vkGetDeviceProcAddr(logical_device, vulkan_1_3_core ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR"));
+	}
 }
 
 vkpg::VulkanDevice::QueueFamilyIndices vkpg::VulkanDevice::FindQueueFamilies(VkPhysicalDevice device) const
@@ -104,37 +349,149 @@ vkpg::VulkanDevice::QueueFamilyIndices vkpg::VulkanDevice::FindQueueFamilies(VkP
 		i++;
 	}
 
+	for(uint32_t family = 0; family < queue_family_count; family++)
+	{
+		auto flags = queue_families[family].queueFlags;
+		if(!queue_family_indices.compute_family.has_value() && (flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+		{
+			queue_family_indices.compute_family = family;
+		}
+		if(!queue_family_indices.transfer_family.has_value() && (flags & VK_QUEUE_TRANSFER_BIT) &&
+		   !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+		{
+			queue_family_indices.transfer_family = family;
+		}
+	}
+
 	return queue_family_indices;
 }
 
-bool vkpg::VulkanDevice::IsDeviceSuitable(VkPhysicalDevice device)
+std::string vkpg::VulkanDevice::GetUnsuitableReason(VkPhysicalDevice device)
 {
 	QueueFamilyIndices queue_family_indices = FindQueueFamilies(device);
-	if(!queue_family_indices.IsComplete())
+	if(!queue_family_indices.graphics_family.has_value())
+	{
+		return "no graphics queue";
+	}
+	if(!queue_family_indices.present_family.has_value())
 	{
-		return false;
+		return "can't present to the window";
 	}
 
-	bool extensions_supported = CheckDeviceExtensionSupport(device);
-	if(!extensions_supported)
+	for(const auto& extension : device_extensions)
 	{
-		return false;
+		if(!IsExtensionSupported(device, extension))
+		{
+			return std::string("missing ") + extension;
+		}
 	}
 
 	auto swap_chain_support = swap_chain.QuerySwapChainSupport(device);
 	if(swap_chain_support.formats.empty() || swap_chain_support.present_modes.empty())
 	{
-		return false;
+		return "no surface formats or present modes";
 	}
 
 	VkPhysicalDeviceFeatures supported_features;
 	vkGetPhysicalDeviceFeatures(device, &supported_features);
 	if(!supported_features.samplerAnisotropy)
 	{
-		return false;
+		return "no sampler anisotropy";
 	}
+	// Always enabled in CreateLogicalDevice
+	if(!supported_features.sampleRateShading)
+	{
+		return "no sample rate shading";
+	}
+
+	return {};
+}
+
+bool vkpg::VulkanDevice::IsDeviceSuitable(VkPhysicalDevice device)
+{
+	return GetUnsuitableReason(device).empty();
+}
+
+uint32_t vkpg::VulkanDevice::GetDeviceTier(VkPhysicalDeviceType type)
+{
+	switch(type)
+	{
+		case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+		case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+		case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+		case VK_PHYSICAL_DEVICE_TYPE_OTHER: return 1;
+		default: return 0;
+	}
+}
+
+uint64_t vkpg::VulkanDevice::ScoreDevice(VkPhysicalDevice device, std::string& breakdown) const
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(device, &features);
+
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+
+	uint64_t score = 0;
+	breakdown.clear();
+	auto Add = [&](const std::string& what, uint64_t points)
+	{
+		score += points;
+		breakdown += (breakdown.empty() ? "" : ", ") + what + " " + std::to_string(points);
+	};
+
+	// The type isn't part of the score, see GetDeviceTier. An integrated GPU's device local heap is system memory
+	// and can be larger than a discrete one's, so no amount of it may outweigh the type.
+	VkDeviceSize device_local_size = 0;
+	for(uint32_t i = 0; i < memory_properties.memoryHeapCount; i++)
+	{
+		if(memory_properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+		{
+			device_local_size = std::max(device_local_size, memory_properties.memoryHeaps[i].size);
+		}
+	}
+	auto device_local_mib = device_local_size / (1024 * 1024);
+	Add(std::to_string(device_local_mib) + " MiB", device_local_mib / 64);
+
+	// Optional features the renderer uses when they are there
+	if(features.multiDrawIndirect)
+	{
+		Add("multi draw indirect", 50);
+	}
+	if(properties.limits.timestampComputeAndGraphics)
+	{
+		Add("timestamps", 25);
+	}
+	if(properties.apiVersion >= VK_API_VERSION_1_3)
+	{
+		Add("Vulkan 1.3", 25);
+	}
+	if(FindQueueFamilies(device).compute_family.has_value())
+	{
+		Add("async compute", 25);
+	}
+	if(IsExtensionSupported(device, VK_EXT_MESH_SHADER_EXTENSION_NAME))
+	{
+		Add("mesh shaders", 50);
+	}
+	if(IsExtensionSupported(device, VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME))
+	{
+		Add("extended dynamic state", 25);
+	}
+
+	VkSampleCountFlags sample_counts = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	uint32_t max_samples = 1;
+	while(max_samples < 64 && (sample_counts & (max_samples << 1)))
+	{
+		max_samples <<= 1;
+	}
+	Add(std::to_string(max_samples) + "x MSAA", max_samples * 5);
+	Add(std::to_string(properties.limits.maxImageDimension2D) + " max image size", properties.limits.maxImageDimension2D / 1024);
 
-	return true;
+	return score;
 }
 
 bool vkpg::VulkanDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
@@ -157,6 +514,22 @@ bool vkpg::VulkanDevice::CheckDeviceExtensionSupport(VkPhysicalDevice device)
 	return required_extensions.empty();
 }
 
+bool vkpg::VulkanDevice::IsExtensionSupported(VkPhysicalDevice device, const char* extension_name) const
+{
+	uint32_t extension_count;
+	auto result = vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, nullptr);
+	CheckVkResult(result, "Failed to enumerate device extension properties");
+
+	std::vector<VkExtensionProperties> available_extensions(extension_count);
+	result = vkEnumerateDeviceExtensionProperties(device, nullptr, &extension_count, available_extensions.data());
+	CheckVkResult(result, "Failed to enumerate device extension properties");
+
+	return std::any_of(available_extensions.cbegin(), available_extensions.cend(), [extension_name](const auto& extension)
+	{
+		return std::strcmp(extension.extensionName, extension_name) == 0;
+	});
+}
+
 void vkpg::VulkanDevice::PickPhysicalDevice()
 {
 	uint32_t device_count = 0;
@@ -172,29 +545,131 @@ void vkpg::VulkanDevice::PickPhysicalDevice()
 	result = vkEnumeratePhysicalDevices(instance, &device_count, physical_devices.data());
 	CheckVkResult(result, "Failed to enumerate physical devices");
 
-	std::cout << "Available physical devices: " << std::endl;
-	for(const auto& physical_device : physical_devices)
+	struct Candidate
+	{
+		VkPhysicalDevice device;
+		VkPhysicalDeviceProperties properties;
+		// Empty for devices that can be used
+		std::string unsuitable_reason;
+		uint32_t tier = 0;
+		uint64_t score = 0;
+		std::string breakdown;
+	};
+
+	std::vector<Candidate> candidates;
+	for(const auto& device : physical_devices)
 	{
-		VkPhysicalDeviceProperties physical_device_properties;
-		vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
-		std::cout << "  " << physical_device_properties.deviceName << " - " << string_VkPhysicalDeviceType(physical_device_properties.deviceType) << std::endl;
+		Candidate candidate{device};
+		vkGetPhysicalDeviceProperties(device, &candidate.properties);
+		candidate.unsuitable_reason = GetUnsuitableReason(device);
+		candidate.tier = GetDeviceTier(candidate.properties.deviceType);
+		candidate.score = ScoreDevice(device, candidate.breakdown);
+		candidates.emplace_back(candidate);
 	}
 
-	auto it = std::find_if(physical_devices.cbegin(), physical_devices.cend(), [this](const auto& d)
+	// A device asked for by enumeration index or part of its name wins over the scores
+	std::optional<size_t> preferred;
+	if(!preferred_device.empty())
 	{
-		return IsDeviceSuitable(d);
-	});
+		auto ToLower = [](std::string text)
+		{
+			std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return std::tolower(c); });
+			return text;
+		};
+
+		bool is_index = std::all_of(preferred_device.cbegin(), preferred_device.cend(), [](unsigned char c) { return std::isdigit(c); });
+		if(is_index)
+		{
+			// Compared as text, so a digit string too long for any integer type is just out of range
+			auto index = preferred_device.substr(std::min(preferred_device.find_first_not_of('0'), preferred_device.size() - 1));
+			for(size_t i = 0; i < candidates.size() && !preferred.has_value(); i++)
+			{
+				if(index == std::to_string(i))
+				{
+					preferred = i;
+				}
+			}
+
+			if(!preferred.has_value())
+			{
+				Error("Physical device index " + preferred_device + " is out of range, there are " + std::to_string(candidates.size()));
+			}
+		}
+		else
+		{
+			auto preferred_name = ToLower(preferred_device);
+			for(size_t i = 0; i < candidates.size() && !preferred.has_value(); i++)
+			{
+				if(ToLower(candidates[i].properties.deviceName).find(preferred_name) != std::string::npos)
+				{
+					preferred = i;
+				}
+			}
+
+			if(!preferred.has_value())
+			{
+				Error("No physical device matches \"" + preferred_device + "\"");
+			}
+		}
+		if(!candidates[*preferred].unsuitable_reason.empty())
+		{
+			Error(std::string("Physical device ") + candidates[*preferred].properties.deviceName + " can't be used, " + candidates[*preferred].unsuitable_reason);
+		}
+	}
 
-	if(it == physical_devices.end())
+	// The highest tier wins, then the highest score, the first one wins a tie, keeping the loader's order
+	std::optional<size_t> chosen = preferred;
+	for(size_t i = 0; i < candidates.size() && !preferred.has_value(); i++)
 	{
-		throw std::runtime_error("Failed to find a suitable GPU");
+		if(candidates[i].unsuitable_reason.empty() &&
+		   (!chosen.has_value() || std::tie(candidates[i].tier, candidates[i].score) > std::tie(candidates[*chosen].tier, candidates[*chosen].score)))
+		{
+			chosen = i;
+		}
 	}
-	physical_device = *it;
 
-	VkPhysicalDeviceProperties physical_device_properties;
-	vkGetPhysicalDeviceProperties(physical_device, &physical_device_properties);
+	std::cout << "Available physical devices: " << std::endl;
+	for(size_t i = 0; i < candidates.size(); i++)
+	{
+		const auto& candidate = candidates[i];
+		std::cout << "  [" << i << "] " << candidate.properties.deviceName << " - " << string_VkPhysicalDeviceType(candidate.properties.deviceType) << ": ";
 
-	std::cout << "Physical device: " << physical_device_properties.deviceName << std::endl;
+		if(chosen == i)
+		{
+			std::cout << (preferred.has_value() ? "requested" : "selected") << ", score " << candidate.score;
+		}
+		else if(!candidate.unsuitable_reason.empty())
+		{
+			std::cout << "lost, " << candidate.unsuitable_reason;
+		}
+		else if(preferred.has_value())
+		{
+			std::cout << "lost, not the requested device, score " << candidate.score;
+		}
+		else if(candidate.tier != candidates[*chosen].tier)
+		{
+			std::cout << "lost, " << string_VkPhysicalDeviceType(candidate.properties.deviceType) << " against "
+			          << string_VkPhysicalDeviceType(candidates[*chosen].properties.deviceType) << ", score " << candidate.score;
+		}
+		else
+		{
+			std::cout << "lost, score " << candidate.score << " against " << candidates[*chosen].score;
+		}
+
+		if(candidate.unsuitable_reason.empty())
+		{
+			std::cout << " (" << candidate.breakdown << ")";
+		}
+		std::cout << std::endl;
+	}
+
+	if(!chosen.has_value())
+	{
+		throw std::runtime_error("Failed to find a suitable GPU");
+	}
+	physical_device = candidates[*chosen].device;
+
+	std::cout << "Physical device: " << candidates[*chosen].properties.deviceName << std::endl;
 }
 
 uint32_t vkpg::VulkanDevice::FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const
@@ -213,6 +688,22 @@ uint32_t vkpg::VulkanDevice::FindMemoryType(uint32_t type_filter, VkMemoryProper
 	throw std::runtime_error("failed to find suitable memory type");
 }
 
+bool vkpg::VulkanDevice::HasMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const
+{
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+
+	for(uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+	{
+		if((type_filter & (1 << i)) && (memory_properties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
 void vkpg::VulkanDevice::CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
                                       VkBuffer& buffer, VkDeviceMemory& buffer_memory)
 {
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "device_dispatch.hpp"
+
 #include <vulkan/vulkan.h>
 
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace vkpg
@@ -18,7 +21,10 @@ public:
 		std::optional<uint32_t> graphics_family;
 		// TODO: check if "present" is suitable name
 		std::optional<uint32_t> present_family;
-		// TODO: add "compute" or "transfer" field
+		// Families without graphics that run next to the graphics queue, empty when the device has none
+		std::optional<uint32_t> compute_family;
+		// Neither graphics nor compute, usually a copy engine
+		std::optional<uint32_t> transfer_family;
 
 		bool IsComplete() const
 		{
@@ -29,6 +35,48 @@ public:
 	VkPhysicalDevice physical_device;
 	VkDevice logical_device;
 
+	// Only created for the dedicated families, the graphics and present queues are in the swap chain
+	VkQueue compute_queue{VK_NULL_HANDLE};
+	VkQueue transfer_queue{VK_NULL_HANDLE};
+
+	// API version the instance was created with, set before PickPhysicalDevice
+	uint32_t api_version = VK_API_VERSION_1_0;
+
+	// Enumeration index or part of the name of the device PickPhysicalDevice has to use, empty to pick the highest
+	// scoring one
+	std::string preferred_device;
+
+	// Per-frame commands bypassing the loader, loaded by CreateLogicalDevice
+	vkpg::DeviceDispatch dispatch;
+
+	// Descriptor indexing (core in 1.2, VK_EXT_descriptor_indexing before that) with the features bindless textures need
+	bool descriptor_indexing_enabled = false;
+	bool multi_draw_indirect_enabled = false;
+	// Storage images with formats like rg32f, needed by the depth pyramid
+	bool storage_image_extended_formats_enabled = false;
+	// Line and point polygon modes, needed by the wireframe material
+	bool fill_mode_non_solid_enabled = false;
+
+	// VK_EXT_extended_dynamic_state, its commands are only valid when enabled
+	bool extended_dynamic_state_enabled = false;
+	PFN_vkCmdSetCullModeEXT cmd_set_cull_mode = nullptr;
+	PFN_vkCmdSetFrontFaceEXT cmd_set_front_face = nullptr;
+	PFN_vkCmdSetDepthTestEnableEXT cmd_set_depth_test_enable = nullptr;
+	PFN_vkCmdSetDepthWriteEnableEXT cmd_set_depth_write_enable = nullptr;
+	PFN_vkCmdSetDepthCompareOpEXT cmd_set_depth_compare_op = nullptr;
+
+	// VK_EXT_mesh_shader with task shaders, only looked for on Vulkan 1.2 where SPIR-V 1.4 is core
+	bool mesh_shader_enabled = false;
+	PFN_vkCmdDrawMeshTasksEXT cmd_draw_mesh_tasks = nullptr;
+
+	// Core in 1.3, VK_KHR_dynamic_rendering and VK_KHR_synchronization2 on 1.2. Their commands are only valid when enabled.
+	bool dynamic_rendering_enabled = false;
+	PFN_vkCmdBeginRendering cmd_begin_rendering = nullptr;
+	PFN_vkCmdEndRendering cmd_end_rendering = nullptr;
+
+	bool synchronization2_enabled = false;
+	PFN_vkCmdPipelineBarrier2 cmd_pipeline_barrier2 = nullptr;
+
 	const VkInstance& instance;
 	vkpg::VulkanSwapChain& swap_chain;
 	VkSurfaceKHR& surface;
@@ -45,10 +93,18 @@ public:
 
 	void CreateLogicalDevice();
 	QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device) const;
+	// Empty if the device can run the renderer, otherwise what it is missing
+	std::string GetUnsuitableReason(VkPhysicalDevice device);
 	bool IsDeviceSuitable(VkPhysicalDevice device);
+	// Devices are compared by their type tier first, the score only decides between devices of the same type
+	static uint32_t GetDeviceTier(VkPhysicalDeviceType type);
+	// Higher is expected to be faster, breakdown lists what the score is made of
+	uint64_t ScoreDevice(VkPhysicalDevice device, std::string& breakdown) const;
 	bool CheckDeviceExtensionSupport(VkPhysicalDevice device);
+	bool IsExtensionSupported(VkPhysicalDevice device, const char* extension_name) const;
 	void PickPhysicalDevice();
 	uint32_t FindMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
+	bool HasMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties) const;
 	void CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
 	                  VkBuffer& buffer, VkDeviceMemory& buffer_memory);
 
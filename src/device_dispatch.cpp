@@ -0,0 +1,59 @@
+#include "device_dispatch.hpp"
+#include "utils.hpp"
+
+#include <string>
+
+namespace
+{
+
+template <typename T>
+void LoadFunction(VkDevice device, T& function, const char *name)
+{
+	function = reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+	if(function == nullptr)
+	{
+		Error(std::string("Failed to load ") + name);
+	}
+}
+
+} // namespace
+
+void vkpg::DeviceDispatch::Load(VkDevice device)
+{
+	LoadFunction(device, begin_command_buffer, "vkBeginCommandBuffer");
+	LoadFunction(device, end_command_buffer, "vkEndCommandBuffer");
+	LoadFunction(device, cmd_begin_render_pass, "vkCmdBeginRenderPass");
+	LoadFunction(device, cmd_next_subpass, "vkCmdNextSubpass");
+	LoadFunction(device, cmd_end_render_pass, "vkCmdEndRenderPass");
+	LoadFunction(device, cmd_bind_pipeline, "vkCmdBindPipeline");
+	LoadFunction(device, cmd_bind_descriptor_sets, "vkCmdBindDescriptorSets");
+	LoadFunction(device, cmd_bind_vertex_buffers, "vkCmdBindVertexBuffers");
+	LoadFunction(device, cmd_bind_index_buffer, "vkCmdBindIndexBuffer");
+	LoadFunction(device, cmd_push_constants, "vkCmdPushConstants");
+	LoadFunction(device, cmd_set_viewport, "vkCmdSetViewport");
+	LoadFunction(device, cmd_set_scissor, "vkCmdSetScissor");
+	LoadFunction(device, cmd_draw_indexed, "vkCmdDrawIndexed");
+	LoadFunction(device, cmd_draw_indexed_indirect, "vkCmdDrawIndexedIndirect");
+	LoadFunction(device, cmd_dispatch, "vkCmdDispatch");
+	LoadFunction(device, cmd_pipeline_barrier, "vkCmdPipelineBarrier");
+	LoadFunction(device, cmd_copy_buffer, "vkCmdCopyBuffer");
+	LoadFunction(device, cmd_copy_buffer_to_image, "vkCmdCopyBufferToImage");
+	LoadFunction(device, cmd_copy_image_to_buffer, "vkCmdCopyImageToBuffer");
+	LoadFunction(device, cmd_blit_image, "vkCmdBlitImage");
+	LoadFunction(device, cmd_reset_query_pool, "vkCmdResetQueryPool");
+	LoadFunction(device, cmd_write_timestamp, "vkCmdWriteTimestamp");
+
+	LoadFunction(device, queue_submit, "vkQueueSubmit");
+	LoadFunction(device, queue_wait_idle, "vkQueueWaitIdle");
+	LoadFunction(device, acquire_next_image, "vkAcquireNextImageKHR");
+	LoadFunction(device, queue_present, "vkQueuePresentKHR");
+	LoadFunction(device, wait_for_fences, "vkWaitForFences");
+	LoadFunction(device, reset_fences, "vkResetFences");
+
+	LoadFunction(device, map_memory, "vkMapMemory");
+	LoadFunction(device, unmap_memory, "vkUnmapMemory");
+	LoadFunction(device, allocate_descriptor_sets, "vkAllocateDescriptorSets");
+	LoadFunction(device, update_descriptor_sets, "vkUpdateDescriptorSets");
+	LoadFunction(device, reset_descriptor_pool, "vkResetDescriptorPool");
+	LoadFunction(device, get_query_pool_results, "vkGetQueryPoolResults");
+}
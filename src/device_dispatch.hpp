@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace vkpg
+{
+
+// Device level commands fetched with vkGetDeviceProcAddr. The exported vk* functions are loader trampolines that
+// look up the device's dispatch table on every call, these point at the first layer or the driver directly.
+// Only commands recorded or called every frame are here, creating and destroying objects goes through the loader.
+struct DeviceDispatch
+{
+	// Command buffers
+	PFN_vkBeginCommandBuffer begin_command_buffer = nullptr;
+	PFN_vkEndCommandBuffer end_command_buffer = nullptr;
+	PFN_vkCmdBeginRenderPass cmd_begin_render_pass = nullptr;
+	PFN_vkCmdNextSubpass cmd_next_subpass = nullptr;
+	PFN_vkCmdEndRenderPass cmd_end_render_pass = nullptr;
+	PFN_vkCmdBindPipeline cmd_bind_pipeline = nullptr;
+	PFN_vkCmdBindDescriptorSets cmd_bind_descriptor_sets = nullptr;
+	PFN_vkCmdBindVertexBuffers cmd_bind_vertex_buffers = nullptr;
+	PFN_vkCmdBindIndexBuffer cmd_bind_index_buffer = nullptr;
+	PFN_vkCmdPushConstants cmd_push_constants = nullptr;
+	PFN_vkCmdSetViewport cmd_set_viewport = nullptr;
+	PFN_vkCmdSetScissor cmd_set_scissor = nullptr;
+	PFN_vkCmdDrawIndexed cmd_draw_indexed = nullptr;
+	PFN_vkCmdDrawIndexedIndirect cmd_draw_indexed_indirect = nullptr;
+	PFN_vkCmdDispatch cmd_dispatch = nullptr;
+	PFN_vkCmdPipelineBarrier cmd_pipeline_barrier = nullptr;
+	PFN_vkCmdCopyBuffer cmd_copy_buffer = nullptr;
+	PFN_vkCmdCopyBufferToImage cmd_copy_buffer_to_image = nullptr;
+	PFN_vkCmdCopyImageToBuffer cmd_copy_image_to_buffer = nullptr;
+	PFN_vkCmdBlitImage cmd_blit_image = nullptr;
+	PFN_vkCmdResetQueryPool cmd_reset_query_pool = nullptr;
+	PFN_vkCmdWriteTimestamp cmd_write_timestamp = nullptr;
+
+	// Queues and synchronization
+	PFN_vkQueueSubmit queue_submit = nullptr;
+	PFN_vkQueueWaitIdle queue_wait_idle = nullptr;
+	PFN_vkAcquireNextImageKHR acquire_next_image = nullptr;
+	PFN_vkQueuePresentKHR queue_present = nullptr;
+	PFN_vkWaitForFences wait_for_fences = nullptr;
+	PFN_vkResetFences reset_fences = nullptr;
+
+	// Memory, descriptors and queries
+	PFN_vkMapMemory map_memory = nullptr;
+	PFN_vkUnmapMemory unmap_memory = nullptr;
+	PFN_vkAllocateDescriptorSets allocate_descriptor_sets = nullptr;
+	PFN_vkUpdateDescriptorSets update_descriptor_sets = nullptr;
+	PFN_vkResetDescriptorPool reset_descriptor_pool = nullptr;
+	PFN_vkGetQueryPoolResults get_query_pool_results = nullptr;
+
+	// VK_KHR_swapchain has to be enabled on the device
+	void Load(VkDevice device);
+};
+
+} // namespace vkpg
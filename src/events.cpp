@@ -2,6 +2,8 @@
 
 #include <GLFW/glfw3.h>
 
+#include <utility>
+
 void vkpg::Events::KeyCallback(void *window, int key, int scancode, int action, int mods)
 {
 	auto glfw_window = static_cast<GLFWwindow*>(window);
@@ -63,6 +65,22 @@ void vkpg::Events::MouseButtonCallback(void *window, int button, int action, int
 	{
 		if(action == GLFW_PRESS)   mouse_buttons.left = true;
 		if(action == GLFW_RELEASE) mouse_buttons.left = false;
+
+		if(action == GLFW_PRESS)
+		{
+			press_pos = mouse_pos;
+		}
+
+		// Releasing after a drag only ends the camera rotation
+		if(action == GLFW_RELEASE && click_callback && glm::length(mouse_pos - press_pos) < 3.0f)
+		{
+			int width, height;
+			glfwGetWindowSize(static_cast<GLFWwindow*>(window), &width, &height);
+			if(width > 0 && height > 0)
+			{
+				click_callback(mouse_pos / glm::vec2(width, height));
+			}
+		}
 	}
 	if(button == GLFW_MOUSE_BUTTON_RIGHT)
 	{
@@ -76,6 +94,11 @@ void vkpg::Events::MouseButtonCallback(void *window, int button, int action, int
 	}
 }
 
+void vkpg::Events::SetClickCallback(std::function<void(glm::vec2)> callback)
+{
+	click_callback = std::move(callback);
+}
+
 void vkpg::Events::CursorPositionCallback(void *window, double x, double y)
 {
 	auto dx = mouse_pos.x - x;
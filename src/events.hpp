@@ -4,6 +4,8 @@
 
 #include "camera.hpp"
 
+#include <functional>
+
 namespace vkpg
 {
 
@@ -16,10 +18,16 @@ public:
 	void MouseButtonCallback(void* window, int button, int action, int mods);
 	void CursorPositionCallback(void* window, double x, double y);
 
+	// Called for a left click that didn't drag the camera, with the cursor position in 0..1 window coordinates
+	void SetClickCallback(std::function<void(glm::vec2)> callback);
+
 private:
 	Camera& camera;
 
+	std::function<void(glm::vec2)> click_callback;
+
 	glm::vec2 mouse_pos;
+	glm::vec2 press_pos;
 	glm::vec3 object_rotation;
 
 	struct
@@ -0,0 +1,120 @@
+#include "frame_stats.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+namespace
+{
+
+// Nearest rank on sorted samples
+double Percentile(const std::vector<double>& sorted, double percentile)
+{
+	auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(sorted.size())));
+	return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::string EscapeJson(const std::string& text)
+{
+	std::string escaped;
+	for(auto c : text)
+	{
+		if(c == '"' || c == '\\')
+		{
+			escaped += '\\';
+			escaped += c;
+		}
+		else if(static_cast<unsigned char>(c) < 0x20)
+		{
+			escaped += ' ';
+		}
+		else
+		{
+			escaped += c;
+		}
+	}
+	return escaped;
+}
+
+} // namespace
+
+void vkpg::FrameStats::AddSample(const std::string& name, double milliseconds)
+{
+	auto it = std::find_if(series.begin(), series.end(), [&name](const auto& samples)
+	{
+		return samples.first == name;
+	});
+
+	if(it == series.end())
+	{
+		series.emplace_back(name, std::vector<double>());
+		it = series.end() - 1;
+	}
+
+	it->second.push_back(milliseconds);
+}
+
+void vkpg::FrameStats::Clear()
+{
+	series.clear();
+}
+
+std::vector<vkpg::FrameStats::Summary> vkpg::FrameStats::Summarize() const
+{
+	std::vector<Summary> summaries;
+	for(const auto& [name, samples] : series)
+	{
+		auto sorted = samples;
+		std::sort(sorted.begin(), sorted.end());
+
+		Summary summary;
+		summary.name = name;
+		summary.count = sorted.size();
+		summary.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / static_cast<double>(sorted.size());
+		summary.min = sorted.front();
+		summary.p50 = Percentile(sorted, 50.0);
+		summary.p90 = Percentile(sorted, 90.0);
+		summary.p95 = Percentile(sorted, 95.0);
+		summary.p99 = Percentile(sorted, 99.0);
+		summary.max = sorted.back();
+
+		summaries.push_back(summary);
+	}
+
+	return summaries;
+}
+
+void vkpg::FrameStats::WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const
+{
+	std::ofstream file(path);
+	if(!file)
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+
+	file << "{\n";
+	for(const auto& [key, value] : info)
+	{
+		file << "\t\"" << EscapeJson(key) << "\": \"" << EscapeJson(value) << "\",\n";
+	}
+
+	file << "\t\"series\": {";
+	auto summaries = Summarize();
+	for(size_t i = 0; i < summaries.size(); i++)
+	{
+		const auto& summary = summaries[i];
+		file << (i > 0 ? ",\n" : "\n")
+		     << "\t\t\"" << EscapeJson(summary.name) << "\": {"
+		     << "\"count\": " << summary.count
+		     << ", \"mean\": " << summary.mean
+		     << ", \"min\": " << summary.min
+		     << ", \"p50\": " << summary.p50
+		     << ", \"p90\": " << summary.p90
+		     << ", \"p95\": " << summary.p95
+		     << ", \"p99\": " << summary.p99
+		     << ", \"max\": " << summary.max << "}";
+	}
+	file << "\n\t}\n}\n";
+}
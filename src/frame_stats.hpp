@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace vkpg
+{
+
+// Collects one time sample per frame for named series (frame time, CPU stages, GPU passes) and summarizes them
+// with percentiles, which show hitches an average hides
+class FrameStats
+{
+public:
+	struct Summary
+	{
+		std::string name;
+		size_t count = 0;
+		double mean = 0.0;
+		double min = 0.0;
+		double p50 = 0.0;
+		double p90 = 0.0;
+		double p95 = 0.0;
+		double p99 = 0.0;
+		double max = 0.0;
+	};
+
+	void AddSample(const std::string& name, double milliseconds);
+	void Clear();
+
+	// In the order the series were first added
+	std::vector<Summary> Summarize() const;
+
+	// Writes the summaries and the info strings (device, options, ...) as one JSON object
+	void WriteJson(const std::string& path, const std::vector<std::pair<std::string, std::string>>& info) const;
+
+private:
+	std::vector<std::pair<std::string, std::vector<double>>> series;
+};
+
+} // namespace vkpg
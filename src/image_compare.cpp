@@ -0,0 +1,61 @@
+#include "image_compare.hpp"
+
+// The implementation is compiled into swapchain.cpp
+#undef STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace
+{
+
+using ImagePointer = std::unique_ptr<stbi_uc, decltype(&stbi_image_free)>;
+
+ImagePointer LoadImage(const std::string& path, int& width, int& height)
+{
+	int channels;
+	ImagePointer pixels(stbi_load(path.c_str(), &width, &height, &channels, STBI_rgb), &stbi_image_free);
+	if(!pixels)
+	{
+		throw std::runtime_error("Failed to load image " + path);
+	}
+
+	return pixels;
+}
+
+} // namespace
+
+vkpg::ImageDifference vkpg::CompareImages(const std::string& path, const std::string& reference_path)
+{
+	int width, height, reference_width, reference_height;
+	auto pixels = LoadImage(path, width, height);
+	auto reference_pixels = LoadImage(reference_path, reference_width, reference_height);
+
+	if(width != reference_width || height != reference_height)
+	{
+		throw std::runtime_error("Image " + path + " is " + std::to_string(width) + "x" + std::to_string(height) +
+		                         ", the reference is " + std::to_string(reference_width) + "x" + std::to_string(reference_height));
+	}
+
+	ImageDifference difference;
+
+	auto size = static_cast<size_t>(width) * height * 3;
+	double squared_error_sum = 0.0;
+	for(size_t i = 0; i < size; i++)
+	{
+		auto channel_difference = std::abs(static_cast<int>(pixels.get()[i]) - static_cast<int>(reference_pixels.get()[i]));
+		squared_error_sum += static_cast<double>(channel_difference * channel_difference);
+		difference.max_difference = std::max(difference.max_difference, channel_difference);
+	}
+
+	auto mean_squared_error = squared_error_sum / static_cast<double>(size);
+	difference.psnr = mean_squared_error > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mean_squared_error)
+	                                           : std::numeric_limits<double>::infinity();
+
+	return difference;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <string>
+
+namespace vkpg
+{
+
+struct ImageDifference
+{
+	// Over RGB, infinite for identical images
+	double psnr = 0.0;
+	// Largest difference of a single channel, 0..255
+	int max_difference = 0;
+};
+
+// Compares two 8 bit images of the same size, throws if one can't be loaded or the sizes differ
+ImageDifference CompareImages(const std::string& path, const std::string& reference_path);
+
+} // namespace vkpg
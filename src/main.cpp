@@ -1,12 +1,21 @@
 #include <vulkan/vulkan.h>
 
 #include "utils.hpp"
+#include "bvh.hpp"
+#include "camera_path.hpp"
 #include "device.hpp"
 #include "swapchain.hpp"
 #include "window.hpp"
 #include "debug.hpp"
 #include "camera.hpp"
 #include "events.hpp"
+#include "frame_stats.hpp"
+#include "image_compare.hpp"
+#include "mesh_optimizer.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet.hpp"
+#include "resolution.hpp"
+#include "scene.hpp"
 
 #include "tiny_obj_loader.h"
 
@@ -17,10 +26,19 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_vulkan.h>
 
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <iostream>
+#include <limits>
+#include <map>
 #include <optional>
+#include <random>
 #include <set>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 
@@ -28,6 +46,38 @@ const int MAX_FRAMES_IN_FLIGHT = 2;
 
 constexpr auto MODEL_PATH = "resources/models/viking_room.obj";
 
+struct GoldenView
+{
+	const char *name;
+	glm::vec3 camera_position;
+	glm::vec3 camera_rotation;
+};
+
+// Camera views rendered and compared by --golden, changing one invalidates its golden image
+const std::array<GoldenView, 3> GOLDEN_VIEWS =
+{{
+	{"default", {1.0f, 0.75f, 0.0f}, {0.0f, 90.0f, 0.0f}},
+	{"corner", {1.0f, 0.75f, 0.0f}, {0.0f, 60.0f, 0.0f}},
+	{"floor", {1.0f, 0.75f, 0.0f}, {-25.0f, 90.0f, 0.0f}},
+}};
+
+// Played by --golden after the fixed views and captured at every keyframe and halfway between them, so the
+// interpolation is covered too. Changing it invalidates the path's golden images.
+const std::array<vkpg::CameraPath::Keyframe, 4> GOLDEN_PATH =
+{{
+	{0.0f, {1.0f, 0.75f, 0.0f}, {0.0f, 90.0f, 0.0f}},
+	{1.0f, {0.8f, 0.6f, 0.3f}, {-10.0f, 75.0f, 0.0f}},
+	{2.0f, {0.6f, 0.5f, 0.0f}, {-20.0f, 90.0f, 0.0f}},
+	{3.0f, {0.8f, 0.6f, -0.3f}, {-10.0f, 105.0f, 0.0f}},
+}};
+
+// Exit code of a golden run with missing golden images and no failures, CTest reports the test as skipped
+constexpr int GOLDEN_SKIPPED_EXIT_CODE = 77;
+
+// Window size the golden images are rendered at, changing it invalidates all of them
+constexpr uint32_t GOLDEN_WIDTH = 800;
+constexpr uint32_t GOLDEN_HEIGHT = 600;
+
 glm::vec3 model_position{};
 
 class Application
@@ -40,10 +90,70 @@ public:
 	    camera(), events(camera)
 	{};
 
+	struct Options
+	{
+		bool dynamic_resolution = false;
+		bool compact_vertices = false;
+		bool optimize_mesh = false;
+		bool generate_lods = false;
+		bool meshlets = false;
+		// Clicks read the object ID attachment instead of casting a ray against the scene BVH
+		bool object_ids = false;
+		// Draws the UI in a subpass of the scene render pass
+		bool ui_subpass = false;
+		// Renders without render passes and framebuffers where the device allows it
+		bool dynamic_rendering = false;
+		// Culls meshlets on a dedicated compute queue
+		bool async_compute = false;
+		// Keeps the scene depth and builds a min/max depth pyramid from it every frame
+		bool depth_pyramid = false;
+		// Enumeration index or part of the name of the GPU to render on, empty for the highest scoring one.
+		// VKPG_GPU sets it too, the command line wins.
+		std::string gpu;
+		// Starting tier, it can be switched in the GPU window
+		vkpg::AntiAliasing anti_aliasing;
+		// Adds this many animated nodes below the model to stress the scene update, they are not drawn
+		uint32_t scene_nodes = 0;
+		// Measures BVH build, refit and query speed without opening a window, then exits
+		bool bvh_benchmark = false;
+		// Measures the cost of calling commands through the loader instead of the device's dispatch table, then exits
+		bool dispatch_benchmark = false;
+		// Renders this many frames, prints frame time percentiles and exits, 0 runs until the window is closed
+		// or, with a camera path, until the path has been played once
+		uint32_t benchmark_frames = 0;
+		// Keyframe file driving the camera during a benchmark, see vkpg::CameraPath
+		std::string camera_path;
+		// Saves the live camera as a keyframe file on exit, one keyframe per frame for playback at the same step
+		std::string record_camera_path;
+		// Writes the benchmark results here as JSON
+		std::string benchmark_json;
+		// Writes every frame into this directory as PNGs from the start, empty to only capture from the UI
+		std::string capture_sequence;
+		// Renders GOLDEN_VIEWS and the stops along GOLDEN_PATH, or along camera_path when one is given, compares them
+		// against the images in this directory and exits
+		std::string golden_directory;
+		// Writes the golden images instead of comparing against them
+		bool update_golden = false;
+		// Lowest PSNR in dB that still passes, allows for driver differences in filtering and rasterization
+		double golden_min_psnr = 40.0;
+	} options;
+
+	// Set when a golden image comparison failed or could not be made
+	bool golden_failed = false;
+	// Cases without a golden image to compare against
+	uint32_t golden_skipped = 0;
+
 	void Run()
 	{
 		InitVulkan();
-		MainLoop();
+		if(options.dispatch_benchmark)
+		{
+			RunDispatchBenchmark();
+		}
+		else
+		{
+			MainLoop();
+		}
 		Cleanup();
 	}
 
@@ -58,6 +168,64 @@ private:
 	vkpg::Camera camera;
 	vkpg::Events events;
 
+	vkpg::DynamicResolution dynamic_resolution;
+
+	// Bounding sphere of the model in model space, for LOD selection
+	glm::vec3 mesh_center{};
+	float mesh_radius = 0.0f;
+	vkpg::Aabb mesh_bounds;
+	float lod_pixel_error = 1.0f;
+
+	vkpg::Scene scene;
+	uint32_t model_node = 0;
+	// Children of the model node, rotating them dirties every node below
+	std::vector<uint32_t> animated_nodes;
+	bool animate_scene = false;
+	int scene_threads = 1;
+	double scene_update_time = 0.0;
+	uint32_t scene_updated_nodes = 0;
+
+	// World space bounds of every scene node, each stands for a copy of the model
+	std::vector<vkpg::Aabb> node_bounds;
+	vkpg::Bvh scene_bvh;
+	std::vector<uint32_t> visible_nodes;
+	std::optional<uint32_t> picked_node;
+
+	uint32_t screenshot_count = 0;
+
+	// Render extent of the frame the profiler's results are from
+	VkExtent2D profiled_render_extent{};
+
+	// Last measured GPU milliseconds of the scene and FXAA passes of every tier that was used
+	std::map<std::string, double> anti_aliasing_costs;
+
+	// Filled by DrawFrame, CPU milliseconds of its stages in the last frame
+	std::vector<std::pair<std::string, double>> cpu_stage_times;
+	vkpg::FrameStats frame_stats;
+
+	// A fixed view, or a stop the camera moves to along golden_path during the warmup
+	struct GoldenCase
+	{
+		std::string name;
+		glm::vec3 camera_position{0.0f};
+		glm::vec3 camera_rotation{0.0f};
+		bool on_path = false;
+		float path_start = 0.0f;
+		float path_end = 0.0f;
+	};
+
+	// Lets pipelines, LOD selection and dynamic resolution settle, then times the case before capturing it
+	static constexpr uint32_t golden_warmup_frames = 30;
+	static constexpr uint32_t golden_measured_frames = 30;
+
+	std::vector<GoldenCase> golden_cases;
+	vkpg::CameraPath golden_path;
+	size_t golden_case = 0;
+	uint32_t golden_frame = 0;
+	double golden_frame_time_sum = 0.0;
+	// Ticket of the view's screenshot request, 0 until it is requested
+	uint32_t golden_screenshot = 0;
+
 	std::vector<VkSemaphore> image_available_semaphores;
 	std::vector<VkSemaphore> render_finished_semaphores;
 	std::vector<VkFence> in_flight_fences;
@@ -68,6 +236,13 @@ private:
 
 	void InitVulkan()
 	{
+		if(!options.golden_directory.empty())
+		{
+			// Golden images have to be rendered the same way on every run, the LOD is locked in DrawFrame and input is ignored
+			window.SetFixedSize(GOLDEN_WIDTH, GOLDEN_HEIGHT);
+			options.dynamic_resolution = false;
+		}
+
 		window.Init();
 		CreateInstance();
 		vkpg::Debug::SetupDebugging(instance);
@@ -83,7 +258,7 @@ private:
 		});
 		window.SetKeyCallback([this](void *window, int key, int scancode, int action, int mods)
 		{
-			if(ImGui::GetIO().WantCaptureKeyboard)
+			if(ImGui::GetIO().WantCaptureKeyboard || !options.golden_directory.empty())
 			{
 				return;
 			}
@@ -92,7 +267,7 @@ private:
 		});
 		window.SetMouseButtonCallback([this](void *window, int button, int action, int mods)
 		{
-			if(ImGui::GetIO().WantCaptureMouse)
+			if(ImGui::GetIO().WantCaptureMouse || !options.golden_directory.empty())
 			{
 				return;
 			}
@@ -101,37 +276,87 @@ private:
 		});
 		window.SetCursorPositionCallback([this](void *window, int x, int y)
 		{
+			if(!options.golden_directory.empty())
+			{
+				return;
+			}
+
 			events.CursorPositionCallback(window, x, y);
 		});
+		events.SetClickCallback([this](glm::vec2 position)
+		{
+			if(swap_chain.object_id_enabled)
+			{
+				swap_chain.RequestObjectId(static_cast<uint32_t>(position.x * swap_chain.extent.width),
+				                           static_cast<uint32_t>(position.y * swap_chain.extent.height));
+			}
+			else
+			{
+				Pick(position);
+			}
+		});
 
+		vulkan_device.preferred_device = options.gpu;
 		vulkan_device.PickPhysicalDevice();
 		vulkan_device.CreateLogicalDevice();
+		swap_chain.CreatePipelineCache();
+		swap_chain.dynamic_resolution_enabled = options.dynamic_resolution;
+		swap_chain.compact_vertices_enabled = options.compact_vertices;
+		swap_chain.meshlets_enabled = options.meshlets;
+		swap_chain.object_id_enabled = options.object_ids;
+		swap_chain.ui_subpass_enabled = options.ui_subpass;
+		swap_chain.dynamic_rendering_enabled = options.dynamic_rendering;
+		swap_chain.async_compute_enabled = options.async_compute;
+		swap_chain.depth_pyramid_enabled = options.depth_pyramid;
+		swap_chain.anti_aliasing = options.anti_aliasing;
 		swap_chain.Create();
 		swap_chain.CreateImageViews();
 		swap_chain.CreateRenderPass();
 		swap_chain.CreateUiRenderPass();
 		swap_chain.CreateDescriptorSetLayout();
+		swap_chain.CreateBindlessDescriptorSetLayout();
 		swap_chain.CreateGraphicsPipeline();
+		swap_chain.CreateMeshletPipelines();
 		swap_chain.CreateCommandPool();
 		swap_chain.CreateUiCommandPool();
+		swap_chain.CreateDepthPyramid();
 		swap_chain.CreateColorResources();
 		swap_chain.CreateDepthResources();
+		swap_chain.CreateObjectIdResources();
+		swap_chain.CreateSceneResources();
+		swap_chain.CreateRenderGraph();
+		swap_chain.CreateCaptureResources();
 		swap_chain.CreateFramebuffers();
 		swap_chain.CreateUiFramebuffers();
+		swap_chain.CreateMipGenerator();
 		swap_chain.CreateTextureImage();
 		swap_chain.CreateTextureImageView();
 		swap_chain.CreateTextureSampler();
 		LoadModel();
+		CreateScene();
 		swap_chain.CreateVertexBuffer();
 		swap_chain.CreateIndexBuffer();
 		swap_chain.CreateUniformBuffers();
-		swap_chain.CreateDescriptorPool();
+		swap_chain.CreateDescriptorAllocators();
 		swap_chain.CreateUiDescriptorPool();
 		swap_chain.CreateDescriptorSets();
+		swap_chain.CreateBindlessDescriptorPool();
+		swap_chain.CreateBindlessDescriptorSet();
+		swap_chain.CreateIndirectBuffer();
+		swap_chain.CreateAsyncCompute();
+		swap_chain.CreateMeshletResources();
+		swap_chain.CreatePickResources();
+		swap_chain.CreateFxaaPipeline();
+		swap_chain.CreateProfiler();
 		swap_chain.CreateCommandBuffers();
 		swap_chain.CreateUiCommandBuffers();
 		CreateSyncObjects();
 
+		if(!options.capture_sequence.empty())
+		{
+			swap_chain.capture.StartSequence(options.capture_sequence);
+		}
+
 		//InitImGui();
 		{
 			IMGUI_CHECKVERSION();
@@ -145,6 +370,11 @@ private:
 			io.DisplayFramebufferScale = ImVec2(1.0f, 1.0f);
 
 			ImGui_ImplGlfw_InitForVulkan(window.GetNativeHandler(), true);
+			if(!options.golden_directory.empty())
+			{
+				// The UI can be part of the capture, hovering it would change the image
+				io.ConfigFlags |= ImGuiConfigFlags_NoMouse;
+			}
 			ImGui_ImplVulkan_InitInfo init_info = {};
 			init_info.Instance = instance;
 			init_info.PhysicalDevice = vulkan_device.physical_device;
@@ -153,16 +383,19 @@ private:
 			init_info.Queue = swap_chain.graphics_queue;
 			init_info.PipelineCache = swap_chain.pipeline_cache;
 			init_info.DescriptorPool = swap_chain.ui_descriptor_pool;
-			init_info.Subpass = 0;
+			init_info.Subpass = swap_chain.ui_subpass_enabled ? 1 : 0;
 			init_info.MinImageCount = MAX_FRAMES_IN_FLIGHT;
 			init_info.ImageCount = swap_chain.image_count;
 			init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+			// Without a UI render pass ImGui's pipeline is built for the swap chain format
+			init_info.UseDynamicRendering = swap_chain.dynamic_rendering_enabled;
+			init_info.ColorAttachmentFormat = swap_chain.GetImageFormat();
 			init_info.Allocator = nullptr;
 			init_info.CheckVkResultFn = [](VkResult result)
 			{
 				CheckVkResult(result);
 			};
-			ImGui_ImplVulkan_Init(&init_info, swap_chain.ui_render_pass);
+			ImGui_ImplVulkan_Init(&init_info, swap_chain.ui_subpass_enabled ? swap_chain.render_pass : swap_chain.ui_render_pass);
 
 			VkCommandBuffer command_buffer = swap_chain.BeginSingleTimeCommands(swap_chain.ui_command_pool);
 			ImGui_ImplVulkan_CreateFontsTexture(command_buffer);
@@ -180,7 +413,41 @@ private:
 		camera.SetPerspective(90.0f, static_cast<float>(swap_chain.extent.width) / static_cast<float>(swap_chain.extent.height), 0.1f, 256.0f);
 		camera.SetMovementSpeed(0.02f);
 
+		if(!options.golden_directory.empty())
+		{
+			std::filesystem::create_directories(options.golden_directory);
+			CreateGoldenCases();
+			MoveGoldenCamera();
+		}
+
+		// Skip the first frames of a benchmark, pipelines and caches are still warming up
+		constexpr uint32_t benchmark_warmup_frames = 60;
+		// Camera paths advance a fixed step per frame, so every run renders the same views whatever the frame rate
+		constexpr float camera_path_timestep = 1.0f / 60.0f;
+		uint32_t frame_count = 0;
+
+		// Golden runs play it as their own path
+		vkpg::CameraPath camera_path;
+		if(!options.camera_path.empty() && options.golden_directory.empty())
+		{
+			camera_path = vkpg::CameraPath::Load(options.camera_path);
+			if(camera_path.IsEmpty())
+			{
+				throw std::runtime_error("Camera path " + options.camera_path + " has no keyframes");
+			}
+		}
+
+		auto benchmark_frames = options.benchmark_frames;
+		if(benchmark_frames == 0 && !camera_path.IsEmpty())
+		{
+			benchmark_frames = static_cast<uint32_t>(camera_path.GetDuration() / camera_path_timestep) + 1;
+		}
+
+		vkpg::CameraPath recorded_path;
+		uint32_t recorded_frames = 0;
+
 		auto time_last = std::chrono::high_resolution_clock::now();
+		auto frame_start = time_last;
 		while(!window.ShouldClose())
 		{
 			window.PollEvents();
@@ -238,16 +505,352 @@ private:
 
 			ImGui::End();
 
+			ImGui::SetNextWindowSize(ImVec2(300, 120), ImGuiCond_FirstUseEver);
+			ImGui::Begin("GPU");
+
+			for(const auto& pass_time : swap_chain.profiler.pass_times)
+			{
+				ImGui::Text("%s: %.3f ms", pass_time.name.c_str(), pass_time.milliseconds);
+			}
+			ImGui::Text("Frame: %.3f ms", swap_chain.profiler.frame_time);
+			if(swap_chain.depth_pyramid_enabled)
+			{
+				ImGui::Text("Hi-Z built at %ux%u", profiled_render_extent.width, profiled_render_extent.height);
+			}
+			if(swap_chain.ui_subpass_enabled)
+			{
+				ImGui::Text("UI: subpass of the scene pass");
+			}
+			else
+			{
+				// The separate UI pass stores the swap chain image after the scene and loads it again
+				auto image_size = static_cast<double>(swap_chain.extent.width) * swap_chain.extent.height * 4;
+				ImGui::Text("UI: separate pass, %.1f MiB extra load and store", image_size * 2.0 / (1024.0 * 1024.0));
+			}
+			if(ImGui::Button("Report attachment memory"))
+			{
+				swap_chain.ReportAttachmentMemory();
+			}
+
+			if(swap_chain.capture.IsSupported())
+			{
+				ImGui::Spacing();
+				if(ImGui::Button("Screenshot"))
+				{
+					swap_chain.capture.RequestScreenshot("screenshot_" + std::to_string(screenshot_count++) + ".png");
+				}
+				ImGui::SameLine();
+				auto recording = swap_chain.capture.IsRecordingSequence();
+				if(ImGui::Checkbox("Record sequence", &recording))
+				{
+					if(recording)
+					{
+						swap_chain.capture.StartSequence("capture");
+					}
+					else
+					{
+						swap_chain.capture.StopSequence();
+					}
+				}
+				ImGui::Text("Captured: %u written, %u skipped", swap_chain.capture.written_frames.load(), swap_chain.capture.skipped_frames);
+			}
+
+			if(swap_chain.dynamic_resolution_enabled)
+			{
+				auto render_extent = swap_chain.GetRenderExtent();
+				ImGui::Spacing();
+				ImGui::SliderFloat("Scene budget (ms)", &dynamic_resolution.target_frame_time, 1.0f, 33.0f);
+				ImGui::SliderFloat("Min scale", &dynamic_resolution.min_scale, 0.25f, 1.0f);
+				ImGui::Text("Render scale: %.2f (%ux%u)", swap_chain.render_scale, render_extent.width, render_extent.height);
+			}
+
+			{
+				auto tier = GetAntiAliasingTier();
+				anti_aliasing_costs[tier] = swap_chain.profiler.GetPassTime("scene") + swap_chain.profiler.GetPassTime("fxaa");
+
+				ImGui::Spacing();
+				ImGui::Text("Anti-aliasing: %s", tier.c_str());
+
+				auto anti_aliasing = swap_chain.anti_aliasing;
+				bool anti_aliasing_changed = false;
+
+				auto max_samples = vulkan_device.GetMaxUsableSampleCount();
+				for(auto samples : {VK_SAMPLE_COUNT_1_BIT, VK_SAMPLE_COUNT_2_BIT, VK_SAMPLE_COUNT_4_BIT, VK_SAMPLE_COUNT_8_BIT})
+				{
+					if(samples > max_samples)
+					{
+						break;
+					}
+
+					auto label = samples == VK_SAMPLE_COUNT_1_BIT ? std::string("No MSAA") : std::to_string(samples) + "x";
+					if(samples != VK_SAMPLE_COUNT_1_BIT)
+					{
+						ImGui::SameLine();
+					}
+					if(ImGui::RadioButton(label.c_str(), swap_chain.msaa_samples == samples))
+					{
+						anti_aliasing.samples = samples;
+						anti_aliasing_changed = true;
+					}
+				}
+				anti_aliasing_changed |= ImGui::Checkbox("Sample shading", &anti_aliasing.sample_shading);
+				ImGui::SameLine();
+				anti_aliasing_changed |= ImGui::Checkbox("FXAA", &anti_aliasing.fxaa);
+
+				if(anti_aliasing_changed)
+				{
+					// Waits for the device, nothing of this frame has been recorded yet
+					swap_chain.SetAntiAliasing(anti_aliasing);
+				}
+
+				// Scene pass including the resolve plus FXAA, the first frames after a switch still show the old tier
+				for(const auto& [name, milliseconds] : anti_aliasing_costs)
+				{
+					ImGui::Text("  %s: %.3f ms", name.c_str(), milliseconds);
+				}
+			}
+
+			if(!swap_chain.lods.empty())
+			{
+				const auto& lod = swap_chain.lods[swap_chain.lod_index];
+				ImGui::Spacing();
+				ImGui::SliderFloat("LOD pixel error", &lod_pixel_error, 0.25f, 16.0f);
+				ImGui::Text("LOD %u: %u triangles", swap_chain.lod_index, lod.index_count / 3);
+			}
+
+			ImGui::Spacing();
+			ImGui::Text("Scene update: %.3f ms, %u / %zu nodes", scene_update_time, scene_updated_nodes, scene.GetNodeCount());
+			ImGui::Text("BVH: %zu nodes, %zu scene nodes in view", scene_bvh.GetNodeCount(), visible_nodes.size());
+			if(picked_node)
+			{
+				ImGui::Text("Picked node: %u", *picked_node);
+				if(*picked_node == model_node)
+				{
+					model_position = InputFloat3(model_position, "Picked position");
+				}
+				else
+				{
+					scene.SetPosition(*picked_node, InputFloat3(scene.GetPosition(*picked_node), "Picked position"));
+				}
+			}
+			if(!animated_nodes.empty())
+			{
+				ImGui::Checkbox("Animate scene", &animate_scene);
+				ImGui::SliderInt("Scene update threads", &scene_threads, 1, static_cast<int>(std::max(1u, std::thread::hardware_concurrency())));
+			}
+
+			if(swap_chain.materials.size() > 1)
+			{
+				ImGui::Text("Material:");
+				for(size_t i = 0; i < swap_chain.materials.size(); i++)
+				{
+					// Drawn with the first material until the pipeline has compiled
+					const auto& material = swap_chain.materials[i];
+					auto label = material.pipeline == VK_NULL_HANDLE ? material.name + " (compiling)" : material.name;
+					ImGui::SameLine();
+					if(ImGui::RadioButton(label.c_str(), swap_chain.active_material == i))
+					{
+						swap_chain.active_material = i;
+					}
+				}
+			}
+
+			if(swap_chain.meshlets_enabled)
+			{
+				const auto& range = swap_chain.meshlet_mesh.lods[std::min<size_t>(swap_chain.lod_index, swap_chain.meshlet_mesh.lods.size() - 1)];
+				ImGui::Spacing();
+				ImGui::Checkbox("Meshlet frustum culling", &swap_chain.meshlet_frustum_culling);
+				ImGui::Checkbox("Meshlet cone culling", &swap_chain.meshlet_cone_culling);
+				ImGui::Text("Meshlets (%s): %u / %u, %u triangles", swap_chain.mesh_shader_enabled ? "mesh shaders" : "compute",
+				            swap_chain.visible_meshlets, range.meshlet_count, swap_chain.visible_triangles);
+			}
+
+			ImGui::End();
+
 			ImGui::Render();
 
 			auto time_now = std::chrono::high_resolution_clock::now();
 			auto delta_time = std::chrono::duration_cast<std::chrono::milliseconds>(time_last - time_now);
 			camera.Update(delta_time);
 
+			if(!camera_path.IsEmpty())
+			{
+				// Holds the first keyframe during the warmup
+				auto path_frame = frame_count > benchmark_warmup_frames ? frame_count - benchmark_warmup_frames : 0;
+				auto keyframe = camera_path.Sample(static_cast<float>(path_frame) * camera_path_timestep);
+				camera.SetPosition(keyframe.position);
+				camera.SetRotation(keyframe.rotation);
+			}
+
+			if(!options.record_camera_path.empty())
+			{
+				recorded_path.AddKeyframe({static_cast<float>(recorded_frames++) * camera_path_timestep, camera.position, camera.rotation});
+			}
+
 			DrawFrame();
+
+			auto frame_end = std::chrono::high_resolution_clock::now();
+			auto cpu_frame_time = std::chrono::duration<double, std::milli>(frame_end - frame_start).count();
+			frame_start = frame_end;
+
+			if(!options.golden_directory.empty() && !UpdateGoldenTests())
+			{
+				break;
+			}
+
+			if(benchmark_frames > 0)
+			{
+				if(++frame_count > benchmark_warmup_frames)
+				{
+					// GPU times are from the last finished frame, a couple of frames behind the CPU ones
+					frame_stats.AddSample("cpu/frame", cpu_frame_time);
+					for(const auto& [stage, milliseconds] : cpu_stage_times)
+					{
+						frame_stats.AddSample("cpu/" + stage, milliseconds);
+					}
+					frame_stats.AddSample("gpu/frame", swap_chain.profiler.frame_time);
+					for(const auto& pass_time : swap_chain.profiler.pass_times)
+					{
+						frame_stats.AddSample("gpu/" + pass_time.name, pass_time.milliseconds);
+					}
+					if(swap_chain.depth_pyramid_enabled && swap_chain.profiler.GetPassTime("hi-z") > 0.0)
+					{
+						// Per resolution in 10% steps of the swap chain width, dynamic resolution moves in much finer ones
+						auto percent = std::lround(10.0 * profiled_render_extent.width / swap_chain.extent.width) * 10;
+						frame_stats.AddSample("gpu/hi-z " + std::to_string(percent) + "%", swap_chain.profiler.GetPassTime("hi-z"));
+					}
+				}
+
+				if(frame_count >= benchmark_warmup_frames + benchmark_frames)
+				{
+					ReportBenchmark(benchmark_frames);
+					break;
+				}
+			}
 		}
 
 		vkDeviceWaitIdle(vulkan_device.logical_device);
+
+		if(!options.record_camera_path.empty())
+		{
+			recorded_path.Save(options.record_camera_path);
+			std::cout << "Camera path: " << recorded_path.GetKeyframeCount() << " keyframes written to " << options.record_camera_path << std::endl;
+		}
+	}
+
+	// The tier the swap chain actually renders with, e.g. "4x MSAA + sample shading + FXAA"
+	std::string GetAntiAliasingTier() const
+	{
+		std::string tier = swap_chain.msaa_samples == VK_SAMPLE_COUNT_1_BIT ? "no MSAA" : std::to_string(swap_chain.msaa_samples) + "x MSAA";
+		if(swap_chain.msaa_samples != VK_SAMPLE_COUNT_1_BIT && swap_chain.anti_aliasing.sample_shading)
+		{
+			tier += " + sample shading";
+		}
+		if(swap_chain.fxaa_enabled)
+		{
+			tier += " + FXAA";
+		}
+		return tier;
+	}
+
+	// Records the same cheap commands through the loader's trampolines and through vulkan_device.dispatch, the
+	// difference is what the loader costs per call. Nothing is submitted.
+	void RunDispatchBenchmark()
+	{
+		constexpr uint32_t call_count = 100000;
+		constexpr uint32_t round_count = 10;
+
+		VkCommandBufferAllocateInfo alloc_info{};
+		alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		alloc_info.commandPool = swap_chain.command_pool;
+		alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		alloc_info.commandBufferCount = 1;
+
+		VkCommandBufferBeginInfo begin_info{};
+		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		VkViewport viewport{0.0f, 0.0f, 1.0f, 1.0f, 0.0f, 1.0f};
+		VkRect2D scissor{{0, 0}, {1, 1}};
+
+		// Fastest round in ns per command, every round records into a new command buffer so the driver grows it alike
+		auto Measure = [&](PFN_vkCmdSetViewport set_viewport, PFN_vkCmdSetScissor set_scissor)
+		{
+			double best = std::numeric_limits<double>::max();
+			for(uint32_t round = 0; round < round_count; round++)
+			{
+				VkCommandBuffer command_buffer;
+				auto result = vkAllocateCommandBuffers(vulkan_device.logical_device, &alloc_info, &command_buffer);
+				CheckVkResult(result, "Failed to allocate command buffer");
+
+				result = vulkan_device.dispatch.begin_command_buffer(command_buffer, &begin_info);
+				CheckVkResult(result, "Failed to begin recording command buffer");
+
+				auto start = std::chrono::high_resolution_clock::now();
+				for(uint32_t i = 0; i < call_count; i++)
+				{
+					set_viewport(command_buffer, 0, 1, &viewport);
+					set_scissor(command_buffer, 0, 1, &scissor);
+				}
+				auto end = std::chrono::high_resolution_clock::now();
+
+				vulkan_device.dispatch.end_command_buffer(command_buffer);
+				vkFreeCommandBuffers(vulkan_device.logical_device, swap_chain.command_pool, 1, &command_buffer);
+
+				best = std::min(best, std::chrono::duration<double, std::nano>(end - start).count() / (2.0 * call_count));
+			}
+			return best;
+		};
+
+		auto loader = Measure(vkCmdSetViewport, vkCmdSetScissor);
+		auto direct = Measure(vulkan_device.dispatch.cmd_set_viewport, vulkan_device.dispatch.cmd_set_scissor);
+
+		std::cout << "Dispatch " << 2 * call_count << " commands: loader " << loader << " ns/call"
+		          << ", dispatch table " << direct << " ns/call"
+		          << ", " << loader - direct << " ns saved per call" << std::endl;
+	}
+
+	void ReportBenchmark(uint32_t benchmark_frames)
+	{
+		std::cout << "Benchmark: " << benchmark_frames << " frames" << std::endl;
+		for(const auto& summary : frame_stats.Summarize())
+		{
+			std::cout << "  " << summary.name << ": mean " << summary.mean << " ms, p50 " << summary.p50
+			          << ", p95 " << summary.p95 << ", p99 " << summary.p99 << ", max " << summary.max << std::endl;
+		}
+
+		if(options.benchmark_json.empty())
+		{
+			return;
+		}
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(vulkan_device.physical_device, &properties);
+
+		auto Flag = [](bool enabled)
+		{
+			return std::string(enabled ? "true" : "false");
+		};
+
+		frame_stats.WriteJson(options.benchmark_json,
+		{
+			{"device", properties.deviceName},
+			{"extent", std::to_string(swap_chain.extent.width) + "x" + std::to_string(swap_chain.extent.height)},
+			{"frames", std::to_string(benchmark_frames)},
+			{"camera_path", options.camera_path},
+			{"dynamic_resolution", Flag(swap_chain.dynamic_resolution_enabled)},
+			{"compact_vertices", Flag(options.compact_vertices)},
+			{"optimize_mesh", Flag(options.optimize_mesh)},
+			{"generate_lods", Flag(options.generate_lods)},
+			{"meshlets", Flag(swap_chain.meshlets_enabled)},
+			{"ui_subpass", Flag(swap_chain.ui_subpass_enabled)},
+			{"dynamic_rendering", Flag(swap_chain.dynamic_rendering_enabled)},
+			{"async_compute", Flag(swap_chain.async_compute_enabled)},
+			{"depth_pyramid", Flag(swap_chain.depth_pyramid_enabled)},
+			{"anti_aliasing", GetAntiAliasingTier()},
+			{"scene_nodes", std::to_string(options.scene_nodes)},
+		});
+		std::cout << "Benchmark results written to " << options.benchmark_json << std::endl;
 	}
 
 	void Cleanup()
@@ -258,6 +861,7 @@ private:
 		ImGui::DestroyContext();
 
 		swap_chain.Cleanup();
+		swap_chain.DestroyPipelineCache();
 
 		for(size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
@@ -284,7 +888,16 @@ private:
 		app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		app_info.pEngineName = "No Engine";
 		app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		app_info.apiVersion = VK_API_VERSION_1_0;
+
+		// vkEnumerateInstanceVersion only exists on 1.1+ loaders
+		uint32_t instance_version = VK_API_VERSION_1_0;
+		auto enumerate_instance_version = reinterpret_cast<PFN_vkEnumerateInstanceVersion>(vkGetInstanceProcAddr(nullptr, "vkEnumerateInstanceVersion"));
+		if(enumerate_instance_version != nullptr)
+		{
+			enumerate_instance_version(&instance_version);
+		}
+		app_info.apiVersion = std::min(instance_version, static_cast<uint32_t>(VK_API_VERSION_1_3));
+		vulkan_device.api_version = app_info.apiVersion;
 
 		VkInstanceCreateInfo create_info{};
 		create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -399,11 +1012,324 @@ private:
 				{
 					unique_vertices[vertex] = static_cast<uint32_t>(swap_chain.vertices.size());
 					swap_chain.vertices.push_back(vertex);
+
+					// Deduplicated on the uploaded attributes, the first normal of a vertex wins
+					glm::vec3 normal{0.0f};
+					if(index.normal_index >= 0)
+					{
+						normal =
+						{
+							attrib.normals[3 * index.normal_index + 0],
+							attrib.normals[3 * index.normal_index + 1],
+							attrib.normals[3 * index.normal_index + 2]
+						};
+					}
+					swap_chain.normals.push_back(normal);
 				}
 
 				swap_chain.indices.push_back(unique_vertices[vertex]);
 			}
 		}
+
+		if(options.optimize_mesh)
+		{
+			auto& vertices = swap_chain.vertices;
+			auto& indices = swap_chain.indices;
+
+			auto before = vkpg::AnalyzeVertexCache(indices, vertices.size());
+
+			vkpg::OptimizeVertexCache(indices, vertices.size());
+			vkpg::OptimizeOverdraw(indices, vertices);
+			vkpg::OptimizeVertexFetch(vertices, swap_chain.normals, indices);
+
+			auto after = vkpg::AnalyzeVertexCache(indices, vertices.size());
+
+			std::cout << "Mesh optimization: ACMR " << before.acmr << " -> " << after.acmr
+			          << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		}
+
+		if(options.generate_lods)
+		{
+			auto& indices = swap_chain.indices;
+			swap_chain.lods = vkpg::GenerateLods(swap_chain.vertices, indices);
+
+			for(size_t i = 0; i < swap_chain.lods.size(); i++)
+			{
+				const auto& lod = swap_chain.lods[i];
+
+				// LOD 0 was already optimized above, the simplified levels come out in collapse order
+				if(i > 0 && options.optimize_mesh)
+				{
+					std::vector<uint32_t> lod_indices(indices.begin() + lod.first_index, indices.begin() + lod.first_index + lod.index_count);
+					vkpg::OptimizeVertexCache(lod_indices, swap_chain.vertices.size());
+					std::copy(lod_indices.begin(), lod_indices.end(), indices.begin() + lod.first_index);
+				}
+
+				std::cout << "LOD " << i << ": " << lod.index_count / 3 << " triangles, error " << lod.error << std::endl;
+			}
+		}
+
+		if(options.meshlets)
+		{
+			// Built after optimization so the meshlets follow the vertex cache order
+			auto& meshlet_mesh = swap_chain.meshlet_mesh;
+			meshlet_mesh = vkpg::BuildMeshlets(swap_chain.vertices, swap_chain.indices, swap_chain.lods);
+
+			if(!meshlet_mesh.meshlets.empty())
+			{
+				std::cout << "Meshlets: " << meshlet_mesh.meshlets.size() << ", average "
+				          << static_cast<float>(meshlet_mesh.vertices.size()) / meshlet_mesh.meshlets.size() << " vertices, "
+				          << static_cast<float>(meshlet_mesh.triangles.size()) / meshlet_mesh.meshlets.size() << " triangles" << std::endl;
+			}
+		}
+
+		mesh_center = glm::vec3(0.0f);
+		if(!swap_chain.vertices.empty())
+		{
+			auto bounds_min = swap_chain.vertices.front().position;
+			auto bounds_max = bounds_min;
+			for(const auto& vertex : swap_chain.vertices)
+			{
+				bounds_min = glm::min(bounds_min, vertex.position);
+				bounds_max = glm::max(bounds_max, vertex.position);
+			}
+
+			mesh_center = (bounds_min + bounds_max) * 0.5f;
+			mesh_radius = glm::length(bounds_max - bounds_min) * 0.5f;
+			mesh_bounds = {bounds_min, bounds_max};
+		}
+	}
+
+	void CreateScene()
+	{
+		model_node = scene.AddNode(vkpg::NO_PARENT_NODE, model_position);
+
+		// Breadth first tree with four children per node, so parents always come before their children
+		std::vector<uint32_t> nodes{model_node};
+		for(uint32_t i = 0; i < options.scene_nodes; i++)
+		{
+			auto parent = nodes[i / 4];
+			auto angle = glm::radians(90.0f) * static_cast<float>(i % 4);
+			auto offset = glm::vec3(std::cos(angle), 0.0f, std::sin(angle));
+			nodes.push_back(scene.AddNode(parent, offset, glm::angleAxis(angle, glm::vec3(0.0f, 1.0f, 0.0f)), glm::vec3(0.5f)));
+
+			if(parent == model_node)
+			{
+				animated_nodes.push_back(nodes.back());
+			}
+		}
+
+		scene.Update();
+
+		UpdateNodeBounds();
+		auto build_start = std::chrono::high_resolution_clock::now();
+		scene_bvh.Build(node_bounds);
+		auto build_end = std::chrono::high_resolution_clock::now();
+
+		if(options.scene_nodes > 0)
+		{
+			std::cout << "Scene: " << scene.GetNodeCount() << " nodes, BVH built in "
+			          << std::chrono::duration<double, std::milli>(build_end - build_start).count() << " ms" << std::endl;
+		}
+	}
+
+	void UpdateNodeBounds()
+	{
+		node_bounds.resize(scene.GetNodeCount());
+		for(uint32_t node = 0; node < node_bounds.size(); node++)
+		{
+			node_bounds[node] = mesh_bounds.Transform(scene.GetWorldMatrix(node));
+		}
+	}
+
+	void CreateGoldenCases()
+	{
+		for(const auto& view : GOLDEN_VIEWS)
+		{
+			golden_cases.push_back({view.name, view.camera_position, view.camera_rotation});
+		}
+
+		if(!options.camera_path.empty())
+		{
+			golden_path = vkpg::CameraPath::Load(options.camera_path);
+		}
+		else
+		{
+			for(const auto& keyframe : GOLDEN_PATH)
+			{
+				golden_path.AddKeyframe(keyframe);
+			}
+		}
+
+		// Every keyframe and halfway to it from the one before, in path time since the first keyframe
+		std::vector<float> stops;
+		for(size_t i = 0; i < golden_path.GetKeyframeCount(); i++)
+		{
+			auto time = golden_path.GetKeyframe(i).time - golden_path.GetKeyframe(0).time;
+			if(i > 0)
+			{
+				stops.push_back((stops.back() + time) * 0.5f);
+			}
+			stops.push_back(time);
+		}
+
+		for(size_t i = 0; i < stops.size(); i++)
+		{
+			GoldenCase path_case;
+			path_case.name = "path_" + std::string(i < 10 ? "0" : "") + std::to_string(i);
+			path_case.on_path = true;
+			path_case.path_start = i > 0 ? stops[i - 1] : 0.0f;
+			path_case.path_end = stops[i];
+			golden_cases.push_back(path_case);
+		}
+	}
+
+	// Places the camera for the current golden case and frame, path stops are reached at the end of the warmup
+	void MoveGoldenCamera()
+	{
+		const auto& test = golden_cases[golden_case];
+		if(!test.on_path)
+		{
+			camera.SetPosition(test.camera_position);
+			camera.SetRotation(test.camera_rotation);
+			return;
+		}
+
+		auto progress = static_cast<float>(std::min(golden_frame, golden_warmup_frames)) / golden_warmup_frames;
+		auto keyframe = golden_path.Sample(test.path_start + (test.path_end - test.path_start) * progress);
+		camera.SetPosition(keyframe.position);
+		camera.SetRotation(keyframe.rotation);
+	}
+
+	// Steps through golden_cases, one call per drawn frame. Returns false once every case has been checked.
+	bool UpdateGoldenTests()
+	{
+		const auto& test = golden_cases[golden_case];
+		auto golden_path_name = options.golden_directory + "/" + test.name + ".png";
+		auto actual_path = options.update_golden ? golden_path_name : options.golden_directory + "/" + test.name + ".actual.png";
+
+		golden_frame++;
+		if(golden_frame <= golden_warmup_frames)
+		{
+			MoveGoldenCamera();
+			return true;
+		}
+
+		if(golden_frame <= golden_warmup_frames + golden_measured_frames)
+		{
+			golden_frame_time_sum += swap_chain.profiler.frame_time;
+			if(golden_frame == golden_warmup_frames + golden_measured_frames)
+			{
+				golden_screenshot = swap_chain.capture.RequestScreenshot(actual_path);
+			}
+			return true;
+		}
+
+		// The capture is written a few frames later on the capture thread
+		auto written = swap_chain.capture.GetScreenshotResult(golden_screenshot);
+		if(!written.has_value() && golden_frame <= golden_warmup_frames + golden_measured_frames + 120)
+		{
+			return true;
+		}
+		if(!written.value_or(false))
+		{
+			std::cout << "Golden " << test.name << ": the frame could not be captured" << std::endl;
+			golden_failed = true;
+			return false;
+		}
+
+		auto frame_time = golden_frame_time_sum / golden_measured_frames;
+		if(options.update_golden)
+		{
+			std::cout << "Golden " << test.name << ": written to " << golden_path_name << ", frame " << frame_time << " ms" << std::endl;
+		}
+		else if(!std::filesystem::exists(golden_path_name))
+		{
+			std::cout << "Golden " << test.name << ": no golden image, write it with --update-golden, skipped" << std::endl;
+			golden_skipped++;
+		}
+		else
+		{
+			try
+			{
+				auto difference = vkpg::CompareImages(actual_path, golden_path_name);
+				auto passed = difference.psnr >= options.golden_min_psnr;
+				golden_failed |= !passed;
+
+				std::cout << "Golden " << test.name << ": PSNR " << difference.psnr << " dB, max difference "
+				          << difference.max_difference << ", frame " << frame_time << " ms, "
+				          << (passed ? "passed" : "FAILED") << std::endl;
+			}
+			catch(const std::exception& e)
+			{
+				std::cout << "Golden " << test.name << ": " << e.what() << ", FAILED" << std::endl;
+				golden_failed = true;
+			}
+		}
+
+		golden_frame = 0;
+		golden_frame_time_sum = 0.0;
+		if(++golden_case == golden_cases.size())
+		{
+			return false;
+		}
+
+		MoveGoldenCamera();
+		return true;
+	}
+
+	void Pick(glm::vec2 position)
+	{
+		// Unprojects the cursor onto the near and far planes, Vulkan clip space has y down and depth 0..1
+		auto inverse_view_projection = glm::inverse(camera.matrices.perspective * camera.matrices.view);
+		auto ndc = position * 2.0f - 1.0f;
+		auto near_point = inverse_view_projection * glm::vec4(ndc, 0.0f, 1.0f);
+		auto far_point = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+
+		vkpg::Ray ray;
+		ray.origin = glm::vec3(near_point) / near_point.w;
+		ray.direction = glm::normalize(glm::vec3(far_point) / far_point.w - ray.origin);
+
+		auto hit = scene_bvh.Raycast(ray);
+		picked_node = hit ? std::optional<uint32_t>(hit->primitive) : std::nullopt;
+
+		if(hit)
+		{
+			std::cout << "Picked scene node " << hit->primitive << " at distance " << hit->distance << std::endl;
+		}
+	}
+
+	void UpdateScene()
+	{
+		if(scene.GetPosition(model_node) != model_position)
+		{
+			scene.SetPosition(model_node, model_position);
+		}
+
+		if(animate_scene)
+		{
+			auto spin = glm::angleAxis(glm::radians(1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+			for(auto node : animated_nodes)
+			{
+				scene.SetRotation(node, spin * scene.GetRotation(node));
+			}
+		}
+
+		auto update_start = std::chrono::high_resolution_clock::now();
+		scene_updated_nodes = scene.Update(static_cast<uint32_t>(scene_threads));
+		auto update_end = std::chrono::high_resolution_clock::now();
+
+		scene_update_time = std::chrono::duration<double, std::milli>(update_end - update_start).count();
+
+		// Moving nodes keep the tree and only grow or shrink its bounds
+		if(scene_updated_nodes > 0)
+		{
+			UpdateNodeBounds();
+			scene_bvh.Refit(node_bounds);
+		}
+
+		visible_nodes.clear();
+		scene_bvh.QueryFrustum(camera.GetFrustumPlanes(), visible_nodes);
 	}
 
 	void CreateSyncObjects()
@@ -442,22 +1368,32 @@ private:
 		vkpg::UniformBufferObject ubo{};
 		ubo.model = glm::mat4(1.0f);
 		//ubo.model = glm::rotate(ubo.model, time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-		ubo.model = glm::translate(ubo.model, model_position);
+		ubo.model = scene.GetWorldMatrix(model_node) * swap_chain.position_dequantization;
 		ubo.view = camera.matrices.view;
 		ubo.projection = camera.matrices.perspective;
+		ubo.object_id = model_node + 1;
 
 		void *data;
-		vkMapMemory(vulkan_device.logical_device, swap_chain.uniform_buffers_memory[current_image], 0, sizeof(ubo), 0, &data);
+		vulkan_device.dispatch.map_memory(vulkan_device.logical_device, swap_chain.uniform_buffers_memory[current_image], 0, sizeof(ubo), 0, &data);
 		memcpy(data, &ubo, sizeof(ubo));
-		vkUnmapMemory(vulkan_device.logical_device, swap_chain.uniform_buffers_memory[current_image]);
+		vulkan_device.dispatch.unmap_memory(vulkan_device.logical_device, swap_chain.uniform_buffers_memory[current_image]);
 	}
 
 	void DrawFrame()
 	{
-		vkWaitForFences(vulkan_device.logical_device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
+		cpu_stage_times.clear();
+		auto stage_start = std::chrono::high_resolution_clock::now();
+		auto EndStage = [this, &stage_start](const char *stage)
+		{
+			auto now = std::chrono::high_resolution_clock::now();
+			cpu_stage_times.emplace_back(stage, std::chrono::duration<double, std::milli>(now - stage_start).count());
+			stage_start = now;
+		};
+
+		vulkan_device.dispatch.wait_for_fences(vulkan_device.logical_device, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX);
 
 		uint32_t image_index;
-		auto result = vkAcquireNextImageKHR(vulkan_device.logical_device, swap_chain.swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
+		auto result = vulkan_device.dispatch.acquire_next_image(vulkan_device.logical_device, swap_chain.swap_chain, UINT64_MAX, image_available_semaphores[current_frame], VK_NULL_HANDLE, &image_index);
 
 		if(result == VK_ERROR_OUT_OF_DATE_KHR)
 		{
@@ -469,57 +1405,112 @@ private:
 			throw std::runtime_error("Failed to acquire swap chain image (VkResult: " + std::to_string(result) + ")");
 		}
 
+		// Check if a previous frame is using this image (i.e. there is its fence to wait on)
+		if(images_in_flight[image_index] != VK_NULL_HANDLE)
+		{
+			vulkan_device.dispatch.wait_for_fences(vulkan_device.logical_device, 1, &images_in_flight[image_index], VK_TRUE, UINT64_MAX);
+		}
+		// Mark the image as now being in use by this frame
+		images_in_flight[image_index] = in_flight_fences[current_frame];
+
+		swap_chain.ResetFrameDescriptors(image_index);
+		swap_chain.profiler.CollectResults(image_index);
+		profiled_render_extent = swap_chain.recorded_render_extents[image_index];
+		swap_chain.capture.CollectResults(image_index);
+		EndStage("wait");
+
+		if(swap_chain.dynamic_resolution_enabled)
+		{
+			swap_chain.render_scale = dynamic_resolution.Update(swap_chain.profiler.GetPassTime("scene"));
+		}
+
+		UpdateScene();
+		const auto& model = scene.GetWorldMatrix(model_node);
+
+		// Golden runs always draw the full detail LOD, the selection depends on the extent and the pixel error setting
+		if(!swap_chain.lods.empty() && options.golden_directory.empty())
+		{
+			// Distance to the bounding sphere, inside of it the full detail LOD is used
+			auto distance = glm::length(camera.GetEyePosition() - glm::vec3(model * glm::vec4(mesh_center, 1.0f))) - mesh_radius;
+			swap_chain.lod_index = vkpg::SelectLod(swap_chain.lods, distance, glm::radians(camera.GetFov()),
+			                                       static_cast<float>(swap_chain.GetRenderExtent().height), lod_pixel_error);
+		}
+
+		if(swap_chain.meshlets_enabled)
+		{
+			// Meshlet bounds are in model space, so the planes and the camera are moved there instead
+			auto planes = camera.GetFrustumPlanes();
+			for(size_t i = 0; i < planes.size(); i++)
+			{
+				auto plane = glm::transpose(model) * planes[i];
+				swap_chain.meshlet_frustum_planes[i] = plane / glm::length(glm::vec3(plane));
+			}
+			swap_chain.meshlet_camera_position = glm::vec3(glm::inverse(model) * glm::vec4(camera.GetEyePosition(), 1.0f));
+		}
+
+		EndStage("update");
+
+		// The image's uniform buffer and command buffers are no longer in use by the GPU
 		UpdateUniformBuffer(image_index);
+		swap_chain.RecordCommandBuffer(image_index);
+
+		// Finished with an earlier frame of this image, a few frames after the click
+		if(auto object_id = swap_chain.TakeObjectId())
+		{
+			picked_node = *object_id ? std::optional<uint32_t>(*object_id - 1) : std::nullopt;
+			if(picked_node)
+			{
+				std::cout << "Picked scene node " << *picked_node << " from the object ID buffer" << std::endl;
+			}
+		}
 
 		//recordUICommands(image_index);
+		if(!swap_chain.ui_subpass_enabled)
 		{
 			VkCommandBufferBeginInfo cmdBufferBegin = {};
 		    cmdBufferBegin.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		    cmdBufferBegin.flags |= VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-		    if (vkBeginCommandBuffer(swap_chain.ui_command_buffers[image_index], &cmdBufferBegin) != VK_SUCCESS)
+		    if (vulkan_device.dispatch.begin_command_buffer(swap_chain.ui_command_buffers[image_index], &cmdBufferBegin) != VK_SUCCESS)
 			{
 		        throw std::runtime_error("Unable to start recording UI command buffer!");
 		    }
 
-			VkClearValue clearColor{0.0f, 0.0f, 0.0f, 1.0f};
-		    VkRenderPassBeginInfo renderPassBeginInfo = {};
-		    renderPassBeginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		    renderPassBeginInfo.renderPass = swap_chain.ui_render_pass;
-		    renderPassBeginInfo.framebuffer = swap_chain.ui_framebuffers[image_index];
-		    renderPassBeginInfo.renderArea.extent.width = swap_chain.extent.width;
-		    renderPassBeginInfo.renderArea.extent.height = swap_chain.extent.height;
-		    renderPassBeginInfo.clearValueCount = 1;
-		    renderPassBeginInfo.pClearValues = &clearColor;
-
-		    vkCmdBeginRenderPass(swap_chain.ui_command_buffers[image_index], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		    swap_chain.profiler.BeginPass(swap_chain.ui_command_buffers[image_index], "ui");
+		    swap_chain.BeginUiPass(swap_chain.ui_command_buffers[image_index], image_index);
 
 		    // Grab and record the draw data for Dear Imgui
 		    ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), swap_chain.ui_command_buffers[image_index]);
 
-		    // End and submit render pass
-		    vkCmdEndRenderPass(swap_chain.ui_command_buffers[image_index]);
+		    swap_chain.EndUiPass(swap_chain.ui_command_buffers[image_index], image_index);
+		    swap_chain.profiler.EndPass(swap_chain.ui_command_buffers[image_index]);
 
-
-		    if(vkEndCommandBuffer(swap_chain.ui_command_buffers[image_index]) != VK_SUCCESS)
+		    if(vulkan_device.dispatch.end_command_buffer(swap_chain.ui_command_buffers[image_index]) != VK_SUCCESS)
 			{
 		        throw std::runtime_error("Failed to record command buffers!");
 		    }
 		}
 
-		// Check if a previous frame is using this image (i.e. there is its fence to wait on)
-		if(images_in_flight[image_index] != VK_NULL_HANDLE)
-		{
-			vkWaitForFences(vulkan_device.logical_device, 1, &images_in_flight[image_index], VK_TRUE, UINT64_MAX);
-		}
-		// Mark the image as now being in use by this frame
-		images_in_flight[image_index] = in_flight_fences[current_frame];
+		EndStage("record");
 
 		VkSubmitInfo submit_info{};
 		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-		VkSemaphore wait_semaphores[] = {image_available_semaphores[current_frame]};
-		VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
+		std::array<VkSemaphore, 2> wait_semaphores{{image_available_semaphores[current_frame]}};
+		// With an offscreen scene the blit is the first to touch the swap chain image
+		std::array<VkPipelineStageFlags, 2> wait_stages
+		{{
+			swap_chain.IsSceneOffscreen() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+		}};
+		uint32_t wait_count = 1;
+
+		// Meshlet culling submitted to the compute queue while recording, the draw reads its results
+		if(auto compute_semaphore = swap_chain.async_compute.TakeSemaphore(image_index))
+		{
+			wait_semaphores[wait_count] = compute_semaphore;
+			wait_stages[wait_count] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+			wait_count++;
+		}
 
 		std::array<VkCommandBuffer, 2> command_buffers
 		{{
@@ -527,19 +1518,20 @@ private:
 			swap_chain.ui_command_buffers[image_index]
 		}};
 
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = wait_semaphores;
-		submit_info.pWaitDstStageMask = wait_stages;
-		submit_info.commandBufferCount = command_buffers.size();
+		submit_info.waitSemaphoreCount = wait_count;
+		submit_info.pWaitSemaphores = wait_semaphores.data();
+		submit_info.pWaitDstStageMask = wait_stages.data();
+		// The UI subpass is recorded into the scene command buffer
+		submit_info.commandBufferCount = swap_chain.ui_subpass_enabled ? 1 : static_cast<uint32_t>(command_buffers.size());
 		submit_info.pCommandBuffers = command_buffers.data();
 
 		VkSemaphore signal_semaphores[] = {render_finished_semaphores[current_frame]};
 		submit_info.signalSemaphoreCount = 1;
 		submit_info.pSignalSemaphores = signal_semaphores;
 
-		vkResetFences(vulkan_device.logical_device, 1, &in_flight_fences[current_frame]);
+		vulkan_device.dispatch.reset_fences(vulkan_device.logical_device, 1, &in_flight_fences[current_frame]);
 
-		result = vkQueueSubmit(swap_chain.graphics_queue, 1, &submit_info, in_flight_fences[current_frame]);
+		result = vulkan_device.dispatch.queue_submit(swap_chain.graphics_queue, 1, &submit_info, in_flight_fences[current_frame]);
 		CheckVkResult(result, "Failed to submit draw command buffer");
 
 		VkPresentInfoKHR present_info{};
@@ -554,7 +1546,8 @@ private:
 
 		present_info.pImageIndices = &image_index;
 
-		result = vkQueuePresentKHR(swap_chain.present_queue, &present_info);
+		result = vulkan_device.dispatch.queue_present(swap_chain.present_queue, &present_info);
+		swap_chain.OnFramePresented();
 
 		if(result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || framebuffer_resized)
 		{
@@ -566,6 +1559,8 @@ private:
 			throw std::runtime_error("Failed to present swap chain image (VkResult: " + std::to_string(result) + ")");
 		}
 
+		EndStage("submit");
+
 		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
 	}
 
@@ -580,13 +1575,231 @@ private:
 	}
 };
 
-int main()
+// Random boxes in a cube, with as many boxes per volume at every count
+void RunBvhBenchmark()
+{
+	std::mt19937 random(1);
+
+	for(uint32_t count : {10000u, 100000u, 1000000u})
+	{
+		auto extent = 10.0f * std::cbrt(static_cast<float>(count));
+		std::uniform_real_distribution<float> position(-extent, extent);
+		std::uniform_real_distribution<float> size(0.1f, 2.0f);
+
+		std::vector<vkpg::Aabb> bounds(count);
+		for(auto& box : bounds)
+		{
+			auto center = glm::vec3(position(random), position(random), position(random));
+			auto half_extent = glm::vec3(size(random), size(random), size(random));
+			box = {center - half_extent, center + half_extent};
+		}
+
+		vkpg::Bvh bvh;
+
+		auto build_start = std::chrono::high_resolution_clock::now();
+		bvh.Build(bounds);
+		auto build_end = std::chrono::high_resolution_clock::now();
+
+		for(auto& box : bounds)
+		{
+			box.min += 0.5f;
+			box.max += 0.5f;
+		}
+		bvh.Refit(bounds);
+		auto refit_end = std::chrono::high_resolution_clock::now();
+
+		// 90 degree frusta from the center looking in random directions
+		constexpr uint32_t frustum_count = 1000;
+		std::uniform_real_distribution<float> direction(-1.0f, 1.0f);
+		vkpg::Camera camera;
+		camera.matrices.perspective = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, extent);
+
+		std::vector<uint32_t> visible;
+		size_t visible_sum = 0;
+		auto frustum_start = std::chrono::high_resolution_clock::now();
+		for(uint32_t i = 0; i < frustum_count; i++)
+		{
+			auto target = glm::vec3(direction(random), direction(random), direction(random));
+			camera.matrices.view = glm::lookAt(glm::vec3(0.0f), target, glm::vec3(0.0f, 1.0f, 0.0f));
+
+			visible.clear();
+			bvh.QueryFrustum(camera.GetFrustumPlanes(), visible);
+			visible_sum += visible.size();
+		}
+		auto frustum_end = std::chrono::high_resolution_clock::now();
+
+		constexpr uint32_t ray_count = 100000;
+		uint32_t hits = 0;
+		auto ray_start = std::chrono::high_resolution_clock::now();
+		for(uint32_t i = 0; i < ray_count; i++)
+		{
+			vkpg::Ray ray;
+			ray.origin = glm::vec3(position(random), position(random), position(random));
+			ray.direction = glm::vec3(direction(random), direction(random), direction(random));
+			hits += bvh.Raycast(ray) ? 1 : 0;
+		}
+		auto ray_end = std::chrono::high_resolution_clock::now();
+
+		auto Milliseconds = [](auto begin, auto end)
+		{
+			return std::chrono::duration<double, std::milli>(end - begin).count();
+		};
+
+		std::cout << "BVH " << count << " boxes: " << bvh.GetNodeCount() << " nodes"
+		          << ", build " << Milliseconds(build_start, build_end) << " ms"
+		          << ", refit " << Milliseconds(build_end, refit_end) << " ms"
+		          << ", " << frustum_count / Milliseconds(frustum_start, frustum_end) * 1000.0 << " frustum queries/s"
+		          << " (" << visible_sum / frustum_count << " visible)"
+		          << ", " << ray_count / Milliseconds(ray_start, ray_end) / 1000.0 << " Mrays/s"
+		          << " (" << hits * 100 / ray_count << "% hit)" << std::endl;
+	}
+}
+
+int main(int argc, char *argv[])
 {
 	Application app;
 
+	if(const char *gpu = std::getenv("VKPG_GPU"))
+	{
+		app.options.gpu = gpu;
+	}
+
+	for(int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if(argument == "--dynamic-resolution")
+		{
+			app.options.dynamic_resolution = true;
+		}
+		else if(argument == "--compact-vertices")
+		{
+			app.options.compact_vertices = true;
+		}
+		else if(argument == "--optimize-mesh")
+		{
+			app.options.optimize_mesh = true;
+		}
+		else if(argument == "--generate-lods")
+		{
+			app.options.generate_lods = true;
+		}
+		else if(argument == "--meshlets")
+		{
+			app.options.meshlets = true;
+		}
+		else if(argument == "--object-ids")
+		{
+			app.options.object_ids = true;
+		}
+		else if(argument == "--ui-subpass")
+		{
+			app.options.ui_subpass = true;
+		}
+		else if(argument == "--dynamic-rendering")
+		{
+			app.options.dynamic_rendering = true;
+		}
+		else if(argument == "--async-compute")
+		{
+			app.options.async_compute = true;
+		}
+		else if(argument == "--depth-pyramid")
+		{
+			app.options.depth_pyramid = true;
+		}
+		else if(argument == "--msaa" && i + 1 < argc)
+		{
+			// 1 turns MSAA off, counts the device doesn't support are lowered
+			auto samples = std::stoul(argv[++i]);
+			if(samples == 0 || samples > VK_SAMPLE_COUNT_64_BIT || (samples & (samples - 1)) != 0)
+			{
+				std::cerr << "--msaa needs a power of two up to 64" << std::endl;
+			}
+			else
+			{
+				app.options.anti_aliasing.samples = static_cast<VkSampleCountFlagBits>(samples);
+			}
+		}
+		else if(argument == "--sample-shading")
+		{
+			app.options.anti_aliasing.sample_shading = true;
+		}
+		else if(argument == "--fxaa")
+		{
+			app.options.anti_aliasing.fxaa = true;
+		}
+		else if(argument == "--gpu" && i + 1 < argc)
+		{
+			app.options.gpu = argv[++i];
+		}
+		else if(argument == "--bvh-benchmark")
+		{
+			app.options.bvh_benchmark = true;
+		}
+		else if(argument == "--dispatch-benchmark")
+		{
+			app.options.dispatch_benchmark = true;
+		}
+		else if(argument == "--scene-nodes" && i + 1 < argc)
+		{
+			app.options.scene_nodes = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if(argument == "--capture-sequence" && i + 1 < argc)
+		{
+			app.options.capture_sequence = argv[++i];
+		}
+		else if(argument == "--golden" && i + 1 < argc)
+		{
+			app.options.golden_directory = argv[++i];
+		}
+		else if(argument == "--update-golden")
+		{
+			app.options.update_golden = true;
+		}
+		else if(argument == "--golden-psnr" && i + 1 < argc)
+		{
+			app.options.golden_min_psnr = std::stod(argv[++i]);
+		}
+		else if(argument == "--camera-path" && i + 1 < argc)
+		{
+			app.options.camera_path = argv[++i];
+		}
+		else if(argument == "--record-camera-path" && i + 1 < argc)
+		{
+			app.options.record_camera_path = argv[++i];
+		}
+		else if(argument == "--benchmark-json" && i + 1 < argc)
+		{
+			app.options.benchmark_json = argv[++i];
+		}
+		else if(argument == "--benchmark-frames" && i + 1 < argc)
+		{
+			app.options.benchmark_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else
+		{
+			std::cerr << "Unknown argument: " << argument << std::endl;
+		}
+	}
+
 	try
 	{
+		if(app.options.bvh_benchmark)
+		{
+			RunBvhBenchmark();
+			return EXIT_SUCCESS;
+		}
+
 		app.Run();
+
+		if(app.golden_failed)
+		{
+			return EXIT_FAILURE;
+		}
+		if(app.golden_skipped > 0)
+		{
+			return GOLDEN_SKIPPED_EXIT_CODE;
+		}
 	}
 	catch(const std::exception& e)
 	{
@@ -0,0 +1,298 @@
+#include "mesh_optimizer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+vkpg::VertexCacheStatistics vkpg::AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+{
+	VertexCacheStatistics statistics;
+	if(indices.size() < 3)
+	{
+		return statistics;
+	}
+
+	// A vertex is cached while fewer than cache_size vertices were inserted after it
+	std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+	uint32_t timestamp = cache_size + 1;
+
+	std::vector<bool> referenced(vertex_count, false);
+	size_t unique_vertices = 0;
+	size_t transformed_vertices = 0;
+
+	for(auto index : indices)
+	{
+		if(timestamp - cache_timestamps[index] > cache_size)
+		{
+			cache_timestamps[index] = timestamp++;
+			transformed_vertices++;
+		}
+
+		if(!referenced[index])
+		{
+			referenced[index] = true;
+			unique_vertices++;
+		}
+	}
+
+	statistics.acmr = static_cast<float>(transformed_vertices) / static_cast<float>(indices.size() / 3);
+	statistics.atvr = static_cast<float>(transformed_vertices) / static_cast<float>(unique_vertices);
+
+	return statistics;
+}
+
+void vkpg::OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size)
+{
+	auto triangle_count = indices.size() / 3;
+	if(triangle_count == 0)
+	{
+		return;
+	}
+
+	// Triangles not yet emitted per vertex, and the triangles around each vertex packed into one array
+	std::vector<uint32_t> live_triangles(vertex_count, 0);
+	for(auto index : indices)
+	{
+		live_triangles[index]++;
+	}
+
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1, 0);
+	for(size_t vertex = 0; vertex < vertex_count; vertex++)
+	{
+		adjacency_offsets[vertex + 1] = adjacency_offsets[vertex] + live_triangles[vertex];
+	}
+
+	std::vector<uint32_t> adjacency(triangle_count * 3);
+	{
+		std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+		for(size_t i = 0; i < triangle_count * 3; i++)
+		{
+			adjacency[fill_offsets[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+	}
+
+	std::vector<uint32_t> cache_timestamps(vertex_count, 0);
+	uint32_t timestamp = cache_size + 1;
+
+	std::vector<bool> emitted(triangle_count, false);
+	std::vector<uint32_t> dead_end_stack;
+	std::vector<uint32_t> candidates;
+	uint32_t cursor = 0;
+
+	auto NextVertex = [&]() -> int64_t
+	{
+		// Prefer the candidate that entered the cache earliest but stays cached while fanning around it
+		int64_t best_vertex = -1;
+		int64_t best_priority = -1;
+		for(auto vertex : candidates)
+		{
+			if(live_triangles[vertex] == 0)
+			{
+				continue;
+			}
+
+			int64_t age = timestamp - cache_timestamps[vertex];
+			int64_t priority = age + 2 * live_triangles[vertex] <= cache_size ? age : 0;
+			if(priority > best_priority)
+			{
+				best_priority = priority;
+				best_vertex = vertex;
+			}
+		}
+
+		if(best_vertex >= 0)
+		{
+			return best_vertex;
+		}
+
+		// Dead end: go back to recently used vertices, then to any vertex that still has triangles
+		while(!dead_end_stack.empty())
+		{
+			auto vertex = dead_end_stack.back();
+			dead_end_stack.pop_back();
+			if(live_triangles[vertex] > 0)
+			{
+				return vertex;
+			}
+		}
+
+		for(; cursor < vertex_count; cursor++)
+		{
+			if(live_triangles[cursor] > 0)
+			{
+				return cursor;
+			}
+		}
+
+		return -1;
+	};
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	int64_t fanning_vertex = NextVertex();
+	while(fanning_vertex >= 0)
+	{
+		candidates.clear();
+
+		for(auto i = adjacency_offsets[fanning_vertex]; i < adjacency_offsets[fanning_vertex + 1]; i++)
+		{
+			auto triangle = adjacency[i];
+			if(emitted[triangle])
+			{
+				continue;
+			}
+
+			for(size_t corner = 0; corner < 3; corner++)
+			{
+				auto vertex = indices[triangle * 3 + corner];
+
+				result.push_back(vertex);
+				dead_end_stack.push_back(vertex);
+				candidates.push_back(vertex);
+				live_triangles[vertex]--;
+
+				if(timestamp - cache_timestamps[vertex] > cache_size)
+				{
+					cache_timestamps[vertex] = timestamp++;
+				}
+			}
+
+			emitted[triangle] = true;
+		}
+
+		fanning_vertex = NextVertex();
+	}
+
+	indices = std::move(result);
+}
+
+void vkpg::OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, uint32_t cache_size)
+{
+	auto triangle_count = indices.size() / 3;
+	if(triangle_count == 0)
+	{
+		return;
+	}
+
+	struct Cluster
+	{
+		size_t first_triangle = 0;
+		size_t triangle_count = 0;
+		glm::vec3 centroid{0.0f};
+		glm::vec3 normal{0.0f};
+		float area = 0.0f;
+		float sort_key = 0.0f;
+	};
+
+	// A triangle that misses the cache with all three vertices starts a new fan, clusters are split there
+	std::vector<Cluster> clusters;
+	std::vector<uint32_t> cache_timestamps(vertices.size(), 0);
+	uint32_t timestamp = cache_size + 1;
+
+	glm::vec3 mesh_centroid{0.0f};
+	float mesh_area = 0.0f;
+
+	for(size_t triangle = 0; triangle < triangle_count; triangle++)
+	{
+		uint32_t misses = 0;
+		for(size_t corner = 0; corner < 3; corner++)
+		{
+			auto vertex = indices[triangle * 3 + corner];
+			if(timestamp - cache_timestamps[vertex] > cache_size)
+			{
+				cache_timestamps[vertex] = timestamp++;
+				misses++;
+			}
+		}
+
+		if(clusters.empty() || misses == 3)
+		{
+			Cluster cluster;
+			cluster.first_triangle = triangle;
+			clusters.push_back(cluster);
+		}
+
+		const auto& p0 = vertices[indices[triangle * 3 + 0]].position;
+		const auto& p1 = vertices[indices[triangle * 3 + 1]].position;
+		const auto& p2 = vertices[indices[triangle * 3 + 2]].position;
+
+		// Twice the area times the normal, so larger triangles weigh more
+		auto area_normal = glm::cross(p1 - p0, p2 - p0);
+		auto area = glm::length(area_normal);
+		auto centroid = (p0 + p1 + p2) / 3.0f;
+
+		auto& cluster = clusters.back();
+		cluster.triangle_count++;
+		cluster.normal += area_normal;
+		cluster.centroid += centroid * area;
+		cluster.area += area;
+
+		mesh_centroid += centroid * area;
+		mesh_area += area;
+	}
+
+	if(clusters.size() < 2 || mesh_area <= 0.0f)
+	{
+		return;
+	}
+
+	mesh_centroid /= mesh_area;
+
+	for(auto& cluster : clusters)
+	{
+		if(cluster.area <= 0.0f || glm::length(cluster.normal) <= 0.0f)
+		{
+			continue;
+		}
+
+		cluster.centroid /= cluster.area;
+
+		// Clusters facing away from the mesh center occlude the rest from most view directions
+		cluster.sort_key = glm::dot(cluster.centroid - mesh_centroid, glm::normalize(cluster.normal));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(), [](const auto& lhs, const auto& rhs)
+	{
+		return lhs.sort_key > rhs.sort_key;
+	});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+
+	for(const auto& cluster : clusters)
+	{
+		auto begin = indices.begin() + static_cast<std::ptrdiff_t>(cluster.first_triangle * 3);
+		result.insert(result.end(), begin, begin + static_cast<std::ptrdiff_t>(cluster.triangle_count * 3));
+	}
+
+	indices = std::move(result);
+}
+
+void vkpg::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices)
+{
+	std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+
+	std::vector<Vertex> result;
+	result.reserve(vertices.size());
+	std::vector<glm::vec3> result_normals;
+	result_normals.reserve(normals.size());
+
+	for(auto& index : indices)
+	{
+		if(remap[index] == UINT32_MAX)
+		{
+			remap[index] = static_cast<uint32_t>(result.size());
+			result.push_back(vertices[index]);
+			if(!normals.empty())
+			{
+				result_normals.push_back(normals[index]);
+			}
+		}
+
+		index = remap[index];
+	}
+
+	vertices = std::move(result);
+	normals = std::move(result_normals);
+}
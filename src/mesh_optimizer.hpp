@@ -0,0 +1,33 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+struct VertexCacheStatistics
+{
+	// Average cache miss ratio: transformed vertices per triangle, 0.5 is the best case for a regular grid
+	float acmr = 0.0f;
+	// Average transform to vertex ratio: transformed vertices per referenced vertex, 1.0 is perfect
+	float atvr = 0.0f;
+};
+
+// Simulates a FIFO post-transform cache of cache_size entries
+VertexCacheStatistics AnalyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = 16);
+
+// Tipsify (Sander et al. 2007): fans around recently used vertices so that their neighbours are still cached
+void OptimizeVertexCache(std::vector<uint32_t>& indices, size_t vertex_count, uint32_t cache_size = 16);
+
+// Splits the cache optimized order into clusters at cache flushes and draws outward facing clusters first,
+// so the depth test rejects more of the later ones. Keeps the order inside each cluster, so the ACMR barely changes.
+void OptimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, uint32_t cache_size = 16);
+
+// Orders vertices by first use in the index buffer, so vertex fetch walks memory linearly. Unused vertices are dropped.
+// Per-vertex normals, if there are any, are reordered along with them.
+void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<glm::vec3>& normals, std::vector<uint32_t>& indices);
+
+} // namespace vkpg
@@ -0,0 +1,351 @@
+#include "mesh_simplifier.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+namespace
+{
+
+// Symmetric 4x4 matrix, the sum of squared distances to a set of planes
+struct Quadric
+{
+	double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0;
+	double b2 = 0.0, bc = 0.0, bd = 0.0;
+	double c2 = 0.0, cd = 0.0;
+	double d2 = 0.0;
+
+	static Quadric FromPlane(double a, double b, double c, double d)
+	{
+		Quadric q;
+		q.a2 = a * a; q.ab = a * b; q.ac = a * c; q.ad = a * d;
+		q.b2 = b * b; q.bc = b * c; q.bd = b * d;
+		q.c2 = c * c; q.cd = c * d;
+		q.d2 = d * d;
+		return q;
+	}
+
+	Quadric& operator+=(const Quadric& other)
+	{
+		a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+		b2 += other.b2; bc += other.bc; bd += other.bd;
+		c2 += other.c2; cd += other.cd;
+		d2 += other.d2;
+		return *this;
+	}
+
+	Quadric operator+(const Quadric& other) const
+	{
+		Quadric result = *this;
+		result += other;
+		return result;
+	}
+
+	double Evaluate(const glm::vec3& point) const
+	{
+		double x = point.x, y = point.y, z = point.z;
+		auto error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+		             b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+		             c2 * z * z + 2.0 * cd * z +
+		             d2;
+		return std::max(error, 0.0);
+	}
+};
+
+glm::vec3 TriangleNormal(const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2)
+{
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+} // namespace
+
+std::vector<uint32_t> vkpg::SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                         size_t target_index_count, float max_error, float *result_error)
+{
+	auto vertex_count = vertices.size();
+	std::vector<uint32_t> current = indices;
+	double largest_error = 0.0;
+
+	// Vertices sharing a position are split by an attribute seam, moving one of them would tear the mesh
+	std::vector<uint32_t> position_group(vertex_count);
+	std::vector<uint32_t> group_size;
+	{
+		std::map<std::tuple<float, float, float>, uint32_t> groups;
+		for(size_t i = 0; i < vertex_count; i++)
+		{
+			const auto& position = vertices[i].position;
+			auto [it, inserted] = groups.emplace(std::make_tuple(position.x, position.y, position.z), static_cast<uint32_t>(group_size.size()));
+			if(inserted)
+			{
+				group_size.push_back(0);
+			}
+			position_group[i] = it->second;
+			group_size[it->second]++;
+		}
+	}
+
+	std::vector<bool> locked(vertex_count, false);
+	for(size_t i = 0; i < vertex_count; i++)
+	{
+		locked[i] = group_size[position_group[i]] > 1;
+	}
+
+	// Edges used by a single triangle are on the border
+	{
+		std::map<std::pair<uint32_t, uint32_t>, uint32_t> edge_use;
+		for(size_t i = 0; i + 2 < current.size(); i += 3)
+		{
+			for(size_t corner = 0; corner < 3; corner++)
+			{
+				auto a = position_group[current[i + corner]];
+				auto b = position_group[current[i + (corner + 1) % 3]];
+				edge_use[{std::min(a, b), std::max(a, b)}]++;
+			}
+		}
+
+		for(size_t i = 0; i + 2 < current.size(); i += 3)
+		{
+			for(size_t corner = 0; corner < 3; corner++)
+			{
+				auto v0 = current[i + corner];
+				auto v1 = current[i + (corner + 1) % 3];
+				auto a = position_group[v0];
+				auto b = position_group[v1];
+				if(edge_use[{std::min(a, b), std::max(a, b)}] == 1)
+				{
+					locked[v0] = true;
+					locked[v1] = true;
+				}
+			}
+		}
+	}
+
+	std::vector<Quadric> quadrics(vertex_count);
+	for(size_t i = 0; i + 2 < current.size(); i += 3)
+	{
+		const auto& p0 = vertices[current[i + 0]].position;
+		auto normal = TriangleNormal(p0, vertices[current[i + 1]].position, vertices[current[i + 2]].position);
+		auto length = glm::length(normal);
+		if(length <= 0.0f)
+		{
+			continue;
+		}
+		normal /= length;
+
+		auto plane = Quadric::FromPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0));
+		for(size_t corner = 0; corner < 3; corner++)
+		{
+			quadrics[current[i + corner]] += plane;
+		}
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+
+	auto max_cost = static_cast<double>(max_error) * static_cast<double>(max_error);
+
+	std::vector<uint32_t> adjacency_offsets(vertex_count + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<bool> touched(vertex_count);
+	std::vector<uint32_t> remap(vertex_count);
+
+	while(current.size() > target_index_count)
+	{
+		// Triangles around each vertex
+		std::fill(adjacency_offsets.begin(), adjacency_offsets.end(), 0);
+		for(auto index : current)
+		{
+			adjacency_offsets[index + 1]++;
+		}
+		for(size_t i = 0; i < vertex_count; i++)
+		{
+			adjacency_offsets[i + 1] += adjacency_offsets[i];
+		}
+		adjacency.resize(current.size());
+		{
+			std::vector<uint32_t> fill_offsets(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+			for(size_t i = 0; i < current.size(); i++)
+			{
+				adjacency[fill_offsets[current[i]]++] = static_cast<uint32_t>(i / 3);
+			}
+		}
+
+		collapses.clear();
+		for(size_t i = 0; i + 2 < current.size(); i += 3)
+		{
+			for(size_t corner = 0; corner < 3; corner++)
+			{
+				auto a = current[i + corner];
+				auto b = current[i + (corner + 1) % 3];
+
+				auto quadric = quadrics[a] + quadrics[b];
+				if(!locked[a])
+				{
+					collapses.push_back({a, b, quadric.Evaluate(vertices[b].position)});
+				}
+				if(!locked[b])
+				{
+					collapses.push_back({b, a, quadric.Evaluate(vertices[a].position)});
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const auto& lhs, const auto& rhs)
+		{
+			return lhs.cost < rhs.cost;
+		});
+
+		// Collapsing an interior edge removes two triangles
+		auto collapses_needed = (current.size() - target_index_count) / 6 + 1;
+		size_t collapses_done = 0;
+
+		std::fill(touched.begin(), touched.end(), false);
+		for(size_t i = 0; i < vertex_count; i++)
+		{
+			remap[i] = static_cast<uint32_t>(i);
+		}
+
+		for(const auto& collapse : collapses)
+		{
+			if(collapse.cost > max_cost || collapses_done >= collapses_needed)
+			{
+				break;
+			}
+
+			if(touched[collapse.from] || touched[collapse.to])
+			{
+				continue;
+			}
+
+			// Moving the vertex must not flip any of the remaining triangles around it
+			bool flips = false;
+			for(auto a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1] && !flips; a++)
+			{
+				auto triangle = adjacency[a] * 3;
+				std::array<uint32_t, 3> corners{{current[triangle], current[triangle + 1], current[triangle + 2]}};
+				if(std::find(corners.begin(), corners.end(), collapse.to) != corners.end())
+				{
+					continue;
+				}
+
+				auto before = TriangleNormal(vertices[corners[0]].position, vertices[corners[1]].position, vertices[corners[2]].position);
+				std::replace(corners.begin(), corners.end(), collapse.from, collapse.to);
+				auto after = TriangleNormal(vertices[corners[0]].position, vertices[corners[1]].position, vertices[corners[2]].position);
+
+				flips = glm::dot(before, after) <= 0.0f;
+			}
+
+			if(flips)
+			{
+				continue;
+			}
+
+			remap[collapse.from] = collapse.to;
+			quadrics[collapse.to] += quadrics[collapse.from];
+			largest_error = std::max(largest_error, collapse.cost);
+			collapses_done++;
+
+			// Everything around the collapsed vertex changed, it is revisited in the next pass
+			for(auto a = adjacency_offsets[collapse.from]; a < adjacency_offsets[collapse.from + 1]; a++)
+			{
+				auto triangle = adjacency[a] * 3;
+				touched[current[triangle]] = true;
+				touched[current[triangle + 1]] = true;
+				touched[current[triangle + 2]] = true;
+			}
+		}
+
+		if(collapses_done == 0)
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the triangles that became degenerate
+		size_t write = 0;
+		for(size_t i = 0; i + 2 < current.size(); i += 3)
+		{
+			auto a = remap[current[i]];
+			auto b = remap[current[i + 1]];
+			auto c = remap[current[i + 2]];
+			if(a == b || b == c || a == c)
+			{
+				continue;
+			}
+
+			current[write++] = a;
+			current[write++] = b;
+			current[write++] = c;
+		}
+		current.resize(write);
+	}
+
+	if(result_error != nullptr)
+	{
+		*result_error = static_cast<float>(std::sqrt(largest_error));
+	}
+
+	return current;
+}
+
+std::vector<vkpg::MeshLod> vkpg::GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t max_lods)
+{
+	std::vector<MeshLod> lods;
+
+	MeshLod base_lod;
+	base_lod.first_index = 0;
+	base_lod.index_count = static_cast<uint32_t>(indices.size());
+	base_lod.error = 0.0f;
+	lods.push_back(base_lod);
+
+	// Every level is simplified from the previous one, so the errors add up
+	std::vector<uint32_t> source = indices;
+	for(uint32_t level = 1; level <= max_lods; level++)
+	{
+		auto target_index_count = source.size() / 6 * 3;
+
+		float error = 0.0f;
+		auto simplified = SimplifyMesh(vertices, source, target_index_count, FLT_MAX, &error);
+
+		// Locked borders and seams can keep a level from shrinking much, further levels would only cost memory
+		if(simplified.empty() || simplified.size() > source.size() * 9 / 10)
+		{
+			break;
+		}
+
+		MeshLod lod;
+		lod.first_index = static_cast<uint32_t>(indices.size());
+		lod.index_count = static_cast<uint32_t>(simplified.size());
+		lod.error = lods.back().error + error;
+		lods.push_back(lod);
+
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		source = std::move(simplified);
+	}
+
+	return lods;
+}
+
+uint32_t vkpg::SelectLod(const std::vector<MeshLod>& lods, float distance, float fov_y, float viewport_height, float max_pixel_error)
+{
+	// Pixels covered by one object space unit at that distance
+	auto pixels_per_unit = viewport_height / (2.0f * std::tan(fov_y * 0.5f) * std::max(distance, 0.0001f));
+
+	uint32_t selected = 0;
+	for(uint32_t i = 0; i < lods.size(); i++)
+	{
+		if(lods[i].error * pixels_per_unit <= max_pixel_error)
+		{
+			selected = i;
+		}
+	}
+
+	return selected;
+}
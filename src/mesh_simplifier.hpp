@@ -0,0 +1,32 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+// A range of the shared index buffer. error is the object space distance the LOD may deviate from LOD 0.
+struct MeshLod
+{
+	uint32_t first_index = 0;
+	uint32_t index_count = 0;
+	float error = 0.0f;
+};
+
+// Edge collapse simplification with quadric error metrics (Garland & Heckbert 1997). Vertices only collapse onto
+// existing neighbours, so the result indexes the same vertex buffer. Borders and attribute seams stay locked.
+// Stops at target_index_count or when the next collapse would exceed max_error, result_error gets the largest error.
+std::vector<uint32_t> SimplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                   size_t target_index_count, float max_error, float *result_error = nullptr);
+
+// Appends up to max_lods coarser levels behind LOD 0 (the current indices), each with about half the triangles
+std::vector<MeshLod> GenerateLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t max_lods = 4);
+
+// The coarsest LOD whose error, projected at distance, stays below max_pixel_error pixels
+uint32_t SelectLod(const std::vector<MeshLod>& lods, float distance, float fov_y, float viewport_height,
+                   float max_pixel_error = 1.0f);
+
+} // namespace vkpg
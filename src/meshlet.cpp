@@ -0,0 +1,186 @@
+#include "meshlet.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace
+{
+
+void ComputeMeshletBounds(vkpg::Meshlet& meshlet, const vkpg::MeshletMesh& mesh, const std::vector<vkpg::Vertex>& vertices)
+{
+	auto Position = [&](uint32_t local_index) -> const glm::vec3&
+	{
+		return vertices[mesh.vertices[meshlet.vertex_offset + local_index]].position;
+	};
+
+	auto bounds_min = Position(0);
+	auto bounds_max = bounds_min;
+	for(uint32_t i = 1; i < meshlet.vertex_count; i++)
+	{
+		bounds_min = glm::min(bounds_min, Position(i));
+		bounds_max = glm::max(bounds_max, Position(i));
+	}
+
+	meshlet.center = (bounds_min + bounds_max) * 0.5f;
+	meshlet.radius = 0.0f;
+	for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+	{
+		meshlet.radius = std::max(meshlet.radius, glm::length(Position(i) - meshlet.center));
+	}
+
+	std::vector<glm::vec3> normals;
+	normals.reserve(meshlet.triangle_count);
+
+	glm::vec3 axis{0.0f};
+	for(uint32_t i = 0; i < meshlet.triangle_count; i++)
+	{
+		auto triangle = mesh.triangles[meshlet.triangle_offset + i];
+		const auto& p0 = Position(triangle & 0xff);
+		const auto& p1 = Position((triangle >> 8) & 0xff);
+		const auto& p2 = Position((triangle >> 16) & 0xff);
+
+		auto normal = glm::cross(p1 - p0, p2 - p0);
+		auto length = glm::length(normal);
+		if(length <= 0.0f)
+		{
+			continue;
+		}
+
+		normals.push_back(normal / length);
+		axis += normals.back();
+	}
+
+	meshlet.cone_axis = glm::vec3(0.0f);
+	meshlet.cone_cutoff = 1.0f;
+
+	if(normals.empty() || glm::length(axis) <= 0.0f)
+	{
+		return;
+	}
+
+	axis = glm::normalize(axis);
+
+	auto min_dot = 1.0f;
+	for(const auto& normal : normals)
+	{
+		min_dot = std::min(min_dot, glm::dot(normal, axis));
+	}
+
+	// The normals spread over more than a hemisphere, some triangle always faces the camera
+	if(min_dot <= 0.0f)
+	{
+		return;
+	}
+
+	// All triangles face away once the view direction is within 90 degrees minus the cone angle of the axis
+	meshlet.cone_axis = axis;
+	meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+}
+
+} // namespace
+
+uint32_t vkpg::MeshletMesh::GetMaxTriangleCount() const
+{
+	uint32_t max_triangles = 0;
+	for(const auto& lod : lods)
+	{
+		uint32_t triangles = 0;
+		for(uint32_t i = 0; i < lod.meshlet_count; i++)
+		{
+			triangles += meshlets[lod.first_meshlet + i].triangle_count;
+		}
+		max_triangles = std::max(max_triangles, triangles);
+	}
+
+	return max_triangles;
+}
+
+vkpg::MeshletMesh vkpg::BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                                      const std::vector<MeshLod>& lods, uint32_t max_vertices, uint32_t max_triangles)
+{
+	if(max_vertices < 3 || max_vertices > 256 || max_triangles < 1 || max_triangles > 256)
+	{
+		throw std::invalid_argument("Meshlets need 3 to 256 vertices and 1 to 256 triangles");
+	}
+
+	std::vector<MeshLod> ranges = lods;
+	if(ranges.empty())
+	{
+		ranges.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+	}
+
+	MeshletMesh mesh;
+
+	// Local index of each vertex in the meshlet being built, UINT32_MAX when it is not part of it
+	std::vector<uint32_t> local_indices(vertices.size(), UINT32_MAX);
+
+	for(const auto& range : ranges)
+	{
+		MeshletRange meshlet_range;
+		meshlet_range.first_meshlet = static_cast<uint32_t>(mesh.meshlets.size());
+
+		Meshlet meshlet;
+		meshlet.vertex_offset = static_cast<uint32_t>(mesh.vertices.size());
+		meshlet.triangle_offset = static_cast<uint32_t>(mesh.triangles.size());
+
+		auto FinishMeshlet = [&]()
+		{
+			if(meshlet.triangle_count == 0)
+			{
+				return;
+			}
+
+			for(uint32_t i = 0; i < meshlet.vertex_count; i++)
+			{
+				local_indices[mesh.vertices[meshlet.vertex_offset + i]] = UINT32_MAX;
+			}
+
+			ComputeMeshletBounds(meshlet, mesh, vertices);
+			mesh.meshlets.push_back(meshlet);
+
+			meshlet = Meshlet{};
+			meshlet.vertex_offset = static_cast<uint32_t>(mesh.vertices.size());
+			meshlet.triangle_offset = static_cast<uint32_t>(mesh.triangles.size());
+		};
+
+		for(uint32_t i = range.first_index; i + 2 < range.first_index + range.index_count; i += 3)
+		{
+			std::array<uint32_t, 3> corners{{indices[i], indices[i + 1], indices[i + 2]}};
+
+			uint32_t new_vertices = 0;
+			for(auto vertex : corners)
+			{
+				new_vertices += local_indices[vertex] == UINT32_MAX ? 1 : 0;
+			}
+			// A triangle repeating a new vertex would be counted twice, which only ends the meshlet a bit early
+			if(meshlet.vertex_count + new_vertices > max_vertices || meshlet.triangle_count + 1 > max_triangles)
+			{
+				FinishMeshlet();
+			}
+
+			uint32_t packed_triangle = 0;
+			for(uint32_t corner = 0; corner < 3; corner++)
+			{
+				auto vertex = corners[corner];
+				if(local_indices[vertex] == UINT32_MAX)
+				{
+					local_indices[vertex] = meshlet.vertex_count++;
+					mesh.vertices.push_back(vertex);
+				}
+				packed_triangle |= local_indices[vertex] << (corner * 8);
+			}
+
+			mesh.triangles.push_back(packed_triangle);
+			meshlet.triangle_count++;
+		}
+
+		FinishMeshlet();
+
+		meshlet_range.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size()) - meshlet_range.first_meshlet;
+		mesh.lods.push_back(meshlet_range);
+	}
+
+	return mesh;
+}
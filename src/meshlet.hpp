@@ -0,0 +1,87 @@
+#pragma once
+
+#include "mesh_simplifier.hpp"
+#include "vertex.hpp"
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+// std430 layout, shared with the culling, task and mesh shaders
+struct Meshlet
+{
+	// Bounding sphere in model space
+	glm::vec3 center{0.0f};
+	float radius = 0.0f;
+
+	// Every triangle faces away from a camera for which
+	// dot(center - camera, cone_axis) >= cone_cutoff * length(center - camera) + radius
+	glm::vec3 cone_axis{0.0f};
+	float cone_cutoff = 1.0f;
+
+	uint32_t vertex_offset = 0;
+	uint32_t triangle_offset = 0;
+	uint32_t vertex_count = 0;
+	uint32_t triangle_count = 0;
+};
+
+static_assert(sizeof(Meshlet) == 48);
+
+struct MeshletRange
+{
+	uint32_t first_meshlet = 0;
+	uint32_t meshlet_count = 0;
+};
+
+struct MeshletMesh
+{
+	std::vector<Meshlet> meshlets;
+	// Indices into the vertex buffer, a meshlet's local vertex i is vertices[vertex_offset + i]
+	std::vector<uint32_t> vertices;
+	// One triangle per entry, three local 8-bit vertex indices in the low bytes
+	std::vector<uint32_t> triangles;
+	// Meshlets of each LOD, one range per MeshLod (or a single one without LODs)
+	std::vector<MeshletRange> lods;
+
+	// Triangles of the largest LOD, sizes the culled index buffers
+	uint32_t GetMaxTriangleCount() const;
+};
+
+// Push constants of meshlet_cull.comp, meshlet.task and meshlet.mesh, fills the guaranteed 128 bytes
+struct MeshletConstants
+{
+	// Model space, xyz normalized and pointing inside
+	glm::vec4 frustum_planes[6];
+	glm::vec4 camera_position;
+	uint32_t first_meshlet;
+	uint32_t meshlet_count;
+	uint32_t flags;
+	uint32_t material_index;
+};
+
+static_assert(sizeof(MeshletConstants) == 128);
+
+constexpr uint32_t MESHLET_FRUSTUM_CULLING = 1;
+constexpr uint32_t MESHLET_CONE_CULLING = 2;
+constexpr uint32_t MESHLET_COMPACT_VERTICES = 4;
+
+// Per image buffer the culling writes into: the indirect draw of the compacted indices and a visible meshlet counter.
+// With mesh shaders only the counters are used, index_count then counts the emitted triangles times three.
+struct MeshletDrawData
+{
+	VkDrawIndexedIndirectCommand command;
+	uint32_t visible_meshlets;
+};
+
+// Splits every LOD range of indices into meshlets of at most max_vertices and max_triangles (at most 256 each).
+// Triangles are taken in index order, so a vertex cache optimized index buffer gives fuller meshlets.
+MeshletMesh BuildMeshlets(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices,
+                          const std::vector<MeshLod>& lods, uint32_t max_vertices = 64, uint32_t max_triangles = 124);
+
+} // namespace vkpg
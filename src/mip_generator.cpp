@@ -0,0 +1,318 @@
+#include "mip_generator.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+
+vkpg::MipGenerator::MipGenerator(VulkanDevice& vulkan_device, PipelineCache& pipelines, DescriptorLayoutCache& descriptor_layout_cache) :
+    vulkan_device(vulkan_device), pipelines(pipelines), descriptor_layout_cache(descriptor_layout_cache)
+{
+
+}
+
+void vkpg::MipGenerator::Create()
+{
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = levels_per_dispatch;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(Constants);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &pipeline_layout);
+	CheckVkResult(result, "Failed to create mip generation pipeline layout");
+
+	pipeline = pipelines.GetComputePipeline("shaders/downsample.comp.spv", pipeline_layout);
+
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_NEAREST;
+	sampler_info.minFilter = VK_FILTER_NEAREST;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.maxLod = 0.0f;
+
+	result = vkCreateSampler(vulkan_device.logical_device, &sampler_info, nullptr, &sampler);
+	CheckVkResult(result, "Failed to create mip generation sampler");
+}
+
+void vkpg::MipGenerator::Cleanup()
+{
+	// The pipeline belongs to the pipeline cache and the set layout to the layout cache
+	vkDestroyPipelineLayout(vulkan_device.logical_device, pipeline_layout, nullptr);
+	vkDestroySampler(vulkan_device.logical_device, sampler, nullptr);
+	pipeline_layout = VK_NULL_HANDLE;
+	pipeline = VK_NULL_HANDLE;
+	sampler = VK_NULL_HANDLE;
+}
+
+bool vkpg::MipGenerator::IsSupported(VkFormat format) const
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(vulkan_device.physical_device, &properties);
+	if(vulkan_device.api_version < VK_API_VERSION_1_1 || properties.apiVersion < VK_API_VERSION_1_1)
+	{
+		return false;
+	}
+
+	// downsample.comp writes rgba8
+	auto storage_format = GetStorageFormat(format);
+	if(storage_format != VK_FORMAT_R8G8B8A8_UNORM)
+	{
+		return false;
+	}
+
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.physical_device, format, &format_properties);
+	VkFormatProperties storage_format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.physical_device, storage_format, &storage_format_properties);
+
+	return (format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) &&
+	       (storage_format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT);
+}
+
+VkImageCreateFlags vkpg::MipGenerator::GetImageFlags(VkFormat format)
+{
+	// sRGB formats can't be stored to, the UNORM views need a mutable format and usage checked per view format
+	if(GetStorageFormat(format) != format)
+	{
+		return VK_IMAGE_CREATE_MUTABLE_FORMAT_BIT | VK_IMAGE_CREATE_EXTENDED_USAGE_BIT;
+	}
+	return 0;
+}
+
+VkImageUsageFlags vkpg::MipGenerator::GetImageUsage()
+{
+	return VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+}
+
+vkpg::MipGenerator::Target vkpg::MipGenerator::CreateTarget(VkImage image, VkFormat format, VkExtent2D extent, uint32_t mip_levels) const
+{
+	Target target;
+	target.image = image;
+	target.extent = extent;
+	target.mip_levels = mip_levels;
+
+	auto storage_format = GetStorageFormat(format);
+	target.srgb = storage_format != format;
+
+	for(uint32_t level = 0; level < mip_levels; level++)
+	{
+		target.sampled_views.push_back(CreateView(image, format, level, VK_IMAGE_USAGE_SAMPLED_BIT));
+		target.storage_views.push_back(CreateView(image, storage_format, level, VK_IMAGE_USAGE_STORAGE_BIT));
+	}
+
+	auto dispatch_count = (mip_levels - 1 + levels_per_dispatch - 1) / levels_per_dispatch;
+	if(dispatch_count == 0)
+	{
+		return target;
+	}
+
+	DescriptorAllocator::PoolSizes pool_sizes =
+	{
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, static_cast<float>(levels_per_dispatch)}
+	};
+	target.descriptor_pool = DescriptorAllocator::CreatePool(vulkan_device.logical_device, pool_sizes, dispatch_count);
+
+	std::vector<VkDescriptorSetLayout> layouts(dispatch_count, descriptor_set_layout);
+	target.descriptor_sets.resize(dispatch_count);
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = target.descriptor_pool;
+	alloc_info.descriptorSetCount = dispatch_count;
+	alloc_info.pSetLayouts = layouts.data();
+
+	auto result = vulkan_device.dispatch.allocate_descriptor_sets(vulkan_device.logical_device, &alloc_info, target.descriptor_sets.data());
+	CheckVkResult(result, "Failed to allocate mip generation descriptor sets");
+
+	for(uint32_t dispatch = 0; dispatch < dispatch_count; dispatch++)
+	{
+		auto source_level = dispatch * levels_per_dispatch;
+		auto last_level = std::min(source_level + levels_per_dispatch, mip_levels - 1);
+
+		VkDescriptorImageInfo source_info{};
+		source_info.sampler = sampler;
+		source_info.imageView = target.sampled_views[source_level];
+		source_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		// Unused entries repeat the last level, the shader doesn't write them
+		std::array<VkDescriptorImageInfo, levels_per_dispatch> level_infos{};
+		for(uint32_t i = 0; i < levels_per_dispatch; i++)
+		{
+			level_infos[i].imageView = target.storage_views[std::min(source_level + 1 + i, last_level)];
+			level_infos[i].imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		}
+
+		std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
+		descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_writes[0].dstSet = target.descriptor_sets[dispatch];
+		descriptor_writes[0].dstBinding = 0;
+		descriptor_writes[0].descriptorCount = 1;
+		descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptor_writes[0].pImageInfo = &source_info;
+		descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptor_writes[1].dstSet = target.descriptor_sets[dispatch];
+		descriptor_writes[1].dstBinding = 1;
+		descriptor_writes[1].descriptorCount = levels_per_dispatch;
+		descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		descriptor_writes[1].pImageInfo = level_infos.data();
+
+		vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+		                                              descriptor_writes.data(), 0, nullptr);
+	}
+
+	return target;
+}
+
+void vkpg::MipGenerator::DestroyTarget(Target& target) const
+{
+	for(size_t i = 0; i < target.sampled_views.size(); i++)
+	{
+		vkDestroyImageView(vulkan_device.logical_device, target.sampled_views[i], nullptr);
+		vkDestroyImageView(vulkan_device.logical_device, target.storage_views[i], nullptr);
+	}
+
+	// Frees the sets with it
+	vkDestroyDescriptorPool(vulkan_device.logical_device, target.descriptor_pool, nullptr);
+
+	target = {};
+}
+
+void vkpg::MipGenerator::Record(VkCommandBuffer command_buffer, const Target& target, const ImageState& level_0_state,
+                                VkPipelineStageFlags destination_stages) const
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = target.image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+
+	// Level 0 is read by the first dispatch and afterwards, the others are written
+	std::array<VkImageMemoryBarrier, 2> barriers{barrier, barrier};
+	barriers[0].subresourceRange.baseMipLevel = 0;
+	barriers[0].subresourceRange.levelCount = 1;
+	barriers[0].oldLayout = level_0_state.layout;
+	barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barriers[0].srcAccessMask = level_0_state.access;
+	barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barriers[1].subresourceRange.baseMipLevel = 1;
+	barriers[1].subresourceRange.levelCount = target.mip_levels - 1;
+	barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barriers[1].newLayout = VK_IMAGE_LAYOUT_GENERAL;
+	barriers[1].srcAccessMask = 0;
+	barriers[1].dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, level_0_state.stages, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | destination_stages, 0,
+	                                            0, nullptr,
+	                                            0, nullptr,
+	                                            target.mip_levels > 1 ? 2 : 1, barriers.data());
+
+	if(target.mip_levels <= 1)
+	{
+		return;
+	}
+
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+
+	auto source_extent = target.extent;
+	for(uint32_t dispatch = 0; dispatch < target.descriptor_sets.size(); dispatch++)
+	{
+		auto source_level = dispatch * levels_per_dispatch;
+		auto level_count = std::min(levels_per_dispatch, target.mip_levels - 1 - source_level);
+
+		Constants constants;
+		constants.source_width = static_cast<int32_t>(source_extent.width);
+		constants.source_height = static_cast<int32_t>(source_extent.height);
+		constants.level_count = static_cast<int32_t>(level_count);
+		constants.srgb = target.srgb ? 1 : 0;
+
+		vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline_layout, 0, 1,
+		                                                &target.descriptor_sets[dispatch], 0, nullptr);
+		vulkan_device.dispatch.cmd_push_constants(command_buffer, pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+
+		// A thread per texel of the first written level
+		auto width = std::max(source_extent.width / 2, 1u);
+		auto height = std::max(source_extent.height / 2, 1u);
+		vulkan_device.dispatch.cmd_dispatch(command_buffer, (width + tile_size - 1) / tile_size, (height + tile_size - 1) / tile_size, 1);
+
+		// The next dispatch reads the last of them, everything after the generation reads all of them
+		barrier.subresourceRange.baseMipLevel = source_level + 1;
+		barrier.subresourceRange.levelCount = level_count;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                                            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | destination_stages, 0,
+		                                            0, nullptr,
+		                                            0, nullptr,
+		                                            1, &barrier);
+
+		for(uint32_t level = 0; level < level_count; level++)
+		{
+			source_extent.width = std::max(source_extent.width / 2, 1u);
+			source_extent.height = std::max(source_extent.height / 2, 1u);
+		}
+	}
+}
+
+VkFormat vkpg::MipGenerator::GetStorageFormat(VkFormat format)
+{
+	switch(format)
+	{
+		case VK_FORMAT_R8G8B8A8_SRGB: return VK_FORMAT_R8G8B8A8_UNORM;
+		case VK_FORMAT_B8G8R8A8_SRGB: return VK_FORMAT_B8G8R8A8_UNORM;
+		default: return format;
+	}
+}
+
+VkImageView vkpg::MipGenerator::CreateView(VkImage image, VkFormat format, uint32_t level, VkImageUsageFlags usage) const
+{
+	// Limits the view to the usage its format supports, the image has both
+	VkImageViewUsageCreateInfo usage_info{};
+	usage_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_USAGE_CREATE_INFO;
+	usage_info.usage = usage;
+
+	VkImageViewCreateInfo view_info{};
+	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+	view_info.pNext = &usage_info;
+	view_info.image = image;
+	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	view_info.format = format;
+	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	view_info.subresourceRange.baseMipLevel = level;
+	view_info.subresourceRange.levelCount = 1;
+	view_info.subresourceRange.baseArrayLayer = 0;
+	view_info.subresourceRange.layerCount = 1;
+
+	VkImageView view;
+	auto result = vkCreateImageView(vulkan_device.logical_device, &view_info, nullptr, &view);
+	CheckVkResult(result, "Failed to create mip level view");
+
+	return view;
+}
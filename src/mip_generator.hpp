@@ -0,0 +1,87 @@
+#pragma once
+
+#include "descriptors.hpp"
+#include "device.hpp"
+#include "pipeline.hpp"
+#include "render_graph.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+// Fills a mip chain from level 0 with a compute 2x2 box filter. A dispatch writes up to five levels, reducing the
+// ones below the first in shared memory, so a 4096x4096 image takes three dispatches with a barrier on the last
+// written level between them instead of a blit and two barriers per level. Works on formats without linear
+// filtering. sRGB images are filtered in linear space: they are read through an sRGB view and written through
+// UNORM views with the encoding done in the shader.
+class MipGenerator
+{
+public:
+	// Views and descriptor sets of one image, create once and record as often as the image changes
+	struct Target
+	{
+		VkImage image{VK_NULL_HANDLE};
+		VkExtent2D extent{};
+		uint32_t mip_levels = 0;
+		bool srgb = false;
+
+		// Per level
+		std::vector<VkImageView> sampled_views;
+		std::vector<VkImageView> storage_views;
+
+		VkDescriptorPool descriptor_pool{VK_NULL_HANDLE};
+		// Per dispatch
+		std::vector<VkDescriptorSet> descriptor_sets;
+	};
+
+	MipGenerator(vkpg::VulkanDevice& vulkan_device, vkpg::PipelineCache& pipelines, vkpg::DescriptorLayoutCache& descriptor_layout_cache);
+
+	void Create();
+	void Cleanup();
+
+	// Needs Vulkan 1.1 to create storage views of sRGB images
+	bool IsSupported(VkFormat format) const;
+	// Have to be added to the image's create info
+	static VkImageCreateFlags GetImageFlags(VkFormat format);
+	static VkImageUsageFlags GetImageUsage();
+
+	Target CreateTarget(VkImage image, VkFormat format, VkExtent2D extent, uint32_t mip_levels) const;
+	void DestroyTarget(Target& target) const;
+
+	// Level 0 is read in level_0_state, the other levels' contents are discarded. Every level ends up in
+	// VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, visible to destination_stages.
+	void Record(VkCommandBuffer command_buffer, const Target& target, const vkpg::ImageState& level_0_state,
+	            VkPipelineStageFlags destination_stages) const;
+
+private:
+	// Matches downsample.comp
+	static constexpr uint32_t levels_per_dispatch = 5;
+	static constexpr uint32_t tile_size = 16;
+
+	struct Constants
+	{
+		int32_t source_width = 0;
+		int32_t source_height = 0;
+		int32_t level_count = 0;
+		int32_t srgb = 0;
+	};
+
+	static VkFormat GetStorageFormat(VkFormat format);
+	VkImageView CreateView(VkImage image, VkFormat format, uint32_t level, VkImageUsageFlags usage) const;
+
+	vkpg::VulkanDevice& vulkan_device;
+	vkpg::PipelineCache& pipelines;
+	vkpg::DescriptorLayoutCache& descriptor_layout_cache;
+
+	VkDescriptorSetLayout descriptor_set_layout{VK_NULL_HANDLE};
+	VkPipelineLayout pipeline_layout{VK_NULL_HANDLE};
+	VkPipeline pipeline{VK_NULL_HANDLE};
+	// Nearest, the shader only fetches texels
+	VkSampler sampler{VK_NULL_HANDLE};
+};
+
+} // namespace vkpg
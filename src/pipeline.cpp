@@ -0,0 +1,471 @@
+#include "pipeline.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+
+bool vkpg::PipelineState::operator==(const PipelineState& other) const
+{
+	auto bindings_equal = std::equal(vertex_bindings.cbegin(), vertex_bindings.cend(),
+	                                 other.vertex_bindings.cbegin(), other.vertex_bindings.cend(),
+	                                 [](const auto& lhs, const auto& rhs)
+	{
+		return lhs.binding == rhs.binding && lhs.stride == rhs.stride && lhs.inputRate == rhs.inputRate;
+	});
+
+	auto attributes_equal = std::equal(vertex_attributes.cbegin(), vertex_attributes.cend(),
+	                                   other.vertex_attributes.cbegin(), other.vertex_attributes.cend(),
+	                                   [](const auto& lhs, const auto& rhs)
+	{
+		return lhs.location == rhs.location && lhs.binding == rhs.binding &&
+		       lhs.format == rhs.format && lhs.offset == rhs.offset;
+	});
+
+	return bindings_equal && attributes_equal &&
+	       vertex_shader == other.vertex_shader &&
+	       fragment_shader == other.fragment_shader &&
+	       task_shader == other.task_shader &&
+	       mesh_shader == other.mesh_shader &&
+	       topology == other.topology &&
+	       polygon_mode == other.polygon_mode &&
+	       cull_mode == other.cull_mode &&
+	       front_face == other.front_face &&
+	       depth_test == other.depth_test &&
+	       depth_write == other.depth_write &&
+	       depth_compare_op == other.depth_compare_op &&
+	       blend_enable == other.blend_enable &&
+	       src_color_blend_factor == other.src_color_blend_factor &&
+	       dst_color_blend_factor == other.dst_color_blend_factor &&
+	       color_blend_op == other.color_blend_op &&
+	       src_alpha_blend_factor == other.src_alpha_blend_factor &&
+	       dst_alpha_blend_factor == other.dst_alpha_blend_factor &&
+	       alpha_blend_op == other.alpha_blend_op &&
+	       color_attachment_count == other.color_attachment_count &&
+	       samples == other.samples &&
+	       sample_shading == other.sample_shading &&
+	       min_sample_shading == other.min_sample_shading &&
+	       layout == other.layout &&
+	       render_pass == other.render_pass &&
+	       subpass == other.subpass &&
+	       color_formats == other.color_formats &&
+	       depth_format == other.depth_format;
+}
+
+size_t vkpg::PipelineState::Hash() const
+{
+	size_t result = 0;
+
+	HashCombine(result, vertex_shader);
+	HashCombine(result, fragment_shader);
+	HashCombine(result, task_shader);
+	HashCombine(result, mesh_shader);
+
+	for(const auto& binding : vertex_bindings)
+	{
+		HashCombine(result, binding.binding);
+		HashCombine(result, binding.stride);
+		HashCombine(result, binding.inputRate);
+	}
+
+	for(const auto& attribute : vertex_attributes)
+	{
+		HashCombine(result, attribute.location);
+		HashCombine(result, attribute.binding);
+		HashCombine(result, attribute.format);
+		HashCombine(result, attribute.offset);
+	}
+
+	HashCombine(result, topology);
+	HashCombine(result, polygon_mode);
+	HashCombine(result, cull_mode);
+	HashCombine(result, front_face);
+	HashCombine(result, depth_test);
+	HashCombine(result, depth_write);
+	HashCombine(result, depth_compare_op);
+	HashCombine(result, blend_enable);
+	HashCombine(result, src_color_blend_factor);
+	HashCombine(result, dst_color_blend_factor);
+	HashCombine(result, color_blend_op);
+	HashCombine(result, src_alpha_blend_factor);
+	HashCombine(result, dst_alpha_blend_factor);
+	HashCombine(result, alpha_blend_op);
+	HashCombine(result, color_attachment_count);
+	HashCombine(result, samples);
+	HashCombine(result, sample_shading);
+	HashCombine(result, min_sample_shading);
+	HashCombine(result, layout);
+	HashCombine(result, render_pass);
+	HashCombine(result, subpass);
+
+	for(auto format : color_formats)
+	{
+		HashCombine(result, format);
+	}
+	HashCombine(result, depth_format);
+
+	return result;
+}
+
+vkpg::PipelineCache::PipelineCache(VulkanDevice& vulkan_device, VkPipelineCache& pipeline_cache) :
+    vulkan_device(vulkan_device), pipeline_cache(pipeline_cache)
+{
+
+}
+
+void vkpg::PipelineCache::Cleanup()
+{
+	for(auto& [state, entry] : pipelines)
+	{
+		if(entry.pending.valid())
+		{
+			// A failed background compile has nothing to destroy
+			try
+			{
+				entry.pipeline = entry.pending.get();
+			}
+			catch(const std::exception&)
+			{
+			}
+		}
+
+		vkDestroyPipeline(vulkan_device.logical_device, entry.pipeline, nullptr);
+	}
+
+	pipelines.clear();
+
+	for(const auto& [key, pipeline] : compute_pipelines)
+	{
+		vkDestroyPipeline(vulkan_device.logical_device, pipeline, nullptr);
+	}
+
+	compute_pipelines.clear();
+
+	for(const auto& [filename, shader_module] : shader_modules)
+	{
+		vkDestroyShaderModule(vulkan_device.logical_device, shader_module, nullptr);
+	}
+
+	shader_modules.clear();
+}
+
+VkPipeline vkpg::PipelineCache::GetPipeline(const PipelineState& state)
+{
+	auto key = GetKey(state);
+	auto& entry = pipelines[key];
+
+	if(entry.pending.valid())
+	{
+		try
+		{
+			entry.pipeline = entry.pending.get();
+		}
+		catch(const std::exception& exception)
+		{
+			// Compiled again below, which throws if it fails on this thread too
+			std::cout << "Background pipeline compile failed, retrying: " << exception.what() << std::endl;
+		}
+		entry.pending = {};
+	}
+
+	if(entry.pipeline != VK_NULL_HANDLE)
+	{
+		hits++;
+		return entry.pipeline;
+	}
+
+	misses++;
+	entry.pipeline = CreatePipeline(key);
+	entry.failed = false;
+
+	return entry.pipeline;
+}
+
+VkPipeline vkpg::PipelineCache::RequestPipeline(const PipelineState& state)
+{
+	auto key = GetKey(state);
+	auto& entry = pipelines[key];
+
+	if(entry.pipeline != VK_NULL_HANDLE)
+	{
+		hits++;
+		return entry.pipeline;
+	}
+
+	if(entry.failed)
+	{
+		return VK_NULL_HANDLE;
+	}
+
+	if(!entry.pending.valid())
+	{
+		misses++;
+		entry.pending = std::async(std::launch::async, [this, key]()
+		{
+			return CreatePipeline(key);
+		}).share();
+	}
+
+	if(entry.pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+	{
+		try
+		{
+			entry.pipeline = entry.pending.get();
+		}
+		catch(const std::exception& exception)
+		{
+			std::cout << "Background pipeline compile failed: " << exception.what() << std::endl;
+			entry.failed = true;
+		}
+		entry.pending = {};
+	}
+
+	return entry.pipeline;
+}
+
+VkPipeline vkpg::PipelineCache::GetComputePipeline(const std::string& compute_shader, VkPipelineLayout layout)
+{
+	auto& pipeline = compute_pipelines[{compute_shader, layout}];
+	if(pipeline != VK_NULL_HANDLE)
+	{
+		hits++;
+		return pipeline;
+	}
+
+	misses++;
+
+	VkPipelineShaderStageCreateInfo shader_stage_info{};
+	shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	shader_stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	shader_stage_info.module = GetShaderModule(compute_shader);
+	shader_stage_info.pName = "main";
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage = shader_stage_info;
+	pipeline_info.layout = layout;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+	auto result = vkCreateComputePipelines(vulkan_device.logical_device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+	CheckVkResult(result, "Failed to create compute pipeline");
+
+	return pipeline;
+}
+
+void vkpg::PipelineCache::CmdSetDynamicState(VkCommandBuffer command_buffer, const PipelineState& state) const
+{
+	if(!vulkan_device.extended_dynamic_state_enabled)
+	{
+		return;
+	}
+
+	vulkan_device.cmd_set_cull_mode(command_buffer, state.cull_mode);
+	vulkan_device.cmd_set_front_face(command_buffer, state.front_face);
+	vulkan_device.cmd_set_depth_test_enable(command_buffer, state.depth_test ? VK_TRUE : VK_FALSE);
+	vulkan_device.cmd_set_depth_write_enable(command_buffer, state.depth_write ? VK_TRUE : VK_FALSE);
+	vulkan_device.cmd_set_depth_compare_op(command_buffer, state.depth_compare_op);
+}
+
+vkpg::PipelineState vkpg::PipelineCache::GetKey(const PipelineState& state) const
+{
+	if(!vulkan_device.extended_dynamic_state_enabled)
+	{
+		return state;
+	}
+
+	// Dynamic state doesn't affect the pipeline, reset it so materials differing only there share one
+	PipelineState key = state;
+	PipelineState defaults;
+	key.cull_mode = defaults.cull_mode;
+	key.front_face = defaults.front_face;
+	key.depth_test = defaults.depth_test;
+	key.depth_write = defaults.depth_write;
+	key.depth_compare_op = defaults.depth_compare_op;
+
+	return key;
+}
+
+VkPipeline vkpg::PipelineCache::CreatePipeline(const PipelineState& state)
+{
+	auto ShaderStage = [this](VkShaderStageFlagBits stage, const std::string& filename)
+	{
+		VkPipelineShaderStageCreateInfo shader_stage_info{};
+		shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		shader_stage_info.stage = stage;
+		shader_stage_info.module = GetShaderModule(filename);
+		shader_stage_info.pName = "main";
+		return shader_stage_info;
+	};
+
+	bool mesh_pipeline = !state.mesh_shader.empty();
+
+	std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+	if(mesh_pipeline)
+	{
+		if(!state.task_shader.empty())
+		{
+			shader_stages.push_back(ShaderStage(VK_SHADER_STAGE_TASK_BIT_EXT, state.task_shader));
+		}
+		shader_stages.push_back(ShaderStage(VK_SHADER_STAGE_MESH_BIT_EXT, state.mesh_shader));
+	}
+	else
+	{
+		shader_stages.push_back(ShaderStage(VK_SHADER_STAGE_VERTEX_BIT, state.vertex_shader));
+	}
+	shader_stages.push_back(ShaderStage(VK_SHADER_STAGE_FRAGMENT_BIT, state.fragment_shader));
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info{};
+	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+	vertex_input_info.vertexBindingDescriptionCount = static_cast<uint32_t>(state.vertex_bindings.size());
+	vertex_input_info.pVertexBindingDescriptions = state.vertex_bindings.data();
+	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(state.vertex_attributes.size());
+	vertex_input_info.pVertexAttributeDescriptions = state.vertex_attributes.data();
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly{};
+	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	input_assembly.topology = state.topology;
+	input_assembly.primitiveRestartEnable = VK_FALSE;
+
+	// Viewport and scissor are set when recording, so resizes and render scale changes keep the pipeline
+	VkPipelineViewportStateCreateInfo viewport_state{};
+	viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewport_state.viewportCount = 1;
+	viewport_state.pViewports = nullptr;
+	viewport_state.scissorCount = 1;
+	viewport_state.pScissors = nullptr;
+
+	std::vector<VkDynamicState> dynamic_states = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+
+	if(vulkan_device.extended_dynamic_state_enabled)
+	{
+		dynamic_states.insert(dynamic_states.end(),
+		{
+			VK_DYNAMIC_STATE_CULL_MODE_EXT,
+			VK_DYNAMIC_STATE_FRONT_FACE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT,
+			VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT
+		});
+	}
+
+	VkPipelineDynamicStateCreateInfo dynamic_state{};
+	dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+	dynamic_state.dynamicStateCount = static_cast<uint32_t>(dynamic_states.size());
+	dynamic_state.pDynamicStates = dynamic_states.data();
+
+	VkPipelineRasterizationStateCreateInfo rasterizer{};
+	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterizer.depthClampEnable = VK_FALSE;
+	rasterizer.rasterizerDiscardEnable = VK_FALSE;
+	rasterizer.polygonMode = state.polygon_mode;
+	rasterizer.lineWidth = 1.0f;
+	rasterizer.cullMode = state.cull_mode;
+	rasterizer.frontFace = state.front_face;
+	rasterizer.depthBiasEnable = VK_FALSE;
+
+	VkPipelineMultisampleStateCreateInfo multisampling{};
+	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	multisampling.sampleShadingEnable = state.sample_shading ? VK_TRUE : VK_FALSE;
+	multisampling.minSampleShading = state.min_sample_shading;
+	multisampling.rasterizationSamples = state.samples;
+
+	VkPipelineDepthStencilStateCreateInfo depth_stencil{};
+	depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+	depth_stencil.depthTestEnable = state.depth_test ? VK_TRUE : VK_FALSE;
+	depth_stencil.depthWriteEnable = state.depth_write ? VK_TRUE : VK_FALSE;
+	depth_stencil.depthCompareOp = state.depth_compare_op;
+	depth_stencil.depthBoundsTestEnable = VK_FALSE;
+	depth_stencil.stencilTestEnable = VK_FALSE;
+
+	VkPipelineColorBlendAttachmentState color_blend_attachment{};
+	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
+	                                        VK_COLOR_COMPONENT_G_BIT |
+	                                        VK_COLOR_COMPONENT_B_BIT |
+	                                        VK_COLOR_COMPONENT_A_BIT;
+	color_blend_attachment.blendEnable = state.blend_enable ? VK_TRUE : VK_FALSE;
+	color_blend_attachment.srcColorBlendFactor = state.src_color_blend_factor;
+	color_blend_attachment.dstColorBlendFactor = state.dst_color_blend_factor;
+	color_blend_attachment.colorBlendOp = state.color_blend_op;
+	color_blend_attachment.srcAlphaBlendFactor = state.src_alpha_blend_factor;
+	color_blend_attachment.dstAlphaBlendFactor = state.dst_alpha_blend_factor;
+	color_blend_attachment.alphaBlendOp = state.alpha_blend_op;
+
+	// Integer attachments can't be blended
+	VkPipelineColorBlendAttachmentState unblended_attachment = color_blend_attachment;
+	unblended_attachment.blendEnable = VK_FALSE;
+
+	std::vector<VkPipelineColorBlendAttachmentState> color_blend_attachments(std::max(state.color_attachment_count, 1u), unblended_attachment);
+	color_blend_attachments[0] = color_blend_attachment;
+
+	VkPipelineColorBlendStateCreateInfo color_blending{};
+	color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	color_blending.logicOpEnable = VK_FALSE;
+	color_blending.logicOp = VK_LOGIC_OP_COPY;
+	color_blending.attachmentCount = static_cast<uint32_t>(color_blend_attachments.size());
+	color_blending.pAttachments = color_blend_attachments.data();
+	color_blending.blendConstants[0] = 0.0f;
+	color_blending.blendConstants[1] = 0.0f;
+	color_blending.blendConstants[2] = 0.0f;
+	color_blending.blendConstants[3] = 0.0f;
+
+	// Dynamic rendering takes the attachment formats instead of a compatible render pass
+	VkPipelineRenderingCreateInfo rendering_info{};
+	rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+	rendering_info.colorAttachmentCount = static_cast<uint32_t>(state.color_formats.size());
+	rendering_info.pColorAttachmentFormats = state.color_formats.data();
+	rendering_info.depthAttachmentFormat = state.depth_format;
+	rendering_info.stencilAttachmentFormat = VK_FORMAT_UNDEFINED;
+
+	VkGraphicsPipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeline_info.pNext = state.render_pass == VK_NULL_HANDLE ? &rendering_info : nullptr;
+	pipeline_info.stageCount = static_cast<uint32_t>(shader_stages.size());
+	pipeline_info.pStages = shader_stages.data();
+	// Mesh shaders generate their primitives themselves
+	pipeline_info.pVertexInputState = mesh_pipeline ? nullptr : &vertex_input_info;
+	pipeline_info.pInputAssemblyState = mesh_pipeline ? nullptr : &input_assembly;
+	pipeline_info.pViewportState = &viewport_state;
+	pipeline_info.pRasterizationState = &rasterizer;
+	pipeline_info.pMultisampleState = &multisampling;
+	pipeline_info.pDepthStencilState = &depth_stencil;
+	pipeline_info.pColorBlendState = &color_blending;
+	pipeline_info.pDynamicState = &dynamic_state;
+	pipeline_info.layout = state.layout;
+	pipeline_info.renderPass = state.render_pass;
+	pipeline_info.subpass = state.subpass;
+	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+
+	// The VkPipelineCache is internally synchronized, so worker threads can share it
+	VkPipeline pipeline;
+	auto result = vkCreateGraphicsPipelines(vulkan_device.logical_device, pipeline_cache, 1, &pipeline_info, nullptr, &pipeline);
+	CheckVkResult(result, "Failed to create graphics pipeline");
+
+	return pipeline;
+}
+
+VkShaderModule vkpg::PipelineCache::GetShaderModule(const std::string& filename)
+{
+	std::lock_guard<std::mutex> lock(shader_modules_mutex);
+
+	auto it = shader_modules.find(filename);
+	if(it != shader_modules.end())
+	{
+		return it->second;
+	}
+
+	auto code = ReadFile(filename);
+
+	VkShaderModuleCreateInfo create_info{};
+	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+	create_info.codeSize = code.size();
+	create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
+
+	VkShaderModule shader_module;
+	auto result = vkCreateShaderModule(vulkan_device.logical_device, &create_info, nullptr, &shader_module);
+	CheckVkResult(result, "Failed to create shader module");
+
+	shader_modules.emplace(filename, shader_module);
+
+	return shader_module;
+}
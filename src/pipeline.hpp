@@ -0,0 +1,139 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace vkpg
+{
+
+// Everything that goes into a graphics pipeline, two equal states always share one VkPipeline.
+// Viewport and scissor are always dynamic; cull mode, front face and depth state are too when the
+// device has extended dynamic state, in which case they don't produce separate pipelines.
+// A mesh_shader (with an optional task_shader) replaces the vertex shader and the vertex input state.
+struct PipelineState
+{
+	std::string vertex_shader;
+	std::string fragment_shader;
+	std::string task_shader;
+	std::string mesh_shader;
+
+	std::vector<VkVertexInputBindingDescription> vertex_bindings;
+	std::vector<VkVertexInputAttributeDescription> vertex_attributes;
+	VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+	VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+	VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+	VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+
+	bool depth_test = true;
+	bool depth_write = true;
+	VkCompareOp depth_compare_op = VK_COMPARE_OP_LESS_OR_EQUAL;
+
+	bool blend_enable = false;
+	VkBlendFactor src_color_blend_factor = VK_BLEND_FACTOR_SRC_ALPHA;
+	VkBlendFactor dst_color_blend_factor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+	VkBlendOp color_blend_op = VK_BLEND_OP_ADD;
+	VkBlendFactor src_alpha_blend_factor = VK_BLEND_FACTOR_ONE;
+	VkBlendFactor dst_alpha_blend_factor = VK_BLEND_FACTOR_ZERO;
+	VkBlendOp alpha_blend_op = VK_BLEND_OP_ADD;
+	// The blend state applies to the first attachment, the others (e.g. object IDs) are written as is
+	uint32_t color_attachment_count = 1;
+
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	bool sample_shading = false;
+	float min_sample_shading = 0.0f;
+
+	VkPipelineLayout layout = VK_NULL_HANDLE;
+	VkRenderPass render_pass = VK_NULL_HANDLE;
+	uint32_t subpass = 0;
+	// Without a render pass the pipeline is used with dynamic rendering into attachments of these formats,
+	// the stencil aspect is never attached
+	std::vector<VkFormat> color_formats;
+	VkFormat depth_format = VK_FORMAT_UNDEFINED;
+
+	bool operator==(const PipelineState& other) const;
+	size_t Hash() const;
+};
+
+struct Material
+{
+	std::string name;
+	PipelineState pipeline_state;
+
+	// Index into the bindless texture table
+	uint32_t texture_index = 0;
+
+	// VK_NULL_HANDLE while it is still compiling in the background
+	VkPipeline pipeline = VK_NULL_HANDLE;
+};
+
+// Looks pipelines up by their full state and only builds new ones on a miss,
+// either right away or on a worker thread so that new permutations don't stall the frame
+class PipelineCache
+{
+public:
+	PipelineCache(vkpg::VulkanDevice& vulkan_device, VkPipelineCache& pipeline_cache);
+
+	// Waits for pending compiles and destroys all pipelines and shader modules
+	void Cleanup();
+
+	// Returns the pipeline for the state, compiling it on this thread if needed. A failed background
+	// compile of the same state is retried here, so its error is thrown to the caller.
+	VkPipeline GetPipeline(const PipelineState& state);
+
+	// Returns the pipeline if it is ready, otherwise starts (or keeps) compiling it in the background
+	// and returns VK_NULL_HANDLE so the caller can skip the draw or use a fallback. Has to be called
+	// again (e.g. every frame) until it returns a pipeline; a failed compile is logged once and keeps
+	// returning VK_NULL_HANDLE.
+	VkPipeline RequestPipeline(const PipelineState& state);
+
+	// Compute pipelines only depend on the shader and the layout, they are always compiled on this thread
+	VkPipeline GetComputePipeline(const std::string& compute_shader, VkPipelineLayout layout);
+
+	// Records the state that is dynamic on this device, viewport and scissor are left to the caller
+	void CmdSetDynamicState(VkCommandBuffer command_buffer, const PipelineState& state) const;
+
+	size_t hits = 0;
+	size_t misses = 0;
+
+private:
+	struct StateHash
+	{
+		size_t operator()(const PipelineState& state) const
+		{
+			return state.Hash();
+		}
+	};
+
+	struct Entry
+	{
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		std::shared_future<VkPipeline> pending;
+		bool failed = false;
+	};
+
+	PipelineState GetKey(const PipelineState& state) const;
+	VkPipeline CreatePipeline(const PipelineState& state);
+	VkShaderModule GetShaderModule(const std::string& filename);
+
+	vkpg::VulkanDevice& vulkan_device;
+	VkPipelineCache& pipeline_cache;
+
+	std::unordered_map<PipelineState, Entry, StateHash> pipelines;
+	std::map<std::pair<std::string, VkPipelineLayout>, VkPipeline> compute_pipelines;
+
+	std::mutex shader_modules_mutex;
+	std::unordered_map<std::string, VkShaderModule> shader_modules;
+};
+
+} // namespace vkpg
@@ -0,0 +1,179 @@
+#include "profiler.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+vkpg::GpuProfiler::GpuProfiler(VulkanDevice& vulkan_device) : vulkan_device(vulkan_device)
+{
+
+}
+
+void vkpg::GpuProfiler::Create(uint32_t frame_count)
+{
+	VkPhysicalDeviceProperties physical_device_properties;
+	vkGetPhysicalDeviceProperties(vulkan_device.physical_device, &physical_device_properties);
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(vulkan_device.physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(vulkan_device.physical_device, &queue_family_count, queue_families.data());
+
+	auto valid_bits = queue_families[vulkan_device.queue_family_indices.graphics_family.value()].timestampValidBits;
+
+	supported = valid_bits > 0 && physical_device_properties.limits.timestampPeriod > 0.0f;
+	timestamp_period = physical_device_properties.limits.timestampPeriod;
+	timestamp_mask = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+	frames.clear();
+	frames.resize(frame_count);
+	pass_times.clear();
+	frame_time = 0.0;
+
+	if(!supported)
+	{
+		std::cout << "GPU profiler: timestamps are not supported on the graphics queue" << std::endl;
+		return;
+	}
+
+	VkQueryPoolCreateInfo query_pool_info{};
+	query_pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	query_pool_info.queryCount = max_queries_per_frame * frame_count;
+
+	auto result = vkCreateQueryPool(vulkan_device.logical_device, &query_pool_info, nullptr, &query_pool);
+	CheckVkResult(result, "Failed to create timestamp query pool");
+}
+
+void vkpg::GpuProfiler::Cleanup()
+{
+	vkDestroyQueryPool(vulkan_device.logical_device, query_pool, nullptr);
+	query_pool = VK_NULL_HANDLE;
+	frames.clear();
+}
+
+bool vkpg::GpuProfiler::IsSupported() const
+{
+	return supported;
+}
+
+void vkpg::GpuProfiler::BeginFrame(VkCommandBuffer command_buffer, uint32_t frame_index)
+{
+	current_frame = frame_index;
+
+	auto& frame = frames[frame_index];
+	frame.passes.clear();
+	frame.open_passes.clear();
+	frame.query_count = 0;
+
+	if(!supported)
+	{
+		return;
+	}
+
+	vulkan_device.dispatch.cmd_reset_query_pool(command_buffer, query_pool, frame_index * max_queries_per_frame, max_queries_per_frame);
+}
+
+void vkpg::GpuProfiler::BeginPass(VkCommandBuffer command_buffer, const std::string& name)
+{
+	if(!supported)
+	{
+		return;
+	}
+
+	auto& frame = frames[current_frame];
+
+	Pass pass;
+	pass.name = name;
+	pass.begin_query = NextQuery(frame);
+	vulkan_device.dispatch.cmd_write_timestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, pass.begin_query);
+
+	frame.open_passes.push_back(frame.passes.size());
+	frame.passes.push_back(pass);
+}
+
+void vkpg::GpuProfiler::EndPass(VkCommandBuffer command_buffer)
+{
+	if(!supported)
+	{
+		return;
+	}
+
+	auto& frame = frames[current_frame];
+	if(frame.open_passes.empty())
+	{
+		Error("EndPass without a matching BeginPass");
+	}
+
+	auto& pass = frame.passes[frame.open_passes.back()];
+	frame.open_passes.pop_back();
+
+	pass.end_query = NextQuery(frame);
+	vulkan_device.dispatch.cmd_write_timestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, pass.end_query);
+}
+
+void vkpg::GpuProfiler::CollectResults(uint32_t frame_index)
+{
+	auto& frame = frames[frame_index];
+	if(!supported || frame.query_count == 0)
+	{
+		return;
+	}
+
+	std::vector<uint64_t> timestamps(frame.query_count);
+	auto result = vulkan_device.dispatch.get_query_pool_results(vulkan_device.logical_device, query_pool, frame_index * max_queries_per_frame,
+	                                    frame.query_count, timestamps.size() * sizeof(uint64_t), timestamps.data(),
+	                                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+
+	// The frame has not been submitted yet (e.g. it was recorded right before a swap chain recreation)
+	if(result == VK_NOT_READY)
+	{
+		return;
+	}
+	CheckVkResult(result, "Failed to read timestamp queries");
+
+	auto ToMilliseconds = [this](uint64_t begin, uint64_t end)
+	{
+		return static_cast<double>((end - begin) & timestamp_mask) * timestamp_period / 1000000.0;
+	};
+
+	pass_times.clear();
+
+	uint64_t first = UINT64_MAX;
+	uint64_t last = 0;
+	for(const auto& pass : frame.passes)
+	{
+		auto begin = timestamps[pass.begin_query - frame_index * max_queries_per_frame] & timestamp_mask;
+		auto end = timestamps[pass.end_query - frame_index * max_queries_per_frame] & timestamp_mask;
+
+		pass_times.push_back({pass.name, ToMilliseconds(begin, end)});
+
+		first = std::min(first, begin);
+		last = std::max(last, end);
+	}
+
+	frame_time = frame.passes.empty() ? 0.0 : ToMilliseconds(first, last);
+
+	frame.passes.clear();
+	frame.query_count = 0;
+}
+
+double vkpg::GpuProfiler::GetPassTime(const std::string& name) const
+{
+	auto it = std::find_if(pass_times.begin(), pass_times.end(), [&name](const auto& pass_time)
+	{
+		return pass_time.name == name;
+	});
+
+	return it != pass_times.end() ? it->milliseconds : 0.0;
+}
+
+uint32_t vkpg::GpuProfiler::NextQuery(Frame& frame)
+{
+	if(frame.query_count >= max_queries_per_frame)
+	{
+		Error("Too many profiled passes in one frame");
+	}
+
+	return current_frame * max_queries_per_frame + frame.query_count++;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "device.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+namespace vkpg
+{
+
+// Measures GPU time of named passes with timestamp queries. Every swap chain image owns a range of queries
+// that is read back once the image's previous frame has finished, so reading results never stalls.
+class GpuProfiler
+{
+public:
+	struct PassTime
+	{
+		std::string name;
+		double milliseconds = 0.0;
+	};
+
+	explicit GpuProfiler(vkpg::VulkanDevice& vulkan_device);
+
+	void Create(uint32_t frame_count);
+	void Cleanup();
+
+	bool IsSupported() const;
+
+	// Resets the queries of the frame, has to be recorded outside of a render pass before any BeginPass
+	void BeginFrame(VkCommandBuffer command_buffer, uint32_t frame_index);
+	void BeginPass(VkCommandBuffer command_buffer, const std::string& name);
+	void EndPass(VkCommandBuffer command_buffer);
+
+	// Reads the timestamps of the frame's previous submission, call after its fence has been waited on
+	void CollectResults(uint32_t frame_index);
+
+	// 0 if the pass was not measured in the last collected frame
+	double GetPassTime(const std::string& name) const;
+
+	// Results of the last collected frame, frame_time spans from the first to the last timestamp
+	std::vector<PassTime> pass_times;
+	double frame_time = 0.0;
+
+private:
+	static constexpr uint32_t max_queries_per_frame = 64;
+
+	struct Pass
+	{
+		std::string name;
+		uint32_t begin_query = 0;
+		uint32_t end_query = 0;
+	};
+
+	struct Frame
+	{
+		std::vector<Pass> passes;
+		std::vector<size_t> open_passes;
+		uint32_t query_count = 0;
+	};
+
+	uint32_t NextQuery(Frame& frame);
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	VkQueryPool query_pool{VK_NULL_HANDLE};
+	std::vector<Frame> frames;
+	uint32_t current_frame = 0;
+
+	bool supported = false;
+	double timestamp_period = 1.0;
+	uint64_t timestamp_mask = ~0ull;
+};
+
+} // namespace vkpg
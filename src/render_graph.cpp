@@ -0,0 +1,566 @@
+#include "render_graph.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+
+namespace
+{
+
+constexpr VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+                                       VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+
+} // namespace
+
+vkpg::RenderGraph::RenderGraph(VulkanDevice& vulkan_device) : vulkan_device(vulkan_device)
+{
+
+}
+
+void vkpg::RenderGraph::Cleanup()
+{
+	for(auto& resource : resources)
+	{
+		if(!resource.imported)
+		{
+			vkDestroyImageView(vulkan_device.logical_device, resource.view, nullptr);
+			vkDestroyImage(vulkan_device.logical_device, resource.image, nullptr);
+		}
+	}
+
+	vkFreeMemory(vulkan_device.logical_device, memory, nullptr);
+	memory = VK_NULL_HANDLE;
+
+	passes.clear();
+	resources.clear();
+	final_barriers.clear();
+	transient_size = 0;
+	allocated_size = 0;
+}
+
+vkpg::RenderGraph::Resource vkpg::RenderGraph::CreateImage(const std::string& name, const ImageInfo& info)
+{
+	ResourceData resource;
+	resource.name = name;
+	resource.info = info;
+	resources.push_back(resource);
+
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+vkpg::RenderGraph::Resource vkpg::RenderGraph::ImportImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+                                                           const ImageState& initial_state, std::optional<ImageState> final_state)
+{
+	ResourceData resource;
+	resource.name = name;
+	resource.imported = true;
+	resource.info.aspect = aspect;
+	resource.image = image;
+	resource.view = view;
+	resource.initial_state = initial_state;
+	resource.final_state = final_state;
+	resources.push_back(resource);
+
+	return static_cast<Resource>(resources.size() - 1);
+}
+
+vkpg::RenderGraph::Resource vkpg::RenderGraph::ImportImageLevel(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t level,
+                                                                const ImageState& initial_state, std::optional<ImageState> final_state)
+{
+	auto resource = ImportImage(name, image, VK_NULL_HANDLE, aspect, initial_state, final_state);
+	resources[resource].base_mip_level = level;
+	resources[resource].mip_level_count = 1;
+
+	return resource;
+}
+
+void vkpg::RenderGraph::SetImportedImage(Resource resource, VkImage image, VkImageView view)
+{
+	if(!resources[resource].imported)
+	{
+		Error("Render graph image " + resources[resource].name + " is not imported");
+	}
+
+	resources[resource].image = image;
+	resources[resource].view = view;
+}
+
+vkpg::RenderGraph::Pass vkpg::RenderGraph::AddPass(const std::string& name, VkPipelineStageFlags shader_stages,
+                                                   std::function<void(VkCommandBuffer)> record)
+{
+	PassData pass;
+	pass.name = name;
+	pass.shader_stages = shader_stages;
+	pass.record = std::move(record);
+	passes.push_back(std::move(pass));
+
+	return static_cast<Pass>(passes.size() - 1);
+}
+
+void vkpg::RenderGraph::Read(Pass pass, Resource resource, ImageUsage usage)
+{
+	passes[pass].accesses.push_back({resource, usage, false});
+}
+
+void vkpg::RenderGraph::Write(Pass pass, Resource resource, ImageUsage usage)
+{
+	passes[pass].accesses.push_back({resource, usage, true});
+}
+
+void vkpg::RenderGraph::SetSideEffects(Pass pass)
+{
+	passes[pass].side_effects = true;
+}
+
+void vkpg::RenderGraph::Compile()
+{
+	CullPasses();
+	AllocateImages();
+	PlanBarriers();
+}
+
+void vkpg::RenderGraph::Execute(VkCommandBuffer command_buffer, GpuProfiler *profiler)
+{
+	for(const auto& pass : passes)
+	{
+		if(pass.culled)
+		{
+			continue;
+		}
+
+		RecordBarriers(command_buffer, pass.barriers);
+
+		if(profiler)
+		{
+			profiler->BeginPass(command_buffer, pass.name);
+		}
+		pass.record(command_buffer);
+		if(profiler)
+		{
+			profiler->EndPass(command_buffer);
+		}
+	}
+
+	RecordBarriers(command_buffer, final_barriers);
+}
+
+VkImage vkpg::RenderGraph::GetImage(Resource resource) const
+{
+	return resources[resource].image;
+}
+
+VkImageView vkpg::RenderGraph::GetImageView(Resource resource) const
+{
+	return resources[resource].view;
+}
+
+bool vkpg::RenderGraph::IsCulled(Pass pass) const
+{
+	return passes[pass].culled;
+}
+
+VkDeviceSize vkpg::RenderGraph::GetTransientSize() const
+{
+	return transient_size;
+}
+
+VkDeviceSize vkpg::RenderGraph::GetAllocatedSize() const
+{
+	return allocated_size;
+}
+
+vkpg::ImageState vkpg::RenderGraph::GetUsageState(const PassData& pass, const Access& access) const
+{
+	switch(access.usage)
+	{
+	case ImageUsage::ColorAttachment:
+		return {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		        VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | (access.write ? VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT : 0u)};
+	case ImageUsage::DepthAttachment:
+		return {access.write ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL,
+		        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | (access.write ? VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT : 0u)};
+	case ImageUsage::Sampled:
+		return {VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, pass.shader_stages, VK_ACCESS_SHADER_READ_BIT};
+	case ImageUsage::StorageRead:
+		return {VK_IMAGE_LAYOUT_GENERAL, pass.shader_stages, VK_ACCESS_SHADER_READ_BIT};
+	case ImageUsage::StorageWrite:
+		return {VK_IMAGE_LAYOUT_GENERAL, pass.shader_stages, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT};
+	case ImageUsage::TransferSource:
+		return {VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT};
+	case ImageUsage::TransferDestination:
+		return {VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT};
+	}
+
+	return {};
+}
+
+void vkpg::RenderGraph::CullPasses()
+{
+	// Backwards from the passes that leave results outside the graph, keeping whatever they read from
+	std::vector<bool> needed(resources.size(), false);
+
+	for(size_t i = passes.size(); i-- > 0;)
+	{
+		auto& pass = passes[i];
+
+		bool alive = pass.side_effects;
+		for(const auto& access : pass.accesses)
+		{
+			if(access.write && (resources[access.resource].imported || needed[access.resource]))
+			{
+				alive = true;
+			}
+		}
+
+		pass.culled = !alive;
+		if(!alive)
+		{
+			continue;
+		}
+
+		for(const auto& access : pass.accesses)
+		{
+			if(!access.write)
+			{
+				needed[access.resource] = true;
+			}
+		}
+	}
+
+	for(size_t i = 0; i < passes.size(); i++)
+	{
+		if(passes[i].culled)
+		{
+			continue;
+		}
+
+		for(const auto& access : passes[i].accesses)
+		{
+			auto& resource = resources[access.resource];
+			if(!resource.first_pass)
+			{
+				resource.first_pass = i;
+			}
+			resource.last_pass = i;
+
+			switch(access.usage)
+			{
+			case ImageUsage::ColorAttachment: resource.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT; break;
+			case ImageUsage::DepthAttachment: resource.usage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT; break;
+			case ImageUsage::Sampled: resource.usage |= VK_IMAGE_USAGE_SAMPLED_BIT; break;
+			case ImageUsage::StorageRead:
+			case ImageUsage::StorageWrite: resource.usage |= VK_IMAGE_USAGE_STORAGE_BIT; break;
+			case ImageUsage::TransferSource: resource.usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT; break;
+			case ImageUsage::TransferDestination: resource.usage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT; break;
+			}
+		}
+	}
+}
+
+void vkpg::RenderGraph::AllocateImages()
+{
+	std::vector<Resource> transients;
+	uint32_t memory_type_bits = ~0u;
+
+	for(Resource i = 0; i < resources.size(); i++)
+	{
+		auto& resource = resources[i];
+		if(resource.imported || !resource.first_pass)
+		{
+			continue;
+		}
+
+		VkImageCreateInfo image_info{};
+		image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		image_info.imageType = VK_IMAGE_TYPE_2D;
+		image_info.extent.width = resource.info.extent.width;
+		image_info.extent.height = resource.info.extent.height;
+		image_info.extent.depth = 1;
+		image_info.mipLevels = 1;
+		image_info.arrayLayers = 1;
+		image_info.format = resource.info.format;
+		image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image_info.usage = resource.usage;
+		image_info.samples = resource.info.samples;
+		image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		auto result = vkCreateImage(vulkan_device.logical_device, &image_info, nullptr, &resource.image);
+		CheckVkResult(result, "Failed to create render graph image " + resource.name);
+
+		vkGetImageMemoryRequirements(vulkan_device.logical_device, resource.image, &resource.memory_requirements);
+		memory_type_bits &= resource.memory_requirements.memoryTypeBits;
+		transient_size += resource.memory_requirements.size;
+
+		transients.push_back(i);
+	}
+
+	if(transients.empty())
+	{
+		return;
+	}
+
+	// Largest first, each goes to the lowest offset that no image alive at the same time covers
+	std::sort(transients.begin(), transients.end(), [this](Resource a, Resource b)
+	{
+		return resources[a].memory_requirements.size > resources[b].memory_requirements.size;
+	});
+
+	std::vector<Resource> placed;
+	for(auto i : transients)
+	{
+		auto& resource = resources[i];
+		auto size = resource.memory_requirements.size;
+		auto alignment = resource.memory_requirements.alignment;
+
+		auto Overlaps = [&](const ResourceData& other)
+		{
+			return *other.first_pass <= resource.last_pass && *resource.first_pass <= other.last_pass;
+		};
+
+		std::vector<VkDeviceSize> candidates{0};
+		for(auto other : placed)
+		{
+			if(Overlaps(resources[other]))
+			{
+				auto end = resources[other].memory_offset + resources[other].memory_requirements.size;
+				candidates.push_back((end + alignment - 1) / alignment * alignment);
+			}
+		}
+		std::sort(candidates.begin(), candidates.end());
+
+		for(auto offset : candidates)
+		{
+			bool free = std::none_of(placed.begin(), placed.end(), [&](Resource other)
+			{
+				const auto& data = resources[other];
+				return Overlaps(data) && offset < data.memory_offset + data.memory_requirements.size &&
+				       data.memory_offset < offset + size;
+			});
+
+			if(free)
+			{
+				resource.memory_offset = offset;
+				break;
+			}
+		}
+
+		allocated_size = std::max(allocated_size, resource.memory_offset + size);
+		placed.push_back(i);
+	}
+
+	if(memory_type_bits == 0)
+	{
+		Error("Render graph images have no memory type in common");
+	}
+
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = allocated_size;
+	alloc_info.memoryTypeIndex = vulkan_device.FindMemoryType(memory_type_bits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+	auto result = vkAllocateMemory(vulkan_device.logical_device, &alloc_info, nullptr, &memory);
+	CheckVkResult(result, "Failed to allocate render graph memory");
+
+	for(auto i : transients)
+	{
+		auto& resource = resources[i];
+
+		result = vkBindImageMemory(vulkan_device.logical_device, resource.image, memory, resource.memory_offset);
+		CheckVkResult(result, "Failed to bind render graph image " + resource.name);
+
+		VkImageViewCreateInfo view_info{};
+		view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		view_info.image = resource.image;
+		view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		view_info.format = resource.info.format;
+		view_info.subresourceRange.aspectMask = resource.info.aspect;
+		view_info.subresourceRange.baseMipLevel = 0;
+		view_info.subresourceRange.levelCount = 1;
+		view_info.subresourceRange.baseArrayLayer = 0;
+		view_info.subresourceRange.layerCount = 1;
+
+		result = vkCreateImageView(vulkan_device.logical_device, &view_info, nullptr, &resource.view);
+		CheckVkResult(result, "Failed to create render graph image view " + resource.name);
+	}
+}
+
+void vkpg::RenderGraph::PlanBarriers()
+{
+	std::vector<ImageState> states(resources.size());
+	for(size_t i = 0; i < resources.size(); i++)
+	{
+		states[i] = resources[i].initial_state;
+	}
+
+	auto SharesMemory = [this](const ResourceData& a, const ResourceData& b)
+	{
+		return a.memory_offset < b.memory_offset + b.memory_requirements.size &&
+		       b.memory_offset < a.memory_offset + a.memory_requirements.size;
+	};
+
+	for(size_t i = 0; i < passes.size(); i++)
+	{
+		auto& pass = passes[i];
+		pass.barriers.clear();
+		if(pass.culled)
+		{
+			continue;
+		}
+
+		for(const auto& access : pass.accesses)
+		{
+			auto& resource = resources[access.resource];
+			auto& state = states[access.resource];
+			auto target = GetUsageState(pass, access);
+
+			if(!resource.imported && resource.first_pass == i)
+			{
+				// Whatever was in the memory before is discarded, but the images it belonged to have to be done with it
+				state = {};
+				for(const auto& other : resources)
+				{
+					if(&other != &resource && !other.imported && other.first_pass && other.last_pass < i && SharesMemory(resource, other))
+					{
+						auto other_state = states[&other - resources.data()];
+						state.stages |= other_state.stages;
+						state.access |= other_state.access & WRITE_ACCESS;
+					}
+				}
+			}
+
+			bool previous_write = state.access & WRITE_ACCESS;
+			if(state.layout == target.layout && !previous_write && !access.write)
+			{
+				// Reads after reads only need to be waited for by the next write
+				state.stages |= target.stages;
+				state.access |= target.access;
+				continue;
+			}
+
+			pass.barriers.push_back({access.resource, state, target});
+			state = target;
+		}
+	}
+
+	// The memory is reused by the next frame, whose first use of it has to wait for this frame's last ones
+	for(Resource i = 0; i < resources.size(); i++)
+	{
+		const auto& resource = resources[i];
+		if(resource.imported || !resource.first_pass)
+		{
+			continue;
+		}
+
+		for(auto& barrier : passes[*resource.first_pass].barriers)
+		{
+			if(barrier.resource != i)
+			{
+				continue;
+			}
+
+			for(Resource j = 0; j < resources.size(); j++)
+			{
+				if(!resources[j].imported && resources[j].first_pass && SharesMemory(resource, resources[j]))
+				{
+					barrier.source.stages |= states[j].stages;
+				}
+			}
+			break;
+		}
+	}
+
+	final_barriers.clear();
+	for(Resource i = 0; i < resources.size(); i++)
+	{
+		const auto& final_state = resources[i].final_state;
+		if(final_state && (states[i].layout != final_state->layout || states[i].access != 0))
+		{
+			final_barriers.push_back({i, states[i], *final_state});
+		}
+	}
+}
+
+void vkpg::RenderGraph::RecordBarriers(VkCommandBuffer command_buffer, const std::vector<Barrier>& barriers) const
+{
+	if(barriers.empty())
+	{
+		return;
+	}
+
+	if(vulkan_device.synchronization2_enabled)
+	{
+		// Every image waits for exactly its own stages
+		std::vector<VkImageMemoryBarrier2> image_barriers;
+		image_barriers.reserve(barriers.size());
+
+		for(const auto& barrier : barriers)
+		{
+			const auto& resource = resources[barrier.resource];
+
+			VkImageMemoryBarrier2 image_barrier{};
+			image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+			image_barrier.srcStageMask = barrier.source.stages;
+			image_barrier.srcAccessMask = barrier.source.access & WRITE_ACCESS;
+			image_barrier.dstStageMask = barrier.destination.stages;
+			image_barrier.dstAccessMask = barrier.destination.access;
+			image_barrier.oldLayout = barrier.source.layout;
+			image_barrier.newLayout = barrier.destination.layout;
+			image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			image_barrier.image = resource.image;
+			image_barrier.subresourceRange.aspectMask = resource.info.aspect;
+			image_barrier.subresourceRange.baseMipLevel = resource.base_mip_level;
+			image_barrier.subresourceRange.levelCount = resource.mip_level_count;
+			image_barrier.subresourceRange.baseArrayLayer = 0;
+			image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+			image_barriers.push_back(image_barrier);
+		}
+
+		VkDependencyInfo dependency_info{};
+		dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+		dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(image_barriers.size());
+		dependency_info.pImageMemoryBarriers = image_barriers.data();
+
+		vulkan_device.cmd_pipeline_barrier2(command_buffer, &dependency_info);
+		return;
+	}
+
+	std::vector<VkImageMemoryBarrier> image_barriers;
+	image_barriers.reserve(barriers.size());
+
+	VkPipelineStageFlags source_stages = 0;
+	VkPipelineStageFlags destination_stages = 0;
+
+	for(const auto& barrier : barriers)
+	{
+		const auto& resource = resources[barrier.resource];
+
+		VkImageMemoryBarrier image_barrier{};
+		image_barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		image_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		image_barrier.image = resource.image;
+		image_barrier.subresourceRange.aspectMask = resource.info.aspect;
+		image_barrier.subresourceRange.baseMipLevel = resource.base_mip_level;
+		image_barrier.subresourceRange.levelCount = resource.mip_level_count;
+		image_barrier.subresourceRange.baseArrayLayer = 0;
+		image_barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+		image_barrier.oldLayout = barrier.source.layout;
+		image_barrier.newLayout = barrier.destination.layout;
+		// Only writes have to be made available, reads just have to be finished
+		image_barrier.srcAccessMask = barrier.source.access & WRITE_ACCESS;
+		image_barrier.dstAccessMask = barrier.destination.access;
+		image_barriers.push_back(image_barrier);
+
+		source_stages |= barrier.source.stages;
+		destination_stages |= barrier.destination.stages;
+	}
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer,
+	                     source_stages ? source_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+	                     destination_stages ? destination_stages : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+	                     0, nullptr,
+	                     0, nullptr,
+	                     static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+}
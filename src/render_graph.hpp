@@ -0,0 +1,166 @@
+#pragma once
+
+#include "device.hpp"
+#include "profiler.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace vkpg
+{
+
+// How a pass touches an image, decides its layout and the stages and accesses a barrier waits on
+enum class ImageUsage
+{
+	ColorAttachment,
+	DepthAttachment,
+	Sampled,
+	StorageRead,
+	StorageWrite,
+	TransferSource,
+	TransferDestination
+};
+
+// Layout and last access of an image at the start or end of the graph
+struct ImageState
+{
+	VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	VkAccessFlags access = 0;
+};
+
+// Passes declare the images they read and write, the graph orders nothing itself: passes run in the order they
+// were added, minus the ones whose results nobody uses. From the declarations it records the barriers between
+// passes and places graph owned images whose lifetimes don't overlap in the same memory.
+//
+// Declare, Compile() once (it allocates the graph owned images), then Execute() every frame. Imported images can
+// be swapped between frames with SetImportedImage, their states are part of the compiled plan.
+class RenderGraph
+{
+public:
+	using Resource = uint32_t;
+	using Pass = uint32_t;
+
+	struct ImageInfo
+	{
+		VkFormat format = VK_FORMAT_UNDEFINED;
+		VkExtent2D extent{};
+		VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+		VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	};
+
+	explicit RenderGraph(vkpg::VulkanDevice& vulkan_device);
+
+	// Destroys the graph owned images and forgets all declarations
+	void Cleanup();
+
+	// Only lives inside a frame, its contents are undefined before the first pass that writes it
+	Resource CreateImage(const std::string& name, const ImageInfo& info);
+	// An image from outside, e.g. a swap chain image. Passes writing it are never culled. Without a final state the
+	// image is left as the last pass used it.
+	Resource ImportImage(const std::string& name, VkImage image, VkImageView view, VkImageAspectFlags aspect,
+	                     const vkpg::ImageState& initial_state, std::optional<vkpg::ImageState> final_state = std::nullopt);
+	// A single mip level of an imported image, so passes can read one level while writing the next
+	Resource ImportImageLevel(const std::string& name, VkImage image, VkImageAspectFlags aspect, uint32_t level,
+	                          const vkpg::ImageState& initial_state, std::optional<vkpg::ImageState> final_state = std::nullopt);
+	void SetImportedImage(Resource resource, VkImage image, VkImageView view);
+
+	// The stage decides where shader accesses happen, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT or the graphics stages
+	Pass AddPass(const std::string& name, VkPipelineStageFlags shader_stages, std::function<void(VkCommandBuffer)> record);
+	void Read(Pass pass, Resource resource, vkpg::ImageUsage usage);
+	void Write(Pass pass, Resource resource, vkpg::ImageUsage usage);
+	// Keeps a pass whose results leave the graph some other way, e.g. through a host visible buffer
+	void SetSideEffects(Pass pass);
+
+	void Compile();
+	// Each pass is timed with the profiler when one is given
+	void Execute(VkCommandBuffer command_buffer, vkpg::GpuProfiler *profiler = nullptr);
+
+	VkImage GetImage(Resource resource) const;
+	VkImageView GetImageView(Resource resource) const;
+
+	bool IsCulled(Pass pass) const;
+
+	// Graph owned image memory before and after aliasing
+	VkDeviceSize GetTransientSize() const;
+	VkDeviceSize GetAllocatedSize() const;
+
+private:
+	struct Access
+	{
+		Resource resource = 0;
+		vkpg::ImageUsage usage = vkpg::ImageUsage::Sampled;
+		bool write = false;
+	};
+
+	struct Barrier
+	{
+		Resource resource = 0;
+		vkpg::ImageState source;
+		vkpg::ImageState destination;
+	};
+
+	struct PassData
+	{
+		std::string name;
+		VkPipelineStageFlags shader_stages = 0;
+		std::function<void(VkCommandBuffer)> record;
+		std::vector<Access> accesses;
+		bool side_effects = false;
+		bool culled = false;
+
+		// Recorded before the pass
+		std::vector<Barrier> barriers;
+	};
+
+	struct ResourceData
+	{
+		std::string name;
+		bool imported = false;
+		ImageInfo info;
+		VkImageUsageFlags usage = 0;
+
+		VkImage image{VK_NULL_HANDLE};
+		VkImageView view{VK_NULL_HANDLE};
+		// Barriers cover every level unless only one was imported
+		uint32_t base_mip_level = 0;
+		uint32_t mip_level_count = VK_REMAINING_MIP_LEVELS;
+
+		vkpg::ImageState initial_state;
+		std::optional<vkpg::ImageState> final_state;
+
+		// Alive passes using it, for graph owned images
+		std::optional<size_t> first_pass;
+		size_t last_pass = 0;
+
+		VkDeviceSize memory_offset = 0;
+		VkMemoryRequirements memory_requirements{};
+	};
+
+	vkpg::ImageState GetUsageState(const PassData& pass, const Access& access) const;
+
+	void CullPasses();
+	void PlanBarriers();
+	void AllocateImages();
+
+	void RecordBarriers(VkCommandBuffer command_buffer, const std::vector<Barrier>& barriers) const;
+
+	vkpg::VulkanDevice& vulkan_device;
+
+	std::vector<PassData> passes;
+	std::vector<ResourceData> resources;
+	// Recorded after the last pass, moves imported images into their final states
+	std::vector<Barrier> final_barriers;
+
+	// One block for every graph owned image, sub-allocated by lifetime
+	VkDeviceMemory memory{VK_NULL_HANDLE};
+	VkDeviceSize transient_size = 0;
+	VkDeviceSize allocated_size = 0;
+};
+
+} // namespace vkpg
@@ -0,0 +1,34 @@
+#include "resolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+float vkpg::DynamicResolution::Update(double gpu_frame_time)
+{
+	if(gpu_frame_time <= 0.0)
+	{
+		return scale;
+	}
+
+	// Smooth out single slow frames so the scale doesn't oscillate
+	filtered_frame_time = filtered_frame_time == 0.0 ? gpu_frame_time : filtered_frame_time * 0.9 + gpu_frame_time * 0.1;
+
+	// GPU time grows roughly with the pixel count, i.e. with the scale squared
+	constexpr double headroom = 0.95;
+	double desired_scale = scale * std::sqrt(target_frame_time * headroom / filtered_frame_time);
+
+	// Only move part of the way each frame and ignore changes too small to matter
+	double next_scale = std::clamp(scale + (desired_scale - scale) * 0.25, static_cast<double>(min_scale), static_cast<double>(max_scale));
+	if(std::abs(next_scale - scale) >= 0.01)
+	{
+		scale = static_cast<float>(next_scale);
+	}
+
+	return scale;
+}
+
+void vkpg::DynamicResolution::Reset()
+{
+	scale = max_scale;
+	filtered_frame_time = 0.0;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+namespace vkpg
+{
+
+// Picks the scene render scale from measured GPU time, so the scene pass stays inside its budget
+class DynamicResolution
+{
+public:
+	// GPU budget of the scene pass in milliseconds, a little headroom is kept below it
+	float target_frame_time = 14.0f;
+
+	float min_scale = 0.5f;
+	float max_scale = 1.0f;
+
+	float scale = 1.0f;
+
+	// Feeds the scene GPU time of the last finished frame and returns the new scale
+	float Update(double gpu_frame_time);
+
+	void Reset();
+
+private:
+	double filtered_frame_time = 0.0;
+};
+
+} // namespace vkpg
@@ -0,0 +1,318 @@
+#include "scene.hpp"
+
+#include <algorithm>
+#include <barrier>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+
+glm::mat4 ComposeTransform(const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	auto basis = glm::mat3_cast(rotation);
+
+	glm::mat4 transform(1.0f);
+	transform[0] = glm::vec4(basis[0] * scale.x, 0.0f);
+	transform[1] = glm::vec4(basis[1] * scale.y, 0.0f);
+	transform[2] = glm::vec4(basis[2] * scale.z, 0.0f);
+	transform[3] = glm::vec4(position, 1.0f);
+
+	return transform;
+}
+
+// Both matrices are affine, so the bottom row is known and a quarter of a full multiply can be skipped
+glm::mat4 MultiplyAffine(const glm::mat4& a, const glm::mat4& b)
+{
+	glm::mat3 basis(a);
+
+	glm::mat4 result;
+	result[0] = glm::vec4(basis * glm::vec3(b[0]), 0.0f);
+	result[1] = glm::vec4(basis * glm::vec3(b[1]), 0.0f);
+	result[2] = glm::vec4(basis * glm::vec3(b[2]), 0.0f);
+	result[3] = glm::vec4(basis * glm::vec3(b[3]) + glm::vec3(a[3]), 1.0f);
+
+	return result;
+}
+
+} // namespace
+
+vkpg::Scene::Scene(uint32_t max_thread_count) : max_thread_count(std::max(max_thread_count, 1u))
+{
+
+}
+
+vkpg::Scene::~Scene()
+{
+	{
+		std::lock_guard lock(worker_mutex);
+		stopping = true;
+	}
+	worker_condition.notify_all();
+
+	for(auto& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+uint32_t vkpg::Scene::AddNode(uint32_t parent, const glm::vec3& position, const glm::quat& rotation, const glm::vec3& scale)
+{
+	if(parent != NO_PARENT_NODE && parent >= parents.size())
+	{
+		throw std::invalid_argument("Scene node parent does not exist");
+	}
+
+	auto node = static_cast<uint32_t>(parents.size());
+
+	parents.push_back(parent);
+	depths.push_back(parent == NO_PARENT_NODE ? 0 : depths[parent] + 1);
+	positions.push_back(position);
+	rotations.push_back(rotation);
+	scales.push_back(scale);
+	world_matrices.emplace_back(1.0f);
+	dirty.push_back(0);
+
+	MarkDirty(node);
+	levels_valid = false;
+
+	return node;
+}
+
+void vkpg::Scene::SetPosition(uint32_t node, const glm::vec3& position)
+{
+	positions[node] = position;
+	MarkDirty(node);
+}
+
+void vkpg::Scene::SetRotation(uint32_t node, const glm::quat& rotation)
+{
+	rotations[node] = rotation;
+	MarkDirty(node);
+}
+
+void vkpg::Scene::SetScale(uint32_t node, const glm::vec3& scale)
+{
+	scales[node] = scale;
+	MarkDirty(node);
+}
+
+const glm::vec3& vkpg::Scene::GetPosition(uint32_t node) const
+{
+	return positions[node];
+}
+
+const glm::quat& vkpg::Scene::GetRotation(uint32_t node) const
+{
+	return rotations[node];
+}
+
+const glm::vec3& vkpg::Scene::GetScale(uint32_t node) const
+{
+	return scales[node];
+}
+
+uint32_t vkpg::Scene::GetParent(uint32_t node) const
+{
+	return parents[node];
+}
+
+const glm::mat4& vkpg::Scene::GetWorldMatrix(uint32_t node) const
+{
+	return world_matrices[node];
+}
+
+const std::vector<glm::mat4>& vkpg::Scene::GetWorldMatrices() const
+{
+	return world_matrices;
+}
+
+size_t vkpg::Scene::GetNodeCount() const
+{
+	return parents.size();
+}
+
+uint32_t vkpg::Scene::Update(uint32_t thread_count)
+{
+	if(first_dirty >= parents.size())
+	{
+		return 0;
+	}
+
+	thread_count = std::min(thread_count, max_thread_count);
+
+	// Only this thread changes the generation, the new workers wait for the next one
+	for(auto i = static_cast<uint32_t>(workers.size() + 1); i < thread_count; i++)
+	{
+		workers.emplace_back(&Scene::WorkerLoop, this, i, update_generation);
+	}
+
+	uint32_t updated = 0;
+	if(thread_count > 1)
+	{
+		updated = UpdateParallel(thread_count);
+	}
+	else
+	{
+		for(uint32_t node = first_dirty; node < parents.size(); node++)
+		{
+			updated += UpdateNode(node) ? 1 : 0;
+		}
+	}
+
+	std::fill(dirty.begin() + first_dirty, dirty.end(), 0);
+	first_dirty = UINT32_MAX;
+
+	return updated;
+}
+
+void vkpg::Scene::MarkDirty(uint32_t node)
+{
+	dirty[node] = 1;
+	first_dirty = std::min(first_dirty, node);
+}
+
+bool vkpg::Scene::UpdateNode(uint32_t node)
+{
+	auto parent = parents[node];
+	if(parent != NO_PARENT_NODE && dirty[parent])
+	{
+		dirty[node] = 1;
+	}
+
+	if(!dirty[node])
+	{
+		return false;
+	}
+
+	auto local = ComposeTransform(positions[node], rotations[node], scales[node]);
+	world_matrices[node] = parent == NO_PARENT_NODE ? local : MultiplyAffine(world_matrices[parent], local);
+
+	return true;
+}
+
+void vkpg::Scene::BuildLevels()
+{
+	uint32_t level_count = 0;
+	for(auto depth : depths)
+	{
+		level_count = std::max(level_count, depth + 1);
+	}
+
+	// Counting sort by depth, keeps the index order inside a level so memory is still walked forward
+	level_offsets.assign(level_count + 1, 0);
+	for(auto depth : depths)
+	{
+		level_offsets[depth + 1]++;
+	}
+	for(uint32_t level = 0; level < level_count; level++)
+	{
+		level_offsets[level + 1] += level_offsets[level];
+	}
+
+	std::vector<uint32_t> next(level_offsets.begin(), level_offsets.end() - 1);
+	level_nodes.resize(depths.size());
+	for(uint32_t node = 0; node < depths.size(); node++)
+	{
+		level_nodes[next[depths[node]]++] = node;
+	}
+
+	levels_valid = true;
+}
+
+uint32_t vkpg::Scene::UpdateParallel(uint32_t thread_count)
+{
+	if(!levels_valid)
+	{
+		BuildLevels();
+	}
+
+	if(updated_counts.size() != thread_count)
+	{
+		level_barrier = std::make_unique<std::barrier<>>(thread_count);
+		updated_counts.assign(thread_count, 0);
+	}
+
+	{
+		std::lock_guard lock(worker_mutex);
+		update_thread_count = thread_count;
+		update_generation++;
+		finished_workers = 0;
+	}
+	worker_condition.notify_all();
+
+	UpdateLevels(0, thread_count);
+
+	{
+		std::unique_lock lock(worker_mutex);
+		finished_condition.wait(lock, [&] { return finished_workers == thread_count - 1; });
+	}
+
+	uint32_t total = 0;
+	for(auto count : updated_counts)
+	{
+		total += count;
+	}
+
+	return total;
+}
+
+void vkpg::Scene::UpdateLevels(uint32_t thread_index, uint32_t thread_count)
+{
+	auto level_count = static_cast<uint32_t>(level_offsets.size() - 1);
+
+	// A level only reads the matrices and dirty flags of the one before it
+	uint32_t thread_updated = 0;
+	for(uint32_t level = 0; level < level_count; level++)
+	{
+		auto level_begin = level_offsets[level];
+		auto level_size = level_offsets[level + 1] - level_begin;
+		auto chunk_size = (level_size + thread_count - 1) / thread_count;
+
+		auto begin = level_begin + std::min(level_size, thread_index * chunk_size);
+		auto end = level_begin + std::min(level_size, (thread_index + 1) * chunk_size);
+		for(auto i = begin; i < end; i++)
+		{
+			auto node = level_nodes[i];
+			if(node >= first_dirty)
+			{
+				thread_updated += UpdateNode(node) ? 1 : 0;
+			}
+		}
+
+		level_barrier->arrive_and_wait();
+	}
+
+	// Written once at the end, neighbouring counters would share a cache line
+	updated_counts[thread_index] = thread_updated;
+}
+
+void vkpg::Scene::WorkerLoop(uint32_t thread_index, uint64_t generation)
+{
+	while(true)
+	{
+		uint32_t thread_count = 0;
+		{
+			std::unique_lock lock(worker_mutex);
+			worker_condition.wait(lock, [&] { return stopping || update_generation != generation; });
+			if(stopping)
+			{
+				return;
+			}
+			generation = update_generation;
+			thread_count = update_thread_count;
+		}
+
+		// Workers beyond the requested thread count sit this update out
+		if(thread_index < thread_count)
+		{
+			UpdateLevels(thread_index, thread_count);
+
+			{
+				std::lock_guard lock(worker_mutex);
+				finished_workers++;
+			}
+			finished_condition.notify_one();
+		}
+	}
+}
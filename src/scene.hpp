@@ -0,0 +1,103 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <barrier>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace vkpg
+{
+
+constexpr uint32_t NO_PARENT_NODE = UINT32_MAX;
+
+// Transform hierarchy stored as parallel arrays indexed by node. A node's parent always has a lower index,
+// so world matrices are computed in a single pass in index order. Only nodes whose local transform changed,
+// and everything below them, are recomputed.
+class Scene
+{
+public:
+	// Worker threads of the parallel update are started by the first Update that needs them and kept for the
+	// lifetime of the scene, a scene only ever updated by one thread starts none
+	explicit Scene(uint32_t max_thread_count = std::max(1u, std::thread::hardware_concurrency()));
+	~Scene();
+
+	Scene(const Scene&) = delete;
+	Scene& operator=(const Scene&) = delete;
+
+	// The parent has to exist already, NO_PARENT_NODE makes a root
+	uint32_t AddNode(uint32_t parent = NO_PARENT_NODE, const glm::vec3& position = glm::vec3(0.0f),
+	                 const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f));
+
+	void SetPosition(uint32_t node, const glm::vec3& position);
+	void SetRotation(uint32_t node, const glm::quat& rotation);
+	void SetScale(uint32_t node, const glm::vec3& scale);
+
+	const glm::vec3& GetPosition(uint32_t node) const;
+	const glm::quat& GetRotation(uint32_t node) const;
+	const glm::vec3& GetScale(uint32_t node) const;
+	uint32_t GetParent(uint32_t node) const;
+
+	// Valid after Update
+	const glm::mat4& GetWorldMatrix(uint32_t node) const;
+	// Contiguous in node order, ready to be copied into an instance buffer as is
+	const std::vector<glm::mat4>& GetWorldMatrices() const;
+
+	size_t GetNodeCount() const;
+
+	// Recomputes the world matrices of dirty subtrees and returns how many were recomputed.
+	// With more than one thread the nodes are processed a depth level at a time, each level split into chunks.
+	// thread_count is limited to the max_thread_count the scene was created with.
+	uint32_t Update(uint32_t thread_count = 1);
+
+private:
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+	std::vector<glm::vec3> positions;
+	std::vector<glm::quat> rotations;
+	std::vector<glm::vec3> scales;
+	std::vector<glm::mat4> world_matrices;
+	// Set when the local transform changed, spreads to the children during Update and is cleared afterwards
+	std::vector<uint8_t> dirty;
+
+	// Lowest dirty node, nodes before it can't be affected
+	uint32_t first_dirty = UINT32_MAX;
+
+	// Node indices sorted by depth for the parallel update, rebuilt after nodes were added
+	std::vector<uint32_t> level_nodes;
+	std::vector<uint32_t> level_offsets;
+	bool levels_valid = false;
+
+	// The calling thread takes part in the parallel update as the first thread, the workers are the others
+	uint32_t max_thread_count = 1;
+	std::vector<std::thread> workers;
+	std::mutex worker_mutex;
+	std::condition_variable worker_condition;
+	// Bumped for every parallel update to wake the workers
+	uint64_t update_generation = 0;
+	uint32_t update_thread_count = 0;
+	// Workers done with the current update, they are out of the barrier by then so it can be replaced
+	uint32_t finished_workers = 0;
+	std::condition_variable finished_condition;
+	bool stopping = false;
+	// Only rebuilt when the thread count changes, one counter per thread
+	std::unique_ptr<std::barrier<>> level_barrier;
+	std::vector<uint32_t> updated_counts;
+
+	void MarkDirty(uint32_t node);
+	// Returns whether the node was recomputed
+	bool UpdateNode(uint32_t node);
+	void BuildLevels();
+	uint32_t UpdateParallel(uint32_t thread_count);
+	void UpdateLevels(uint32_t thread_index, uint32_t thread_count);
+	// Starts from the given generation, so a worker started between updates doesn't replay the last one
+	void WorkerLoop(uint32_t thread_index, uint64_t generation);
+};
+
+} // namespace vkpg
@@ -5,12 +5,46 @@
 
 #include <imgui_impl_vulkan.h>
 
+#include <algorithm>
 #include <array>
-#include <numeric>
+#include <iostream>
 
 constexpr auto TEXTURE_PATH = "resources/textures/viking_room.png";
 
+constexpr uint32_t MAX_BINDLESS_TEXTURES = 1024;
+
+namespace
+{
+
+VkImageMemoryBarrier2 ImageBarrier(VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout,
+                                   VkPipelineStageFlags2 source_stages, VkAccessFlags2 source_access,
+                                   VkPipelineStageFlags2 destination_stages, VkAccessFlags2 destination_access)
+{
+	VkImageMemoryBarrier2 barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+	barrier.srcStageMask = source_stages;
+	barrier.srcAccessMask = source_access;
+	barrier.dstStageMask = destination_stages;
+	barrier.dstAccessMask = destination_access;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = aspect;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	return barrier;
+}
+
+} // namespace
+
 vkpg::VulkanSwapChain::VulkanSwapChain(VulkanDevice& vulkan_device, VulkanWindow& window, VkSurfaceKHR& surface) :
+    descriptor_layout_cache(vulkan_device), descriptor_allocator(vulkan_device),
+    pipelines(vulkan_device, pipeline_cache), mip_generator(vulkan_device, pipelines, descriptor_layout_cache), profiler(vulkan_device), capture(vulkan_device), async_compute(vulkan_device),
+    depth_pyramid(vulkan_device, pipelines, descriptor_layout_cache), render_graph(vulkan_device),
     vulkan_device(vulkan_device), window(window), surface(surface)
 {
 
@@ -41,6 +75,52 @@ void vkpg::VulkanSwapChain::Create()
 	create_info.imageArrayLayers = 1;
 	create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
+	capture_usage_supported = swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	if(capture_usage_supported)
+	{
+		create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	}
+
+	// The offscreen scene is blitted into the swap chain image with linear filtering
+	VkFormatProperties format_properties;
+	vkGetPhysicalDeviceFormatProperties(vulkan_device.physical_device, surface_format.format, &format_properties);
+
+	VkFormatFeatureFlags blit_features = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+	                                     VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+	blit_supported = (format_properties.optimalTilingFeatures & blit_features) == blit_features &&
+	                 (swap_chain_support.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_DST_BIT);
+	if(blit_supported)
+	{
+		// Always requested, so FXAA can be turned on without recreating the swap chain
+		create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	}
+	else if(dynamic_resolution_enabled)
+	{
+		std::cout << "Dynamic resolution: surface format can't be blitted, disabled" << std::endl;
+		dynamic_resolution_enabled = false;
+	}
+
+	if(dynamic_rendering_enabled && !(vulkan_device.dynamic_rendering_enabled && vulkan_device.synchronization2_enabled))
+	{
+		std::cout << "Dynamic rendering: needs dynamic rendering and synchronization2, using render passes" << std::endl;
+		dynamic_rendering_enabled = false;
+	}
+
+	if(ui_subpass_enabled && dynamic_rendering_enabled)
+	{
+		// Subpasses only exist in render passes
+		std::cout << "UI subpass: not possible with dynamic rendering, disabled" << std::endl;
+		ui_subpass_enabled = false;
+	}
+
+	if(ui_subpass_enabled && dynamic_resolution_enabled)
+	{
+		// The scene pass renders into the smaller offscreen image then, the UI needs the full swap chain image
+		std::cout << "UI subpass: not possible with dynamic resolution, disabled" << std::endl;
+		ui_subpass_enabled = false;
+	}
+
 	std::array<uint32_t, 2> queue_family_indices_array
 	{{
 	    vulkan_device.queue_family_indices.graphics_family.value(),
@@ -72,20 +152,141 @@ void vkpg::VulkanSwapChain::Create()
 	vkGetSwapchainImagesKHR(vulkan_device.logical_device, swap_chain, &image_count, images.data());
 
 	image_format = surface_format.format;
+	depth_format = FindDepthFormat();
 	extent = new_extent;
 
-	msaa_samples = vulkan_device.GetMaxUsableSampleCount();
+	if(depth_pyramid_enabled && !depth_pyramid.IsSupported(depth_format))
+	{
+		std::cout << "Depth pyramid: needs a depth format that can be sampled and rg32f storage images, disabled" << std::endl;
+		depth_pyramid_enabled = false;
+	}
+
+	ChooseAntiAliasing();
+
+	bindless_enabled = vulkan_device.descriptor_indexing_enabled;
+
+	// The mesh shader path keeps the bindless fragment shader and its set layout
+	mesh_shader_enabled = meshlets_enabled && vulkan_device.mesh_shader_enabled && bindless_enabled;
+
+	if(async_compute_enabled && (!meshlets_enabled || mesh_shader_enabled))
+	{
+		// The task shader culls in the draw itself
+		std::cout << "Async compute: only used by compute meshlet culling, disabled" << std::endl;
+		async_compute_enabled = false;
+	}
+
+	if(async_compute_enabled && !vulkan_device.queue_family_indices.compute_family.has_value())
+	{
+		std::cout << "Async compute: no dedicated compute queue, culling stays on the graphics queue" << std::endl;
+		async_compute_enabled = false;
+	}
+}
+
+void vkpg::VulkanSwapChain::ChooseAntiAliasing()
+{
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(vulkan_device.physical_device, &properties);
+
+	VkSampleCountFlags supported = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
+	if(object_id_enabled)
+	{
+		// The readback fetches a sample of the multisampled ID image in a compute shader
+		supported &= properties.limits.sampledImageIntegerSampleCounts;
+	}
+	if(depth_pyramid_enabled)
+	{
+		// The first level is reduced from every sample of the depth attachment
+		supported &= properties.limits.sampledImageDepthSampleCounts;
+	}
+
+	msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	for(auto samples = anti_aliasing.samples; samples > VK_SAMPLE_COUNT_1_BIT; samples = static_cast<VkSampleCountFlagBits>(samples >> 1))
+	{
+		if(supported & samples)
+		{
+			msaa_samples = samples;
+			break;
+		}
+	}
+
+	if(msaa_samples != anti_aliasing.samples)
+	{
+		std::cout << "Anti-aliasing: " << anti_aliasing.samples << "x MSAA not supported, using " << msaa_samples << "x" << std::endl;
+	}
+
+	// FXAA runs between the scene pass and the blit, the UI subpass draws into the swap chain image before that
+	fxaa_enabled = anti_aliasing.fxaa && blit_supported && !ui_subpass_enabled;
+	if(anti_aliasing.fxaa && !fxaa_enabled)
+	{
+		std::cout << "Anti-aliasing: FXAA needs a blittable surface format and no UI subpass, disabled" << std::endl;
+	}
+}
+
+bool vkpg::VulkanSwapChain::IsSceneOffscreen() const
+{
+	return dynamic_resolution_enabled || fxaa_enabled;
+}
+
+uint32_t vkpg::VulkanSwapChain::GetObjectIdAttachment() const
+{
+	// After color, depth and, with MSAA, the resolve target
+	return msaa_samples == VK_SAMPLE_COUNT_1_BIT ? 2 : 3;
+}
+
+VkImageAspectFlags vkpg::VulkanSwapChain::GetDepthAspect() const
+{
+	if(depth_format == VK_FORMAT_D32_SFLOAT_S8_UINT || depth_format == VK_FORMAT_D24_UNORM_S8_UINT)
+	{
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	}
+	return VK_IMAGE_ASPECT_DEPTH_BIT;
+}
+
+void vkpg::VulkanSwapChain::SetAntiAliasing(const AntiAliasing& settings)
+{
+	vkDeviceWaitIdle(vulkan_device.logical_device);
+
+	auto previous_samples = msaa_samples;
+	anti_aliasing = settings;
+	ChooseAntiAliasing();
+
+	if(ui_subpass_enabled && msaa_samples != previous_samples)
+	{
+		// ImGui's pipeline was built for the current render pass, a different sample count isn't compatible with it
+		std::cout << "Anti-aliasing: the sample count can't change while the UI is drawn in a subpass" << std::endl;
+		anti_aliasing.samples = previous_samples;
+		msaa_samples = previous_samples;
+	}
+
+	// Only what depends on the render pass, the swap chain, command buffers and the rest are kept
+	for(const auto& framebuffer : framebuffers)
+	{
+		vkDestroyFramebuffer(vulkan_device.logical_device, framebuffer, nullptr);
+	}
+	DestroyAttachments();
+	vkDestroyRenderPass(vulkan_device.logical_device, render_pass, nullptr);
+
+	CreateRenderPass();
+	CreateScenePipelines();
+	CreateColorResources();
+	CreateDepthResources();
+	CreateObjectIdResources();
+	CreateSceneResources();
+	CreateRenderGraph();
+	CreateFramebuffers();
 }
 
 void vkpg::VulkanSwapChain::Cleanup()
 {
-	vkDestroyImageView(vulkan_device.logical_device, depth_image_view, nullptr);
-	vkDestroyImage(vulkan_device.logical_device, depth_image, nullptr);
-	vkFreeMemory(vulkan_device.logical_device, depth_image_memory, nullptr);
+	CleanupSwapChain();
+	CleanupResources();
+}
 
-	vkDestroyImageView(vulkan_device.logical_device, color_image_view, nullptr);
-	vkDestroyImage(vulkan_device.logical_device, color_image, nullptr);
-	vkFreeMemory(vulkan_device.logical_device, color_image_memory, nullptr);
+void vkpg::VulkanSwapChain::CleanupSwapChain()
+{
+	capture.Cleanup();
+
+	DestroyAttachments();
 
 	for(const auto& framebuffer : ui_framebuffers)
 	{
@@ -100,34 +301,94 @@ void vkpg::VulkanSwapChain::Cleanup()
 	vkFreeCommandBuffers(vulkan_device.logical_device, ui_command_pool,
 	                     static_cast<uint32_t>(ui_command_buffers.size()), ui_command_buffers.data());
 
-	vkDestroyCommandPool(vulkan_device.logical_device, ui_command_pool, nullptr);
-
 	vkFreeCommandBuffers(vulkan_device.logical_device, command_pool,
 	                     static_cast<uint32_t>(command_buffers.size()), command_buffers.data());
 
+	for(const auto& image_view : image_views)
+	{
+		vkDestroyImageView(vulkan_device.logical_device, image_view, nullptr);
+	}
+
+	vkDestroySwapchainKHR(vulkan_device.logical_device, swap_chain, nullptr);
+}
+
+void vkpg::VulkanSwapChain::DestroyAttachments()
+{
+	depth_pyramid.DestroyResources();
+
+	vkDestroyImageView(vulkan_device.logical_device, depth_image_view, nullptr);
+	vkDestroyImage(vulkan_device.logical_device, depth_image, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, depth_image_memory, nullptr);
+	depth_image_view = VK_NULL_HANDLE;
+	depth_image = VK_NULL_HANDLE;
+	depth_image_memory = VK_NULL_HANDLE;
+
+	vkDestroyImageView(vulkan_device.logical_device, color_image_view, nullptr);
+	vkDestroyImage(vulkan_device.logical_device, color_image, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, color_image_memory, nullptr);
+	color_image_view = VK_NULL_HANDLE;
+	color_image = VK_NULL_HANDLE;
+	color_image_memory = VK_NULL_HANDLE;
+
+	vkDestroyImageView(vulkan_device.logical_device, scene_image_view, nullptr);
+	vkDestroyImage(vulkan_device.logical_device, scene_image, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, scene_image_memory, nullptr);
+	scene_image_view = VK_NULL_HANDLE;
+	scene_image = VK_NULL_HANDLE;
+	scene_image_memory = VK_NULL_HANDLE;
+
+	render_graph.Cleanup();
+
+	vkDestroyImageView(vulkan_device.logical_device, object_id_image_view, nullptr);
+	vkDestroyImage(vulkan_device.logical_device, object_id_image, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, object_id_image_memory, nullptr);
+	object_id_image_view = VK_NULL_HANDLE;
+	object_id_image = VK_NULL_HANDLE;
+	object_id_image_memory = VK_NULL_HANDLE;
+}
+
+void vkpg::VulkanSwapChain::CleanupResources()
+{
+	vkDestroyCommandPool(vulkan_device.logical_device, ui_command_pool, nullptr);
 	vkDestroyCommandPool(vulkan_device.logical_device, command_pool, nullptr);
 
-	vkDestroyPipeline(vulkan_device.logical_device, graphics_pipeline, nullptr);
+	profiler.Cleanup();
+	async_compute.Cleanup();
+	mip_generator.Cleanup();
+	depth_pyramid.Cleanup();
+
+	pipelines.Cleanup();
 	vkDestroyPipelineLayout(vulkan_device.logical_device, pipeline_layout, nullptr);
+	vkDestroyPipelineLayout(vulkan_device.logical_device, meshlet_pipeline_layout, nullptr);
+	vkDestroyPipelineLayout(vulkan_device.logical_device, meshlet_cull_pipeline_layout, nullptr);
+	vkDestroyPipelineLayout(vulkan_device.logical_device, pick_pipeline_layout, nullptr);
+	vkDestroyPipelineLayout(vulkan_device.logical_device, fxaa_pipeline_layout, nullptr);
+	meshlet_pipeline_layout = VK_NULL_HANDLE;
+	meshlet_cull_pipeline_layout = VK_NULL_HANDLE;
+	pick_pipeline_layout = VK_NULL_HANDLE;
+	fxaa_pipeline_layout = VK_NULL_HANDLE;
+
+	vkDestroySampler(vulkan_device.logical_device, fxaa_sampler, nullptr);
+	fxaa_sampler = VK_NULL_HANDLE;
 
 	vkDestroyRenderPass(vulkan_device.logical_device, ui_render_pass, nullptr);
 	vkDestroyRenderPass(vulkan_device.logical_device, render_pass, nullptr);
 
-	for(const auto& image_view : image_views)
+	for(size_t i = 0; i < uniform_buffers.size(); i++)
 	{
-		vkDestroyImageView(vulkan_device.logical_device, image_view, nullptr);
+		vkDestroyBuffer(vulkan_device.logical_device, uniform_buffers[i], nullptr);
+		vkFreeMemory(vulkan_device.logical_device, uniform_buffers_memory[i], nullptr);
 	}
 
-	vkDestroySwapchainKHR(vulkan_device.logical_device, swap_chain, nullptr);
+	vkDestroyDescriptorPool(vulkan_device.logical_device, ui_descriptor_pool, nullptr);
 
-	for(size_t i = 0; i < images.size(); i++)
+	for(auto& frame_descriptor_allocator : frame_descriptor_allocators)
 	{
-		vkDestroyBuffer(vulkan_device.logical_device, uniform_buffers[i], nullptr);
-		vkFreeMemory(vulkan_device.logical_device, uniform_buffers_memory[i], nullptr);
+		frame_descriptor_allocator.Cleanup();
 	}
+	frame_descriptor_allocators.clear();
 
-	vkDestroyDescriptorPool(vulkan_device.logical_device, ui_descriptor_pool, nullptr);
-	vkDestroyDescriptorPool(vulkan_device.logical_device, descriptor_pool, nullptr);
+	descriptor_allocator.Cleanup();
 
 	vkDestroySampler(vulkan_device.logical_device, texture_sampler, nullptr);
 	vkDestroyImageView(vulkan_device.logical_device, texture_image_view, nullptr);
@@ -135,7 +396,50 @@ void vkpg::VulkanSwapChain::Cleanup()
 	vkDestroyImage(vulkan_device.logical_device, texture_image, nullptr);
 	vkFreeMemory(vulkan_device.logical_device, texture_image_memory, nullptr);
 
-	vkDestroyDescriptorSetLayout(vulkan_device.logical_device, descriptor_set_layout, nullptr);
+	vkDestroyDescriptorPool(vulkan_device.logical_device, bindless_descriptor_pool, nullptr);
+
+	descriptor_layout_cache.Cleanup();
+
+	vkDestroyBuffer(vulkan_device.logical_device, indirect_buffer, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, indirect_buffer_memory, nullptr);
+
+	for(size_t i = 0; i < meshlet_draw_buffers.size(); i++)
+	{
+		vkDestroyBuffer(vulkan_device.logical_device, culled_index_buffers[i], nullptr);
+		vkFreeMemory(vulkan_device.logical_device, culled_index_buffers_memory[i], nullptr);
+		vkDestroyBuffer(vulkan_device.logical_device, meshlet_draw_buffers[i], nullptr);
+		vkFreeMemory(vulkan_device.logical_device, meshlet_draw_buffers_memory[i], nullptr);
+	}
+	culled_index_buffers.clear();
+	culled_index_buffers_memory.clear();
+	meshlet_draw_buffers.clear();
+	meshlet_draw_buffers_memory.clear();
+	meshlet_draw_data.clear();
+	meshlet_descriptor_sets.clear();
+	meshlet_results_released.clear();
+
+	for(size_t i = 0; i < pick_buffers.size(); i++)
+	{
+		vkDestroyBuffer(vulkan_device.logical_device, pick_buffers[i], nullptr);
+		vkFreeMemory(vulkan_device.logical_device, pick_buffers_memory[i], nullptr);
+	}
+	pick_buffers.clear();
+	pick_buffers_memory.clear();
+	pick_data.clear();
+	pick_pending.clear();
+
+	vkDestroyBuffer(vulkan_device.logical_device, meshlet_triangle_buffer, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, meshlet_triangle_buffer_memory, nullptr);
+	vkDestroyBuffer(vulkan_device.logical_device, meshlet_vertex_buffer, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, meshlet_vertex_buffer_memory, nullptr);
+	vkDestroyBuffer(vulkan_device.logical_device, meshlet_buffer, nullptr);
+	vkFreeMemory(vulkan_device.logical_device, meshlet_buffer_memory, nullptr);
+	meshlet_triangle_buffer = VK_NULL_HANDLE;
+	meshlet_triangle_buffer_memory = VK_NULL_HANDLE;
+	meshlet_vertex_buffer = VK_NULL_HANDLE;
+	meshlet_vertex_buffer_memory = VK_NULL_HANDLE;
+	meshlet_buffer = VK_NULL_HANDLE;
+	meshlet_buffer_memory = VK_NULL_HANDLE;
 
 	vkDestroyBuffer(vulkan_device.logical_device, index_buffer, nullptr);
 	vkFreeMemory(vulkan_device.logical_device, index_buffer_memory, nullptr);
@@ -156,29 +460,55 @@ void vkpg::VulkanSwapChain::Recreate()
 
 	vkDeviceWaitIdle(vulkan_device.logical_device);
 
-	Cleanup();
+	auto previous_image_format = image_format;
+	auto previous_image_count = images.size();
+
+	CleanupSwapChain();
 	Create();
 
+	// Viewport and scissor are dynamic, so a plain resize keeps render passes, pipelines and per-image resources
+	if(image_format != previous_image_format || images.size() != previous_image_count)
+	{
+		CleanupResources();
+
+		CreateRenderPass();
+		CreateUiRenderPass();
+		CreateDescriptorSetLayout();
+		CreateBindlessDescriptorSetLayout();
+		CreateGraphicsPipeline();
+		CreateMeshletPipelines();
+		CreateCommandPool();
+		CreateUiCommandPool();
+		CreateDepthPyramid();
+		CreateMipGenerator();
+		CreateTextureImage();
+		CreateTextureImageView();
+		CreateTextureSampler();
+		CreateVertexBuffer();
+		CreateIndexBuffer();
+		CreateUniformBuffers();
+		CreateDescriptorAllocators();
+		CreateUiDescriptorPool();
+		CreateDescriptorSets();
+		CreateBindlessDescriptorPool();
+		CreateBindlessDescriptorSet();
+		CreateIndirectBuffer();
+		CreateAsyncCompute();
+		CreateMeshletResources();
+		CreatePickResources();
+		CreateFxaaPipeline();
+		CreateProfiler();
+	}
+
 	CreateImageViews();
-	CreateRenderPass();
-	CreateUiRenderPass();
-	CreateDescriptorSetLayout();
-	CreateGraphicsPipeline();
-	CreateCommandPool();
-	CreateUiCommandPool();
 	CreateColorResources();
 	CreateDepthResources();
+	CreateObjectIdResources();
+	CreateSceneResources();
+	CreateRenderGraph();
+	CreateCaptureResources();
 	CreateFramebuffers();
 	CreateUiFramebuffers();
-	CreateTextureImage();
-	CreateTextureImageView();
-	CreateTextureSampler();
-	CreateVertexBuffer();
-	CreateIndexBuffer();
-	CreateUniformBuffers();
-	CreateDescriptorPool();
-	CreateUiDescriptorPool();
-	CreateDescriptorSets();
 	CreateCommandBuffers();
 	CreateUiCommandBuffers();
 	ImGui_ImplVulkan_SetMinImageCount(2); // TODO: use MAX_FRAMES_IN_FLIGHT?
@@ -196,29 +526,44 @@ void vkpg::VulkanSwapChain::CreateImageViews()
 
 void vkpg::VulkanSwapChain::CreateRenderPass()
 {
+	if(dynamic_rendering_enabled)
+	{
+		// The attachments are given to vkCmdBeginRendering, see BeginScenePass
+		render_pass = VK_NULL_HANDLE;
+		return;
+	}
+
+	bool multisampled = msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+	// With the UI subpass this pass is the last to write the swap chain image. An offscreen scene image is moved on
+	// by the render graph.
+	auto target_final_layout = ui_subpass_enabled ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
 	VkAttachmentDescription color_attachment{};
 	color_attachment.format = image_format;
 	color_attachment.samples = msaa_samples;
 	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	// Resolved at the end of the subpass, the samples themselves are never read again. Without MSAA this is the target.
+	color_attachment.storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 	color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.finalLayout = multisampled ? VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL : target_final_layout;
 
 	VkAttachmentReference color_attachment_ref{};
 	color_attachment_ref.attachment = 0;
 	color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentDescription depth_attachment{};
-	depth_attachment.format = FindDepthFormat();
+	depth_attachment.format = depth_format;
 	depth_attachment.samples = msaa_samples;
 	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-	depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	// Only the depth pyramid reads depth after the pass
+	depth_attachment.storeOp = depth_pyramid_enabled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depth_attachment.finalLayout = depth_pyramid_enabled ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 	VkAttachmentReference depth_attachment_ref{};
 	depth_attachment_ref.attachment = 1;
@@ -232,37 +577,119 @@ void vkpg::VulkanSwapChain::CreateRenderPass()
 	color_attachment_resolve.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	color_attachment_resolve.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	color_attachment_resolve.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment_resolve.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment_resolve.finalLayout = target_final_layout;
 
 	VkAttachmentReference color_attachment_resolve_ref{};
 	color_attachment_resolve_ref.attachment = 2;
 	color_attachment_resolve_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-	VkSubpassDescription subpass{};
-	subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-	subpass.colorAttachmentCount = 1;
-	subpass.pColorAttachments = &color_attachment_ref;
-	subpass.pDepthStencilAttachment = &depth_attachment_ref;
-	subpass.pResolveAttachments = &color_attachment_resolve_ref;
+	// With MSAA object IDs stay multisampled, integers can't be averaged, and the readback fetches a single sample
+	VkAttachmentDescription object_id_attachment{};
+	object_id_attachment.format = VK_FORMAT_R32_UINT;
+	object_id_attachment.samples = msaa_samples;
+	object_id_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	object_id_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	object_id_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+	object_id_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	object_id_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	object_id_attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	std::array<VkAttachmentReference, 2> color_attachment_refs{color_attachment_ref};
+	color_attachment_refs[1].attachment = GetObjectIdAttachment();
+	color_attachment_refs[1].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	std::array<VkAttachmentReference, 2> resolve_attachment_refs{color_attachment_resolve_ref};
+	resolve_attachment_refs[1].attachment = VK_ATTACHMENT_UNUSED;
+	resolve_attachment_refs[1].layout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	std::array<VkSubpassDescription, 2> subpasses{};
+	subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[0].colorAttachmentCount = object_id_enabled ? 2 : 1;
+	subpasses[0].pColorAttachments = color_attachment_refs.data();
+	subpasses[0].pDepthStencilAttachment = &depth_attachment_ref;
+	subpasses[0].pResolveAttachments = multisampled ? resolve_attachment_refs.data() : nullptr;
+
+	// The UI draws straight onto the resolved image
+	subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[1].colorAttachmentCount = 1;
+	subpasses[1].pColorAttachments = multisampled ? &color_attachment_resolve_ref : &color_attachment_ref;
+
+	std::array<VkSubpassDependency, 3> dependencies{};
+
+	dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	dependencies[0].dstSubpass = 0;
+	dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].srcAccessMask = 0;
+	dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	if(IsSceneOffscreen())
+	{
+		// The previous frame's FXAA or blit has to finish reading the scene image before it is overwritten, the
+		// render graph waits for this pass before reading it
+		dependencies[0].srcStageMask |= fxaa_enabled ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+	}
 
-	VkSubpassDependency dependency{};
-	dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-	dependency.dstSubpass = 0;
-	dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.srcAccessMask = 0;
-	dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+	if(object_id_enabled)
+	{
+		// Same for the previous frame's readback and the object IDs, this frame's readback waits for the pass
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	}
+
+	if(depth_pyramid_enabled)
+	{
+		// The previous frame's pyramid reads depth before it is cleared, this frame's waits for the depth writes
+		dependencies[0].srcStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[0].dstStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[0].dstAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+
+		dependencies[1].srcSubpass = 0;
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask |= VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		dependencies[1].srcAccessMask |= VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		dependencies[1].dstAccessMask |= VK_ACCESS_SHADER_READ_BIT;
+	}
+
+	uint32_t dependency_count = object_id_enabled || depth_pyramid_enabled ? 2 : 1;
+	if(ui_subpass_enabled)
+	{
+		// The UI blends over the resolved scene, by region so tilers keep it on chip
+		auto& dependency = dependencies[dependency_count++];
+		dependency.srcSubpass = 0;
+		dependency.dstSubpass = 1;
+		dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependency.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+	}
 
-	std::array<VkAttachmentDescription, 3> attachments = {color_attachment, depth_attachment, color_attachment_resolve};
+	std::vector<VkAttachmentDescription> attachments = {color_attachment, depth_attachment};
+	if(multisampled)
+	{
+		attachments.push_back(color_attachment_resolve);
+	}
+	if(object_id_enabled)
+	{
+		attachments.push_back(object_id_attachment);
+	}
 
 	VkRenderPassCreateInfo render_pass_info{};
 	render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
 	render_pass_info.attachmentCount = static_cast<uint32_t>(attachments.size());
 	render_pass_info.pAttachments = attachments.data();
-	render_pass_info.subpassCount = 1;
-	render_pass_info.pSubpasses = &subpass;
-	render_pass_info.dependencyCount = 1;
-	render_pass_info.pDependencies = &dependency;
+	render_pass_info.subpassCount = ui_subpass_enabled ? 2 : 1;
+	render_pass_info.pSubpasses = subpasses.data();
+	render_pass_info.dependencyCount = dependency_count;
+	render_pass_info.pDependencies = dependencies.data();
 
 	auto result = vkCreateRenderPass(vulkan_device.logical_device, &render_pass_info, nullptr, &render_pass);
 	CheckVkResult(result, "Failed to create render pass");
@@ -270,6 +697,12 @@ void vkpg::VulkanSwapChain::CreateRenderPass()
 
 void vkpg::VulkanSwapChain::CreateUiRenderPass()
 {
+	if(dynamic_rendering_enabled)
+	{
+		ui_render_pass = VK_NULL_HANDLE;
+		return;
+	}
+
 	VkAttachmentDescription color_attachment{};
 	color_attachment.format = image_format;
 	color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
@@ -310,192 +743,572 @@ void vkpg::VulkanSwapChain::CreateUiRenderPass()
 	CheckVkResult(result, "Failed to create ui render pass");
 }
 
-void vkpg::VulkanSwapChain::CreateGraphicsPipeline()
+void vkpg::VulkanSwapChain::CreatePipelineCache()
 {
-	auto vert_shader_code = ReadFile("shaders/shader.vert.spv");
-	auto frag_shader_code = ReadFile("shaders/shader.frag.spv");
-
-	VkShaderModule vert_shader_module = CreateShaderModule(vert_shader_code);
-	VkShaderModule frag_shader_module = CreateShaderModule(frag_shader_code);
-
-	VkPipelineShaderStageCreateInfo vert_shader_stage_info{};
-	vert_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	vert_shader_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
-	vert_shader_stage_info.module = vert_shader_module;
-	vert_shader_stage_info.pName = "main";
-
-	VkPipelineShaderStageCreateInfo frag_shader_stage_info{};
-	frag_shader_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	frag_shader_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-	frag_shader_stage_info.module = frag_shader_module;
-	frag_shader_stage_info.pName = "main";
+	VkPipelineCacheCreateInfo pipeline_cache_info{};
+	pipeline_cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 
-	std::array<VkPipelineShaderStageCreateInfo, 2> shader_stages{{vert_shader_stage_info, frag_shader_stage_info}};
-
-	auto binding_description = Vertex::GetBindingDescription();
-	auto attribute_descriptions = Vertex::GetAttributeDescriptions();
-
-	VkPipelineVertexInputStateCreateInfo vertex_input_info{};
-	vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-	vertex_input_info.vertexBindingDescriptionCount = 1;
-	vertex_input_info.vertexAttributeDescriptionCount = static_cast<uint32_t>(attribute_descriptions.size());
-	vertex_input_info.pVertexBindingDescriptions = &binding_description;
-	vertex_input_info.pVertexAttributeDescriptions = attribute_descriptions.data();
-
-	VkPipelineInputAssemblyStateCreateInfo input_assembly{};
-	input_assembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-	input_assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-	input_assembly.primitiveRestartEnable = VK_FALSE;
+	auto result = vkCreatePipelineCache(vulkan_device.logical_device, &pipeline_cache_info, nullptr, &pipeline_cache);
+	CheckVkResult(result, "Failed to create pipeline cache");
+}
 
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(extent.width);
-	viewport.height = static_cast<float>(extent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
+void vkpg::VulkanSwapChain::DestroyPipelineCache()
+{
+	vkDestroyPipelineCache(vulkan_device.logical_device, pipeline_cache, nullptr);
+	pipeline_cache = VK_NULL_HANDLE;
+}
 
-	VkRect2D scissor{};
-	scissor.offset = {0, 0};
-	scissor.extent = extent;
-
-	VkPipelineViewportStateCreateInfo viewport_state{};
-	viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-	viewport_state.viewportCount = 1;
-	viewport_state.pViewports = &viewport;
-	viewport_state.scissorCount = 1;
-	viewport_state.pScissors = &scissor;
-
-	VkPipelineRasterizationStateCreateInfo rasterizer{};
-	rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
-	rasterizer.depthClampEnable = VK_FALSE;
-	rasterizer.rasterizerDiscardEnable = VK_FALSE;
-	rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
-	rasterizer.lineWidth = 1.0f;
-	rasterizer.cullMode = VK_CULL_MODE_BACK_BIT;
-	rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
-	rasterizer.depthBiasEnable = VK_FALSE;
-
-	VkPipelineMultisampleStateCreateInfo multisampling{};
-	multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
-	multisampling.sampleShadingEnable = VK_TRUE;
-	multisampling.minSampleShading = 0.2f; // min fraction for sample shading; closer to 1 is smoother
-	multisampling.rasterizationSamples = msaa_samples;
-
-	VkPipelineDepthStencilStateCreateInfo depth_stencil{};
-	depth_stencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
-	depth_stencil.depthTestEnable = VK_TRUE;
-	depth_stencil.depthWriteEnable = VK_TRUE;
-	depth_stencil.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
-	depth_stencil.depthBoundsTestEnable = VK_FALSE;
-	depth_stencil.stencilTestEnable = VK_FALSE;
-
-	VkPipelineColorBlendAttachmentState color_blend_attachment{};
-	color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT |
-	                                        VK_COLOR_COMPONENT_G_BIT |
-	                                        VK_COLOR_COMPONENT_B_BIT |
-	                                        VK_COLOR_COMPONENT_A_BIT;
-	color_blend_attachment.blendEnable = VK_FALSE;
-
-	VkPipelineColorBlendStateCreateInfo color_blending{};
-	color_blending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-	color_blending.logicOpEnable = VK_FALSE;
-	color_blending.logicOp = VK_LOGIC_OP_COPY;
-	color_blending.attachmentCount = 1;
-	color_blending.pAttachments = &color_blend_attachment;
-	color_blending.blendConstants[0] = 0.0f;
-	color_blending.blendConstants[1] = 0.0f;
-	color_blending.blendConstants[2] = 0.0f;
-	color_blending.blendConstants[3] = 0.0f;
+void vkpg::VulkanSwapChain::CreateGraphicsPipeline()
+{
+	std::array<VkDescriptorSetLayout, 2> set_layouts{{descriptor_set_layout, bindless_descriptor_set_layout}};
 
 	VkPipelineLayoutCreateInfo pipeline_layout_info{};
 	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-	pipeline_layout_info.setLayoutCount = 1;
-	pipeline_layout_info.pSetLayouts = &descriptor_set_layout;
+	pipeline_layout_info.setLayoutCount = bindless_enabled ? 2 : 1;
+	pipeline_layout_info.pSetLayouts = set_layouts.data();
 
 	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &pipeline_layout);
 	CheckVkResult(result, "Failed to create pipeline layout");
 
-	VkGraphicsPipelineCreateInfo pipeline_info{};
-	pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipeline_info.stageCount = shader_stages.size();
-	pipeline_info.pStages = shader_stages.data();
-	pipeline_info.pVertexInputState = &vertex_input_info;
-	pipeline_info.pInputAssemblyState = &input_assembly;
-	pipeline_info.pViewportState = &viewport_state;
-	pipeline_info.pRasterizationState = &rasterizer;
-	pipeline_info.pMultisampleState = &multisampling;
-	pipeline_info.pDepthStencilState = &depth_stencil;
-	pipeline_info.pColorBlendState = &color_blending;
-	pipeline_info.layout = pipeline_layout;
-	pipeline_info.renderPass = render_pass;
-	pipeline_info.subpass = 0;
-	pipeline_info.basePipelineHandle = VK_NULL_HANDLE;
+	if(materials.empty())
+	{
+		auto binding_description = compact_vertices_enabled ? CompactVertex::GetBindingDescription() : Vertex::GetBindingDescription();
+		auto attribute_descriptions = compact_vertices_enabled ? CompactVertex::GetAttributeDescriptions() : Vertex::GetAttributeDescriptions();
+
+		std::string vertex_shader = bindless_enabled ? "shaders/shader_bindless" : "shaders/shader";
+		if(compact_vertices_enabled)
+		{
+			vertex_shader += "_compact";
+		}
 
-	result = vkCreateGraphicsPipelines(vulkan_device.logical_device, pipeline_cache, 1, &pipeline_info, nullptr, &graphics_pipeline);
+		Material material;
+		material.name = "viking_room";
+		material.pipeline_state.vertex_shader = vertex_shader + ".vert.spv";
+		material.pipeline_state.fragment_shader = bindless_enabled ? "shaders/shader_bindless.frag.spv" : "shaders/shader.frag.spv";
+		material.pipeline_state.vertex_bindings = {binding_description};
+		material.pipeline_state.vertex_attributes.assign(attribute_descriptions.begin(), attribute_descriptions.end());
+		material.pipeline_state.min_sample_shading = 0.2f; // min fraction for sample shading; closer to 1 is smoother
+		materials.push_back(material);
 
-	CheckVkResult(result, "Failed to create graphics pipeline");
+		if(vulkan_device.fill_mode_non_solid_enabled)
+		{
+			material.name = "wireframe";
+			material.pipeline_state.polygon_mode = VK_POLYGON_MODE_LINE;
+			material.pipeline_state.cull_mode = VK_CULL_MODE_NONE;
+			materials.push_back(material);
+		}
+	}
 
-	vkDestroyShaderModule(vulkan_device.logical_device, frag_shader_module, nullptr);
-	vkDestroyShaderModule(vulkan_device.logical_device, vert_shader_module, nullptr);
+	CreateScenePipelines();
 }
 
-void vkpg::VulkanSwapChain::CreateColorResources()
+vkpg::PipelineState vkpg::VulkanSwapChain::GetTargetPipelineState(PipelineState state, VkPipelineLayout layout) const
 {
-	VkFormat color_format = image_format;
-
-	CreateImage(extent.width, extent.height, 1, msaa_samples, color_format, VK_IMAGE_TILING_OPTIMAL,
-	            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color_image, color_image_memory);
-
-	color_image_view = CreateImageView(color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	state.samples = msaa_samples;
+	// Per sample shading of one sample is the same as shading once per pixel
+	state.sample_shading = anti_aliasing.sample_shading && msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+	state.layout = layout;
+	state.render_pass = render_pass;
+	state.subpass = 0;
+	state.color_attachment_count = object_id_enabled ? 2 : 1;
+
+	if(dynamic_rendering_enabled)
+	{
+		// Same attachments as BeginScenePass
+		state.color_formats = {image_format};
+		if(object_id_enabled)
+		{
+			state.color_formats.push_back(VK_FORMAT_R32_UINT);
+		}
+		state.depth_format = depth_format;
+	}
 
-	//ui_color_image_view = CreateImageView(ui_color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+	return state;
 }
 
-void vkpg::VulkanSwapChain::CreateDepthResources()
+void vkpg::VulkanSwapChain::CreateScenePipelines()
 {
-	VkFormat depth_format = FindDepthFormat();
-
-	CreateImage(extent.width, extent.height, 1, msaa_samples,
-	            depth_format, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth_image, depth_image_memory);
+	for(size_t i = 0; i < materials.size(); i++)
+	{
+		// Render target dependent state is filled in here, so materials survive swap chain recreation
+		auto state = GetTargetPipelineState(materials[i].pipeline_state, pipeline_layout);
 
-	depth_image_view = CreateImageView(depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+		materials[i].pipeline = i == 0 ? pipelines.GetPipeline(state) : pipelines.RequestPipeline(state);
+	}
 
-	//ui_depth_image_view = CreateImageView(ui_depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+	if(meshlet_pipeline_layout != VK_NULL_HANDLE)
+	{
+		auto state = materials.front().pipeline_state;
+		state.vertex_shader.clear();
+		state.vertex_bindings.clear();
+		state.vertex_attributes.clear();
+		state.task_shader = "shaders/meshlet.task.spv";
+		state.mesh_shader = "shaders/meshlet.mesh.spv";
+
+		meshlet_pipeline = pipelines.GetPipeline(GetTargetPipelineState(state, meshlet_pipeline_layout));
+	}
 }
 
-void vkpg::VulkanSwapChain::CreateFramebuffers()
+void vkpg::VulkanSwapChain::UpdateMaterialPipelines()
 {
-	framebuffers.resize(image_views.size());
-
-	for(size_t i = 0; i < image_views.size(); i++)
+	for(auto& material : materials)
 	{
-		std::array<VkImageView, 3> attachments =
+		if(material.pipeline == VK_NULL_HANDLE)
 		{
-			color_image_view,
-			depth_image_view,
-			image_views[i]
-		};
-
-		VkFramebufferCreateInfo framebuffer_info{};
-		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-		framebuffer_info.renderPass = render_pass;
-		framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
-		framebuffer_info.pAttachments = attachments.data();
-		framebuffer_info.width = extent.width;
-		framebuffer_info.height = extent.height;
-		framebuffer_info.layers = 1;
-
-		auto result = vkCreateFramebuffer(vulkan_device.logical_device, &framebuffer_info, nullptr, &framebuffers[i]);
-
-		CheckVkResult(result, "Failed to create framebuffer");
+			material.pipeline = pipelines.RequestPipeline(GetTargetPipelineState(material.pipeline_state, pipeline_layout));
+		}
 	}
 }
 
-void vkpg::VulkanSwapChain::CreateUiFramebuffers()
+const vkpg::Material& vkpg::VulkanSwapChain::GetDrawMaterial() const
 {
+	if(active_material < materials.size() && materials[active_material].pipeline != VK_NULL_HANDLE)
+	{
+		return materials[active_material];
+	}
+
+	return materials.front();
+}
+
+void vkpg::VulkanSwapChain::CreateMeshletPipelines()
+{
+	if(!meshlets_enabled)
+	{
+		return;
+	}
+
+	VkShaderStageFlags stages = mesh_shader_enabled ? VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT
+	                                                : VK_SHADER_STAGE_COMPUTE_BIT;
+
+	// Meshlets, meshlet vertices, meshlet triangles, vertices (mesh shader), culled indices (compute) and the draw data
+	std::vector<VkDescriptorSetLayoutBinding> bindings(6);
+	for(uint32_t i = 0; i < bindings.size(); i++)
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorCount = 1;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].pImmutableSamplers = nullptr;
+		bindings[i].stageFlags = stages;
+	}
+
+	meshlet_descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = stages;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(MeshletConstants);
+
+	if(!mesh_shader_enabled)
+	{
+		VkPipelineLayoutCreateInfo pipeline_layout_info{};
+		pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipeline_layout_info.setLayoutCount = 1;
+		pipeline_layout_info.pSetLayouts = &meshlet_descriptor_set_layout;
+		pipeline_layout_info.pushConstantRangeCount = 1;
+		pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+		auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &meshlet_cull_pipeline_layout);
+		CheckVkResult(result, "Failed to create meshlet culling pipeline layout");
+
+		meshlet_cull_pipeline = pipelines.GetComputePipeline("shaders/meshlet_cull.comp.spv", meshlet_cull_pipeline_layout);
+		return;
+	}
+
+	// The UBO and bindless texture sets keep their numbers, so the scene's fragment shader works unchanged
+	std::array<VkDescriptorSetLayout, 3> set_layouts{{descriptor_set_layout, bindless_descriptor_set_layout, meshlet_descriptor_set_layout}};
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = static_cast<uint32_t>(set_layouts.size());
+	pipeline_layout_info.pSetLayouts = set_layouts.data();
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &meshlet_pipeline_layout);
+	CheckVkResult(result, "Failed to create meshlet pipeline layout");
+
+	CreateScenePipelines();
+}
+
+void vkpg::VulkanSwapChain::CreateColorResources()
+{
+	if(msaa_samples == VK_SAMPLE_COUNT_1_BIT)
+	{
+		// The scene is drawn straight into its target
+		return;
+	}
+
+	if(AreAttachmentsAliased())
+	{
+		// Created by the render graph, see AddScenePass
+		return;
+	}
+
+	VkFormat color_format = image_format;
+
+	// Only lives inside the render pass, the resolve attachment keeps the result
+	CreateImage(extent.width, extent.height, 1, msaa_samples, color_format, VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT, color_image, color_image_memory);
+
+	color_image_view = CreateImageView(color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+
+	//ui_color_image_view = CreateImageView(ui_color_image, color_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void vkpg::VulkanSwapChain::CreateDepthPyramid()
+{
+	if(depth_pyramid_enabled)
+	{
+		depth_pyramid.Create();
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateDepthResources()
+{
+	frames_since_attachments = 0;
+	if(!depth_pyramid_enabled && AreAttachmentsAliased())
+	{
+		// Created by the render graph, see AddScenePass
+		return;
+	}
+
+	// The depth pyramid reads it after the pass, otherwise it never has to leave the tile
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if(depth_pyramid_enabled)
+	{
+		usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+	}
+	else
+	{
+		usage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		properties |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
+	CreateImage(extent.width, extent.height, 1, msaa_samples, depth_format, VK_IMAGE_TILING_OPTIMAL, usage, properties,
+	            depth_image, depth_image_memory);
+
+	depth_image_view = CreateImageView(depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+	if(depth_pyramid_enabled)
+	{
+		depth_pyramid.CreateResources(depth_image_view, extent);
+	}
+
+	//ui_depth_image_view = CreateImageView(ui_depth_image, depth_format, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+}
+
+void vkpg::VulkanSwapChain::ReportAttachmentMemory() const
+{
+	auto ToMiB = [](VkDeviceSize size)
+	{
+		return static_cast<double>(size) / (1024.0 * 1024.0);
+	};
+
+	VkDeviceSize total_size = 0;
+	VkDeviceSize lazy_size = 0;
+	VkDeviceSize lazy_committed_size = 0;
+
+	std::cout << "Attachments " << extent.width << "x" << extent.height << ", " << msaa_samples << "x MSAA after "
+	          << frames_since_attachments << " frames:";
+
+	struct Attachment
+	{
+		const char* name;
+		VkImage image;
+		VkDeviceMemory memory;
+		// Requested lazily allocated memory, see CreateColorResources and CreateDepthResources
+		bool transient;
+	};
+
+	std::array<Attachment, 2> attachments
+	{{
+		{"color", color_image, color_image_memory, true},
+		{"depth", depth_image, depth_image_memory, !depth_pyramid_enabled}
+	}};
+
+	for(const auto& attachment : attachments)
+	{
+		if(attachment.image == VK_NULL_HANDLE)
+		{
+			continue;
+		}
+
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(vulkan_device.logical_device, attachment.image, &requirements);
+		total_size += requirements.size;
+
+		std::cout << " " << attachment.name << " " << ToMiB(requirements.size) << " MiB";
+
+		// Same choice as CreateImage, lazily allocated memory is only committed once a tile actually spills
+		if(attachment.transient &&
+		   vulkan_device.HasMemoryType(requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT))
+		{
+			VkDeviceSize committed = 0;
+			vkGetDeviceMemoryCommitment(vulkan_device.logical_device, attachment.memory, &committed);
+			lazy_size += requirements.size;
+			lazy_committed_size += committed;
+
+			std::cout << " (" << ToMiB(committed) << " MiB committed)";
+		}
+	}
+
+	if(lazy_size > 0)
+	{
+		// Against what the same attachments take without lazy allocation
+		std::cout << ", lazily allocated " << ToMiB(lazy_committed_size) << " of " << ToMiB(lazy_size) << " MiB committed, "
+		          << ToMiB(total_size - lazy_size + lazy_committed_size) << " of " << ToMiB(total_size) << " MiB backed" << std::endl;
+	}
+	else
+	{
+		std::cout << ", " << ToMiB(total_size) << " MiB (no lazily allocated memory)" << std::endl;
+	}
+
+	if(AreAttachmentsAliased())
+	{
+		std::cout << "Attachments in the render graph: " << ToMiB(render_graph.GetTransientSize()) << " MiB of transient images in "
+		          << ToMiB(render_graph.GetAllocatedSize()) << " MiB" << std::endl;
+	}
+}
+
+void vkpg::VulkanSwapChain::OnFramePresented()
+{
+	// Right after allocation nothing has been rendered, so the commitment only means something after a few frames
+	if(++frames_since_attachments == attachment_memory_report_frames)
+	{
+		ReportAttachmentMemory();
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateSceneResources()
+{
+	if(!IsSceneOffscreen())
+	{
+		return;
+	}
+
+	// Allocated at full size, the render area only covers the scaled part of it
+	CreateImage(extent.width, extent.height, 1, VK_SAMPLE_COUNT_1_BIT, image_format, VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, scene_image, scene_image_memory);
+
+	scene_image_view = CreateImageView(scene_image, image_format, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void vkpg::VulkanSwapChain::CreateRenderGraph()
+{
+	if(!dynamic_rendering_enabled && !IsSceneOffscreen())
+	{
+		return;
+	}
+
+	// The acquire semaphore is waited on by the first pass writing it, the UI pass loads the image afterwards
+	VkPipelineStageFlags acquire_stage = IsSceneOffscreen() ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	graph_swap_chain_image = render_graph.ImportImage("swap chain", VK_NULL_HANDLE, VK_NULL_HANDLE, VK_IMAGE_ASPECT_COLOR_BIT,
+	                                                  {VK_IMAGE_LAYOUT_UNDEFINED, acquire_stage, 0},
+	                                                  ImageState{VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+	                                                             VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT});
+
+	auto scene = graph_swap_chain_image;
+	if(IsSceneOffscreen() && !dynamic_rendering_enabled)
+	{
+		// Left by the scene render pass, which is recorded before the graph
+		scene = render_graph.ImportImage("scene", scene_image, scene_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+		                                 {VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		                                  VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT});
+	}
+	else if(IsSceneOffscreen())
+	{
+		// Cleared every frame, the previous frame's FXAA or copy only has to be done reading it
+		VkPipelineStageFlags reader_stage = fxaa_enabled ? VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+		scene = render_graph.ImportImage("scene", scene_image, scene_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+		                                 {VK_IMAGE_LAYOUT_UNDEFINED, reader_stage, 0});
+	}
+
+	if(dynamic_rendering_enabled)
+	{
+		AddScenePass(scene);
+	}
+
+	if(IsSceneOffscreen())
+	{
+		auto source = scene;
+		if(fxaa_enabled)
+		{
+			// Aliases the attachments of the scene pass when the graph owns them
+			graph_fxaa_image = render_graph.CreateImage("fxaa", {VK_FORMAT_R16G16B16A16_SFLOAT, extent});
+
+			auto fxaa = render_graph.AddPass("fxaa", VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, [this](VkCommandBuffer command_buffer)
+			{
+				RecordFxaa(command_buffer, graph_image_index, graph_render_extent);
+			});
+			render_graph.Read(fxaa, scene, ImageUsage::Sampled);
+			render_graph.Write(fxaa, graph_fxaa_image, ImageUsage::StorageWrite);
+
+			source = graph_fxaa_image;
+		}
+
+		auto copy = render_graph.AddPass(dynamic_resolution_enabled ? "upscale" : "copy", VK_PIPELINE_STAGE_TRANSFER_BIT,
+		                                 [this, source](VkCommandBuffer command_buffer)
+		{
+			RecordUpscale(command_buffer, graph_image_index, graph_render_extent, render_graph.GetImage(source));
+		});
+		render_graph.Read(copy, source, ImageUsage::TransferSource);
+		render_graph.Write(copy, graph_swap_chain_image, ImageUsage::TransferDestination);
+	}
+
+	render_graph.Compile();
+
+	if(render_graph.GetTransientSize() > 0)
+	{
+		std::cout << "Render graph: " << static_cast<double>(render_graph.GetTransientSize()) / (1024.0 * 1024.0) << " MiB of transient images in "
+		          << static_cast<double>(render_graph.GetAllocatedSize()) / (1024.0 * 1024.0) << " MiB" << std::endl;
+	}
+}
+
+void vkpg::VulkanSwapChain::AddScenePass(vkpg::RenderGraph::Resource target)
+{
+	graph_scene_target = target;
+	bool multisampled = msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+
+	// Only live inside the pass, so their memory can be reused by the passes after it
+	bool aliased = AreAttachmentsAliased();
+	VkPipelineStageFlags depth_stages = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+	if(multisampled && aliased)
+	{
+		graph_color_image = render_graph.CreateImage("color", {image_format, extent, VK_IMAGE_ASPECT_COLOR_BIT, msaa_samples});
+	}
+	else if(multisampled)
+	{
+		graph_color_image = render_graph.ImportImage("color", color_image, color_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+		                                             {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0});
+	}
+
+	if(depth_pyramid_enabled)
+	{
+		// The depth pyramid is built from it after the graph, and the next frame's clear waits for that
+		graph_depth_image = render_graph.ImportImage("depth", depth_image, depth_image_view, GetDepthAspect(),
+		                                             {VK_IMAGE_LAYOUT_UNDEFINED, depth_stages | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0},
+		                                             ImageState{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                                                        VK_ACCESS_SHADER_READ_BIT});
+	}
+	else if(aliased)
+	{
+		graph_depth_image = render_graph.CreateImage("depth", {depth_format, extent, GetDepthAspect(), msaa_samples});
+	}
+	else
+	{
+		graph_depth_image = render_graph.ImportImage("depth", depth_image, depth_image_view, GetDepthAspect(),
+		                                             {VK_IMAGE_LAYOUT_UNDEFINED, depth_stages, 0});
+	}
+
+	auto scene = render_graph.AddPass("scene", VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+	                                  [this](VkCommandBuffer command_buffer)
+	{
+		BeginScenePass(command_buffer, graph_image_index, graph_render_extent);
+		RecordSceneDraws(command_buffer, graph_image_index, graph_render_extent);
+		EndScenePass(command_buffer);
+	});
+	render_graph.Write(scene, target, ImageUsage::ColorAttachment);
+	if(multisampled)
+	{
+		render_graph.Write(scene, graph_color_image, ImageUsage::ColorAttachment);
+	}
+	render_graph.Write(scene, graph_depth_image, ImageUsage::DepthAttachment);
+
+	if(object_id_enabled)
+	{
+		// Read back by a compute shader after the graph
+		auto object_ids = render_graph.ImportImage("object ids", object_id_image, object_id_image_view, VK_IMAGE_ASPECT_COLOR_BIT,
+		                                           {VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+		                                                                       VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0},
+		                                           ImageState{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		                                                      VK_ACCESS_SHADER_READ_BIT});
+		render_graph.Write(scene, object_ids, ImageUsage::ColorAttachment);
+	}
+}
+
+bool vkpg::VulkanSwapChain::AreAttachmentsAliased() const
+{
+	return dynamic_rendering_enabled &&
+	       !vulkan_device.HasMemoryType(~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+}
+
+void vkpg::VulkanSwapChain::CreateObjectIdResources()
+{
+	if(!object_id_enabled)
+	{
+		return;
+	}
+
+	CreateImage(extent.width, extent.height, 1, msaa_samples, VK_FORMAT_R32_UINT, VK_IMAGE_TILING_OPTIMAL,
+	            VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, object_id_image, object_id_image_memory);
+
+	object_id_image_view = CreateImageView(object_id_image, VK_FORMAT_R32_UINT, VK_IMAGE_ASPECT_COLOR_BIT, 1);
+}
+
+void vkpg::VulkanSwapChain::CreateCaptureResources()
+{
+	if(!capture_usage_supported)
+	{
+		std::cout << "Frame capture: swap chain images can't be copied from, disabled" << std::endl;
+		return;
+	}
+
+	capture.Create(static_cast<uint32_t>(images.size()), extent, image_format);
+}
+
+void vkpg::VulkanSwapChain::CreateFramebuffers()
+{
+	if(dynamic_rendering_enabled)
+	{
+		framebuffers.clear();
+		return;
+	}
+
+	framebuffers.resize(image_views.size());
+
+	for(size_t i = 0; i < image_views.size(); i++)
+	{
+		auto target_view = IsSceneOffscreen() ? scene_image_view : image_views[i];
+
+		// Same order as CreateRenderPass, without MSAA the target is the color attachment and nothing is resolved
+		std::vector<VkImageView> attachments = {color_image_view, depth_image_view, target_view};
+		if(msaa_samples == VK_SAMPLE_COUNT_1_BIT)
+		{
+			attachments = {target_view, depth_image_view};
+		}
+		if(object_id_enabled)
+		{
+			attachments.push_back(object_id_image_view);
+		}
+
+		VkFramebufferCreateInfo framebuffer_info{};
+		framebuffer_info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+		framebuffer_info.renderPass = render_pass;
+		framebuffer_info.attachmentCount = static_cast<uint32_t>(attachments.size());
+		framebuffer_info.pAttachments = attachments.data();
+		framebuffer_info.width = extent.width;
+		framebuffer_info.height = extent.height;
+		framebuffer_info.layers = 1;
+
+		auto result = vkCreateFramebuffer(vulkan_device.logical_device, &framebuffer_info, nullptr, &framebuffers[i]);
+
+		CheckVkResult(result, "Failed to create framebuffer");
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateUiFramebuffers()
+{
+	if(dynamic_rendering_enabled)
+	{
+		ui_framebuffers.clear();
+		return;
+	}
+
 	ui_framebuffers.resize(image_views.size());
 
 	for(size_t i = 0; i < image_views.size(); i++)
@@ -535,78 +1348,47 @@ void vkpg::VulkanSwapChain::CreateUniformBuffers()
 	}
 }
 
-void vkpg::VulkanSwapChain::CreateDescriptorPool()
+void vkpg::VulkanSwapChain::CreateDescriptorAllocators()
 {
-	std::array<VkDescriptorPoolSize, 2> pool_sizes
-	{{
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(images.size())},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(images.size())}
-	}};
+	frame_descriptor_allocators.clear();
+	frame_descriptor_allocators.reserve(images.size());
 
-	VkDescriptorPoolCreateInfo pool_info{};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-	pool_info.pPoolSizes = pool_sizes.data();
-	pool_info.maxSets = std::accumulate(pool_sizes.cbegin(), pool_sizes.cend(), 0, [](int total_size, const VkDescriptorPoolSize& size_entry)
+	for(size_t i = 0; i < images.size(); i++)
 	{
-		return total_size + size_entry.descriptorCount;
-	});
-
-	auto result = vkCreateDescriptorPool(vulkan_device.logical_device, &pool_info, nullptr, &descriptor_pool);
-	CheckVkResult(result, "Failed to create descriptor pool");
+		frame_descriptor_allocators.emplace_back(vulkan_device, 16);
+	}
 }
 
 void vkpg::VulkanSwapChain::CreateUiDescriptorPool()
 {
-//	std::array<VkDescriptorPoolSize, 11> pool_sizes
-//	{{
-//	    {VK_DESCRIPTOR_TYPE_SAMPLER, 1000},
-//	    {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1000},
-//		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1000},
-//		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1000},
-//		{VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1000},
-//		{VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1000},
-//		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1000},
-//		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1000},
-//		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1000},
-//		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1000},
-//		{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1000}
-//	}};
-
-	std::array<VkDescriptorPoolSize, 2> pool_sizes
-	{{
-		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, static_cast<uint32_t>(images.size())},
-		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<uint32_t>(images.size())}
-	}};
-
-	VkDescriptorPoolCreateInfo pool_info{};
-	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
-	pool_info.pPoolSizes = pool_sizes.data();
-	pool_info.maxSets = std::accumulate(pool_sizes.cbegin(), pool_sizes.cend(), 0, [](int total_size, const VkDescriptorPoolSize& size_entry)
+	DescriptorAllocator::PoolSizes pool_sizes =
 	{
-		return total_size + size_entry.descriptorCount;
-	});
+		{VK_DESCRIPTOR_TYPE_SAMPLER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1.0f},
+		{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+		{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+		{VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1.0f}
+	};
 
-	auto result = vkCreateDescriptorPool(vulkan_device.logical_device, &pool_info, nullptr, &ui_descriptor_pool);
-	CheckVkResult(result, "Failed to create descriptor pool");
+	// ImGui allocates and frees its own sets (fonts, user textures), so this pool is not tied to the image count
+	ui_descriptor_pool = DescriptorAllocator::CreatePool(vulkan_device.logical_device, pool_sizes, 256,
+	                                                     VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT);
 }
 
 void vkpg::VulkanSwapChain::CreateDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(images.size(), descriptor_set_layout);
-	VkDescriptorSetAllocateInfo alloc_info{};
-	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	alloc_info.descriptorPool = descriptor_pool;
-	alloc_info.descriptorSetCount = static_cast<uint32_t>(images.size());
-	alloc_info.pSetLayouts = layouts.data();
-
 	descriptor_sets.resize(images.size());
-	auto result = vkAllocateDescriptorSets(vulkan_device.logical_device, &alloc_info, descriptor_sets.data());
-	CheckVkResult(result, "Failed to allocate descriptor sets");
 
 	for(size_t i = 0; i < images.size(); i++)
 	{
+		descriptor_sets[i] = descriptor_allocator.Allocate(descriptor_set_layout);
+
 		VkDescriptorBufferInfo buffer_info{};
 		buffer_info.buffer = uniform_buffers[i];
 		buffer_info.offset = 0;
@@ -635,14 +1417,16 @@ void vkpg::VulkanSwapChain::CreateDescriptorSets()
 		descriptor_writes[1].descriptorCount = 1;
 		descriptor_writes[1].pImageInfo = &image_info;
 
-		vkUpdateDescriptorSets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+		vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
 		                       descriptor_writes.data(), 0, nullptr);
 	}
 }
 
 void vkpg::VulkanSwapChain::CreateCommandBuffers()
 {
-	command_buffers.resize(framebuffers.size());
+	// One per swap chain image, there are no framebuffers to count with dynamic rendering
+	command_buffers.resize(images.size());
+	recorded_render_extents.assign(images.size(), extent);
 
 	VkCommandBufferAllocateInfo alloc_info{};
 	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -652,63 +1436,641 @@ void vkpg::VulkanSwapChain::CreateCommandBuffers()
 
 	auto result = vkAllocateCommandBuffers(vulkan_device.logical_device, &alloc_info, command_buffers.data());
 	CheckVkResult(result, "Failed to allocate command buffers");
+}
+
+void vkpg::VulkanSwapChain::CreateUiCommandBuffers()
+{
+	ui_command_buffers.resize(images.size());
+	VkCommandBufferAllocateInfo ui_alloc_info{};
+	ui_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	ui_alloc_info.commandPool = ui_command_pool;
+	ui_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	ui_alloc_info.commandBufferCount = static_cast<uint32_t>(ui_command_buffers.size());
+
+	auto result = vkAllocateCommandBuffers(vulkan_device.logical_device, &ui_alloc_info, ui_command_buffers.data());
+	CheckVkResult(result, "Failed to allocate ui command buffers");
+}
 
-	// TODO: why is it here?
-	for(size_t i = 0; i < command_buffers.size(); i++)
+void vkpg::VulkanSwapChain::CreateProfiler()
+{
+	profiler.Create(static_cast<uint32_t>(images.size()));
+}
+
+void vkpg::VulkanSwapChain::RecordCommandBuffer(uint32_t image_index)
+{
+	auto command_buffer = command_buffers[image_index];
+	auto render_extent = GetRenderExtent();
+	recorded_render_extents[image_index] = render_extent;
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	auto result = vulkan_device.dispatch.begin_command_buffer(command_buffer, &begin_info);
+	CheckVkResult(result, "Failed to begin recording command buffer");
+
+	profiler.BeginFrame(command_buffer, image_index);
+
+	UpdateMaterialPipelines();
+	const auto& material = GetDrawMaterial();
+
+	bool draw_meshlets = meshlets_enabled && !meshlet_draw_data.empty();
+	if(draw_meshlets)
+	{
+		// The image's previous frame has finished, so its counters are final
+		auto& draw_data = *meshlet_draw_data[image_index];
+		visible_meshlets = draw_data.visible_meshlets;
+		visible_triangles = draw_data.command.indexCount / 3;
+
+		// Host writes are visible to the GPU once the command buffer is submitted
+		draw_data = {};
+		draw_data.command.instanceCount = 1;
+		draw_data.command.firstInstance = bindless_enabled ? material.texture_index : 0;
+
+		// The draw reads the compacted indices and their count
+		VkPipelineStageFlags draw_stages = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT;
+		VkAccessFlags draw_access = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+
+		if(async_compute_enabled)
+		{
+			// Culled on the compute queue, where it can overlap the end of earlier frames, and handed back. The
+			// timestamps stay on the graphics queue, so the pass isn't profiled.
+			std::vector<VkBuffer> results{culled_index_buffers[image_index], meshlet_draw_buffers[image_index]};
+
+			auto compute_buffer = async_compute.Begin(image_index);
+			if(meshlet_results_released[image_index])
+			{
+				async_compute.Acquire(compute_buffer, vkpg::QueueTransfer::GraphicsToCompute, results,
+				                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT);
+			}
+			RecordMeshletCulling(compute_buffer, image_index);
+			async_compute.Release(compute_buffer, vkpg::QueueTransfer::ComputeToGraphics, results,
+			                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_WRITE_BIT);
+			async_compute.Submit(image_index);
+
+			async_compute.Acquire(command_buffer, vkpg::QueueTransfer::ComputeToGraphics, results, draw_stages, draw_access);
+		}
+		else if(!mesh_shader_enabled)
+		{
+			profiler.BeginPass(command_buffer, "cull");
+			RecordMeshletCulling(command_buffer, image_index);
+
+			VkMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			barrier.dstAccessMask = draw_access;
+
+			vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, draw_stages, 0,
+			                                            1, &barrier,
+			                                            0, nullptr,
+			                                            0, nullptr);
+			profiler.EndPass(command_buffer);
+		}
+	}
+
+	if(object_id_enabled && pick_pending[image_index])
+	{
+		// The readback recorded with the image's previous frame has finished
+		picked_object_id = *pick_data[image_index];
+		pick_pending[image_index] = false;
+	}
+
+	if(!dynamic_rendering_enabled)
 	{
-		VkCommandBufferBeginInfo begin_info{};
-		begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		profiler.BeginPass(command_buffer, "scene");
+		BeginScenePass(command_buffer, image_index, render_extent);
+		RecordSceneDraws(command_buffer, image_index, render_extent);
+
+		if(ui_subpass_enabled)
+		{
+			// Draw data from ImGui::Render() of this frame
+			profiler.EndPass(command_buffer);
+			profiler.BeginPass(command_buffer, "ui");
+			vulkan_device.dispatch.cmd_next_subpass(command_buffer, VK_SUBPASS_CONTENTS_INLINE);
+			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), command_buffer);
+		}
+
+		EndScenePass(command_buffer);
+		profiler.EndPass(command_buffer);
+	}
+
+	if(dynamic_rendering_enabled || IsSceneOffscreen())
+	{
+		// With dynamic rendering the scene pass is part of the graph
+		graph_image_index = image_index;
+		graph_render_extent = render_extent;
+		render_graph.SetImportedImage(graph_swap_chain_image, images[image_index], image_views[image_index]);
+		render_graph.Execute(command_buffer, &profiler);
+	}
+
+	if(draw_meshlets && async_compute_enabled)
+	{
+		// Back to the compute queue for the image's next frame, which waits for this one on the host
+		std::vector<VkBuffer> results{culled_index_buffers[image_index], meshlet_draw_buffers[image_index]};
+		async_compute.Release(command_buffer, vkpg::QueueTransfer::GraphicsToCompute, results,
+		                      VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0);
+		meshlet_results_released[image_index] = true;
+	}
+
+	if(depth_pyramid_enabled)
+	{
+		// One series however dynamic resolution resizes it, recorded_render_extents has the size it was built at
+		profiler.BeginPass(command_buffer, "hi-z");
+		depth_pyramid.Record(command_buffer, render_extent, msaa_samples != VK_SAMPLE_COUNT_1_BIT,
+		                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		profiler.EndPass(command_buffer);
+	}
+
+	if(object_id_enabled && requested_pick)
+	{
+		profiler.BeginPass(command_buffer, "pick");
+		RecordObjectIdReadback(command_buffer, image_index, render_extent);
+		profiler.EndPass(command_buffer);
+	}
+
+	if(capture.WantsFrame())
+	{
+		profiler.BeginPass(command_buffer, "capture");
+		// The UI is part of the capture when it is drawn in the same pass
+		capture.Record(command_buffer, image_index, images[image_index],
+		               ui_subpass_enabled ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+		profiler.EndPass(command_buffer);
+	}
+
+	result = vulkan_device.dispatch.end_command_buffer(command_buffer);
+	CheckVkResult(result, "Failed to record command buffer");
+}
+
+void vkpg::VulkanSwapChain::RecordSceneDraws(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent)
+{
+	const auto& material = GetDrawMaterial();
+	bool draw_meshlets = meshlets_enabled && !meshlet_draw_data.empty();
+
+	bool draw_mesh_tasks = draw_meshlets && mesh_shader_enabled;
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_mesh_tasks ? meshlet_pipeline : material.pipeline);
+
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(render_extent.width);
+	viewport.height = static_cast<float>(render_extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vulkan_device.dispatch.cmd_set_viewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = {0, 0};
+	scissor.extent = render_extent;
+	vulkan_device.dispatch.cmd_set_scissor(command_buffer, 0, 1, &scissor);
+
+	pipelines.CmdSetDynamicState(command_buffer, material.pipeline_state);
+
+	if(draw_mesh_tasks)
+	{
+		std::array<VkDescriptorSet, 3> sets{{descriptor_sets[image_index], bindless_descriptor_set, meshlet_descriptor_sets[image_index]}};
+		vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, meshlet_pipeline_layout, 0,
+		                        static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+
+		auto constants = GetMeshletConstants();
+		vulkan_device.dispatch.cmd_push_constants(command_buffer, meshlet_pipeline_layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT,
+		                   0, sizeof(constants), &constants);
+
+		// Every task shader workgroup culls 32 meshlets
+		if(constants.meshlet_count > 0)
+		{
+			vulkan_device.cmd_draw_mesh_tasks(command_buffer, (constants.meshlet_count + 31) / 32, 1, 1);
+		}
+	}
+	else
+	{
+		VkBuffer vertex_buffers[] = {vertex_buffer};
+		VkDeviceSize offsets[] = {0};
+		vulkan_device.dispatch.cmd_bind_vertex_buffers(command_buffer, 0, 1, vertex_buffers, offsets);
+		vulkan_device.dispatch.cmd_bind_index_buffer(command_buffer, draw_meshlets ? culled_index_buffers[image_index] : index_buffer, 0, VK_INDEX_TYPE_UINT32);
+
+		if(bindless_enabled)
+		{
+			std::array<VkDescriptorSet, 2> sets{{descriptor_sets[image_index], bindless_descriptor_set}};
+			vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0,
+			                        static_cast<uint32_t>(sets.size()), sets.data(), 0, nullptr);
+		}
+		else
+		{
+			vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[image_index], 0, nullptr);
+		}
+
+		if(draw_meshlets)
+		{
+			// The culling pass wrote the index count, firstInstance carries the material index
+			vulkan_device.dispatch.cmd_draw_indexed_indirect(command_buffer, meshlet_draw_buffers[image_index], 0, 1, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else if(bindless_enabled)
+		{
+			auto lod_count = std::max<size_t>(lods.size(), 1);
+			auto draw_count = static_cast<uint32_t>(draw_commands.size() / lod_count);
+			auto first_draw = std::min<size_t>(lod_index, lod_count - 1) * draw_count;
+
+			if(vulkan_device.multi_draw_indirect_enabled)
+			{
+				vulkan_device.dispatch.cmd_draw_indexed_indirect(command_buffer, indirect_buffer, first_draw * sizeof(VkDrawIndexedIndirectCommand),
+				                         draw_count, sizeof(VkDrawIndexedIndirectCommand));
+			}
+			else
+			{
+				for(uint32_t draw = 0; draw < draw_count; draw++)
+				{
+					vulkan_device.dispatch.cmd_draw_indexed_indirect(command_buffer, indirect_buffer, (first_draw + draw) * sizeof(VkDrawIndexedIndirectCommand),
+					                         1, sizeof(VkDrawIndexedIndirectCommand));
+				}
+			}
+		}
+		else
+		{
+			auto lod = GetCurrentLod();
+			vulkan_device.dispatch.cmd_draw_indexed(command_buffer, lod.index_count, 1, lod.first_index, 0, 0);
+		}
+	}
+}
+
+void vkpg::VulkanSwapChain::BeginScenePass(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent)
+{
+	if(!dynamic_rendering_enabled)
+	{
+		// The resolve target isn't cleared, its slot is left unused
+		std::array<VkClearValue, 4> clear_values{};
+		clear_values[0].color = {{0.5f, 0.5f, 0.5f, 1.0f}};
+		clear_values[1].depthStencil = {1.0f, 0};
+		clear_values[GetObjectIdAttachment()].color.uint32[0] = 0;
+
+		VkRenderPassBeginInfo render_pass_info{};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = render_pass;
+		render_pass_info.framebuffer = framebuffers[image_index];
+		render_pass_info.renderArea.offset = {0, 0};
+		render_pass_info.renderArea.extent = render_extent;
+		render_pass_info.clearValueCount = object_id_enabled ? GetObjectIdAttachment() + 1 : 2;
+		render_pass_info.pClearValues = clear_values.data();
+
+		vulkan_device.dispatch.cmd_begin_render_pass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	// The render graph moved the attachments into their layouts, which ones it owns depends on the device
+	bool multisampled = msaa_samples != VK_SAMPLE_COUNT_1_BIT;
+	auto target_view = render_graph.GetImageView(graph_scene_target);
+	auto color_view = multisampled ? render_graph.GetImageView(graph_color_image) : VK_NULL_HANDLE;
+	auto depth_view = render_graph.GetImageView(graph_depth_image);
+
+	// Without MSAA the scene is drawn straight into its target and nothing is resolved
+	std::array<VkRenderingAttachmentInfo, 2> color_attachments{};
+	color_attachments[0].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	color_attachments[0].imageView = multisampled ? color_view : target_view;
+	color_attachments[0].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachments[0].resolveMode = multisampled ? VK_RESOLVE_MODE_AVERAGE_BIT : VK_RESOLVE_MODE_NONE;
+	color_attachments[0].resolveImageView = multisampled ? target_view : VK_NULL_HANDLE;
+	color_attachments[0].resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachments[0].storeOp = multisampled ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachments[0].clearValue.color = {{0.5f, 0.5f, 0.5f, 1.0f}};
+
+	// Integers can't be averaged, the object IDs stay multisampled
+	color_attachments[1].sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	color_attachments[1].imageView = object_id_image_view;
+	color_attachments[1].imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachments[1].resolveMode = VK_RESOLVE_MODE_NONE;
+	color_attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	color_attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	color_attachments[1].clearValue.color.uint32[0] = 0;
+
+	VkRenderingAttachmentInfo depth_attachment{};
+	depth_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	depth_attachment.imageView = depth_view;
+	depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+	depth_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+	depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	depth_attachment.storeOp = depth_pyramid_enabled ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	depth_attachment.clearValue.depthStencil = {1.0f, 0};
+
+	VkRenderingInfo rendering_info{};
+	rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	rendering_info.renderArea.offset = {0, 0};
+	rendering_info.renderArea.extent = render_extent;
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = object_id_enabled ? 2 : 1;
+	rendering_info.pColorAttachments = color_attachments.data();
+	rendering_info.pDepthAttachment = &depth_attachment;
+
+	vulkan_device.cmd_begin_rendering(command_buffer, &rendering_info);
+}
+
+void vkpg::VulkanSwapChain::EndScenePass(VkCommandBuffer command_buffer)
+{
+	if(!dynamic_rendering_enabled)
+	{
+		vulkan_device.dispatch.cmd_end_render_pass(command_buffer);
+		return;
+	}
+
+	// The render graph moves the object IDs and depth on to their readers
+	vulkan_device.cmd_end_rendering(command_buffer);
+}
+
+void vkpg::VulkanSwapChain::BeginUiPass(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+	if(!dynamic_rendering_enabled)
+	{
+		VkRenderPassBeginInfo render_pass_info{};
+		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+		render_pass_info.renderPass = ui_render_pass;
+		render_pass_info.framebuffer = ui_framebuffers[image_index];
+		render_pass_info.renderArea.offset = {0, 0};
+		render_pass_info.renderArea.extent = extent;
+
+		vulkan_device.dispatch.cmd_begin_render_pass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+		return;
+	}
+
+	// The UI blends over the scene, or over the render graph's copy of it
+	RecordImageBarriers(command_buffer,
+	{
+		ImageBarrier(images[image_index], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT)
+	});
+
+	VkRenderingAttachmentInfo color_attachment{};
+	color_attachment.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+	color_attachment.imageView = image_views[image_index];
+	color_attachment.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	color_attachment.resolveMode = VK_RESOLVE_MODE_NONE;
+	color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+	color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+
+	VkRenderingInfo rendering_info{};
+	rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+	rendering_info.renderArea.offset = {0, 0};
+	rendering_info.renderArea.extent = extent;
+	rendering_info.layerCount = 1;
+	rendering_info.colorAttachmentCount = 1;
+	rendering_info.pColorAttachments = &color_attachment;
+
+	vulkan_device.cmd_begin_rendering(command_buffer, &rendering_info);
+}
+
+void vkpg::VulkanSwapChain::EndUiPass(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+	if(!dynamic_rendering_enabled)
+	{
+		vulkan_device.dispatch.cmd_end_render_pass(command_buffer);
+		return;
+	}
+
+	vulkan_device.cmd_end_rendering(command_buffer);
+
+	// Presenting waits on the render finished semaphore, which covers all commands
+	RecordImageBarriers(command_buffer,
+	{
+		ImageBarrier(images[image_index], VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		             VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		             VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE)
+	});
+}
+
+void vkpg::VulkanSwapChain::RecordImageBarriers(VkCommandBuffer command_buffer, const std::vector<VkImageMemoryBarrier2>& barriers) const
+{
+	VkDependencyInfo dependency_info{};
+	dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+	dependency_info.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+	dependency_info.pImageMemoryBarriers = barriers.data();
+
+	vulkan_device.cmd_pipeline_barrier2(command_buffer, &dependency_info);
+}
+
+VkFormat vkpg::VulkanSwapChain::GetImageFormat() const
+{
+	return image_format;
+}
+
+vkpg::MeshLod vkpg::VulkanSwapChain::GetCurrentLod() const
+{
+	if(lods.empty())
+	{
+		return {0, static_cast<uint32_t>(indices.size()), 0.0f};
+	}
+
+	return lods[std::min<size_t>(lod_index, lods.size() - 1)];
+}
 
-		result = vkBeginCommandBuffer(command_buffers[i], &begin_info);
-		CheckVkResult(result, "Failed to begin recording command buffer");
+vkpg::MeshletConstants vkpg::VulkanSwapChain::GetMeshletConstants() const
+{
+	const auto& range = meshlet_mesh.lods[std::min<size_t>(lod_index, meshlet_mesh.lods.size() - 1)];
+
+	MeshletConstants constants{};
+	std::copy(meshlet_frustum_planes.begin(), meshlet_frustum_planes.end(), constants.frustum_planes);
+	constants.camera_position = glm::vec4(meshlet_camera_position, 1.0f);
+	constants.first_meshlet = range.first_meshlet;
+	constants.meshlet_count = range.meshlet_count;
+	constants.flags = (meshlet_frustum_culling ? MESHLET_FRUSTUM_CULLING : 0) |
+	                  (meshlet_cone_culling ? MESHLET_CONE_CULLING : 0) |
+	                  (compact_vertices_enabled ? MESHLET_COMPACT_VERTICES : 0);
+	constants.material_index = GetDrawMaterial().texture_index;
+
+	return constants;
+}
 
-		std::array<VkClearValue, 2> clear_values{};
-		clear_values[0].color = {{0.5f, 0.5f, 0.5f, 1.0f}};
-		clear_values[1].depthStencil = {1.0f, 0};
+void vkpg::VulkanSwapChain::RecordMeshletCulling(VkCommandBuffer command_buffer, uint32_t image_index)
+{
+	auto constants = GetMeshletConstants();
 
-		VkRenderPassBeginInfo render_pass_info{};
-		render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		render_pass_info.renderPass = render_pass;
-		render_pass_info.framebuffer = framebuffers[i];
-		render_pass_info.renderArea.offset = {0, 0};
-		render_pass_info.renderArea.extent = extent;
-		render_pass_info.clearValueCount = static_cast<uint32_t>(clear_values.size());
-		render_pass_info.pClearValues = clear_values.data();
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshlet_cull_pipeline);
+	vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshlet_cull_pipeline_layout, 0, 1,
+	                        &meshlet_descriptor_sets[image_index], 0, nullptr);
+	vulkan_device.dispatch.cmd_push_constants(command_buffer, meshlet_cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
 
-		vkCmdBeginRenderPass(command_buffers[i], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	// One workgroup per meshlet, in rows of the smallest maxComputeWorkGroupCount every device supports
+	constexpr uint32_t max_group_count = 65535;
+	if(constants.meshlet_count > 0)
+	{
+		vulkan_device.dispatch.cmd_dispatch(command_buffer, std::min(constants.meshlet_count, max_group_count),
+		              (constants.meshlet_count + max_group_count - 1) / max_group_count, 1);
+	}
+}
 
-		vkCmdBindPipeline(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
+void vkpg::VulkanSwapChain::RecordObjectIdReadback(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent)
+{
+	// Requests are in swap chain pixels, the scene may have been rendered smaller
+	glm::ivec2 pixel(static_cast<uint64_t>(requested_pick->x) * render_extent.width / extent.width,
+	                 static_cast<uint64_t>(requested_pick->y) * render_extent.height / extent.height);
+	pixel = glm::clamp(pixel, glm::ivec2(0), glm::ivec2(render_extent.width - 1, render_extent.height - 1));
+	requested_pick.reset();
+
+	auto descriptor_set = frame_descriptor_allocators[image_index].Allocate(pick_descriptor_set_layout);
+
+	VkDescriptorImageInfo image_info{};
+	image_info.imageView = object_id_image_view;
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo buffer_info{};
+	buffer_info.buffer = pick_buffers[image_index];
+	buffer_info.offset = 0;
+	buffer_info.range = sizeof(uint32_t);
+
+	std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
+
+	descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_writes[0].dstSet = descriptor_set;
+	descriptor_writes[0].dstBinding = 0;
+	descriptor_writes[0].dstArrayElement = 0;
+	descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptor_writes[0].descriptorCount = 1;
+	descriptor_writes[0].pImageInfo = &image_info;
+
+	descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_writes[1].dstSet = descriptor_set;
+	descriptor_writes[1].dstBinding = 1;
+	descriptor_writes[1].dstArrayElement = 0;
+	descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	descriptor_writes[1].descriptorCount = 1;
+	descriptor_writes[1].pBufferInfo = &buffer_info;
+
+	vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+	                       descriptor_writes.data(), 0, nullptr);
+
+	// The ID image is only multisampled with MSAA, which can change at runtime
+	auto pick_pipeline = pipelines.GetComputePipeline(msaa_samples == VK_SAMPLE_COUNT_1_BIT ? "shaders/object_id_readback_single.comp.spv"
+	                                                                                         : "shaders/object_id_readback.comp.spv",
+	                                                  pick_pipeline_layout);
+
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pick_pipeline);
+	vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pick_pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+	vulkan_device.dispatch.cmd_push_constants(command_buffer, pick_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pixel), &pixel);
+	vulkan_device.dispatch.cmd_dispatch(command_buffer, 1, 1, 1);
+
+	// The host reads the result after the frame's fence, which needs the write to be made available to it
+	VkMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+
+	vulkan_device.dispatch.cmd_pipeline_barrier(command_buffer,
+	                     VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0,
+	                     1, &barrier,
+	                     0, nullptr,
+	                     0, nullptr);
 
-		VkBuffer vertex_buffers[] = {vertex_buffer};
-		VkDeviceSize offsets[] = {0};
-		vkCmdBindVertexBuffers(command_buffers[i], 0, 1, vertex_buffers, offsets);
-		vkCmdBindIndexBuffer(command_buffers[i], index_buffer, 0, VK_INDEX_TYPE_UINT32);
-		vkCmdBindDescriptorSets(command_buffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_sets[i], 0, nullptr);
-		vkCmdDrawIndexed(command_buffers[i], static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	pick_pending[image_index] = true;
+}
 
-		vkCmdEndRenderPass(command_buffers[i]);
+void vkpg::VulkanSwapChain::RecordFxaa(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent)
+{
+	// The render graph moves the scene image and the output into these layouts
+	auto descriptor_set = frame_descriptor_allocators[image_index].Allocate(fxaa_descriptor_set_layout);
+
+	VkDescriptorImageInfo scene_info{};
+	scene_info.sampler = fxaa_sampler;
+	scene_info.imageView = scene_image_view;
+	scene_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorImageInfo output_info{};
+	output_info.imageView = render_graph.GetImageView(graph_fxaa_image);
+	output_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	std::array<VkWriteDescriptorSet, 2> descriptor_writes{};
+
+	descriptor_writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_writes[0].dstSet = descriptor_set;
+	descriptor_writes[0].dstBinding = 0;
+	descriptor_writes[0].dstArrayElement = 0;
+	descriptor_writes[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptor_writes[0].descriptorCount = 1;
+	descriptor_writes[0].pImageInfo = &scene_info;
+
+	descriptor_writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_writes[1].dstSet = descriptor_set;
+	descriptor_writes[1].dstBinding = 1;
+	descriptor_writes[1].dstArrayElement = 0;
+	descriptor_writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	descriptor_writes[1].descriptorCount = 1;
+	descriptor_writes[1].pImageInfo = &output_info;
+
+	vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+	                       descriptor_writes.data(), 0, nullptr);
+
+	// Only the rendered part of the scene image is filtered, samples are clamped to it
+	FxaaConstants constants{};
+	constants.inverse_size = glm::vec2(1.0f / static_cast<float>(extent.width), 1.0f / static_cast<float>(extent.height));
+	constants.max_uv = (glm::vec2(render_extent.width, render_extent.height) - 0.5f) * constants.inverse_size;
+	constants.render_size = glm::ivec2(render_extent.width, render_extent.height);
+
+	vulkan_device.dispatch.cmd_bind_pipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, fxaa_pipeline);
+	vulkan_device.dispatch.cmd_bind_descriptor_sets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, fxaa_pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+	vulkan_device.dispatch.cmd_push_constants(command_buffer, fxaa_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants), &constants);
+	vulkan_device.dispatch.cmd_dispatch(command_buffer, (render_extent.width + 7) / 8, (render_extent.height + 7) / 8, 1);
+}
 
-		result = vkEndCommandBuffer(command_buffers[i]);
-		CheckVkResult(result, "Failed to record command buffer");
+VkExtent2D vkpg::VulkanSwapChain::GetRenderExtent() const
+{
+	if(!dynamic_resolution_enabled)
+	{
+		return extent;
 	}
+
+	auto scale = std::clamp(render_scale, 0.1f, 1.0f);
+
+	VkExtent2D render_extent{};
+	render_extent.width = std::max(1u, static_cast<uint32_t>(static_cast<float>(extent.width) * scale));
+	render_extent.height = std::max(1u, static_cast<uint32_t>(static_cast<float>(extent.height) * scale));
+	return render_extent;
 }
 
-void vkpg::VulkanSwapChain::CreateUiCommandBuffers()
+void vkpg::VulkanSwapChain::RecordUpscale(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent, VkImage source)
 {
-	ui_command_buffers.resize(ui_framebuffers.size());
-	VkCommandBufferAllocateInfo ui_alloc_info{};
-	ui_alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	ui_alloc_info.commandPool = ui_command_pool;
-	ui_alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	ui_alloc_info.commandBufferCount = static_cast<uint32_t>(ui_command_buffers.size());
-
-	auto result = vkAllocateCommandBuffers(vulkan_device.logical_device, &ui_alloc_info, ui_command_buffers.data());
-	CheckVkResult(result, "Failed to allocate ui command buffers");
+	// The render graph moves both images into the transfer layouts
+	VkImageBlit blit{};
+	blit.srcOffsets[0] = {0, 0, 0};
+	blit.srcOffsets[1] = {static_cast<int32_t>(render_extent.width), static_cast<int32_t>(render_extent.height), 1};
+	blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.srcSubresource.mipLevel = 0;
+	blit.srcSubresource.baseArrayLayer = 0;
+	blit.srcSubresource.layerCount = 1;
+	blit.dstOffsets[0] = {0, 0, 0};
+	blit.dstOffsets[1] = {static_cast<int32_t>(extent.width), static_cast<int32_t>(extent.height), 1};
+	blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	blit.dstSubresource.mipLevel = 0;
+	blit.dstSubresource.baseArrayLayer = 0;
+	blit.dstSubresource.layerCount = 1;
+
+	vulkan_device.dispatch.cmd_blit_image(command_buffer,
+	               source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+	               images[image_index], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+	               1, &blit,
+	               VK_FILTER_LINEAR);
 }
 
 void vkpg::VulkanSwapChain::CreateVertexBuffer()
 {
-	CreateVkBuffer(vulkan_device, vertices, vertex_buffer, vertex_buffer_memory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	// The mesh shader fetches vertices itself
+	VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+	if(mesh_shader_enabled)
+	{
+		usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+	}
+
+	if(!compact_vertices_enabled)
+	{
+		position_dequantization = glm::mat4(1.0f);
+		CreateVkBuffer(vulkan_device, vertices, vertex_buffer, vertex_buffer_memory, usage);
+		return;
+	}
+
+	auto compact_mesh = CompressVertices(vertices, normals);
+	position_dequantization = compact_mesh.GetDequantizationMatrix();
+
+	std::cout << "Compact vertices: " << vertices.size() << " vertices, "
+	          << vertices.size() * sizeof(Vertex) / 1024 << " KiB -> "
+	          << compact_mesh.vertices.size() * sizeof(CompactVertex) / 1024 << " KiB" << std::endl;
+
+	CreateVkBuffer(vulkan_device, compact_mesh.vertices, vertex_buffer, vertex_buffer_memory, usage);
 }
 
 void vkpg::VulkanSwapChain::CreateIndexBuffer()
@@ -721,6 +2083,7 @@ void vkpg::VulkanSwapChain::CreateCommandPool()
 	VkCommandPoolCreateInfo pool_info{};
 	pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
 	pool_info.queueFamilyIndex = vulkan_device.queue_family_indices.graphics_family.value();
+	pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
 
 	auto result = vkCreateCommandPool(vulkan_device.logical_device, &pool_info, nullptr, &command_pool);
 	CheckVkResult(result, "Failed to create command pool");
@@ -744,7 +2107,12 @@ void vkpg::VulkanSwapChain::CreateDescriptorSetLayout()
 	ubo_layout_binding.descriptorCount = 1;
 	ubo_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
 	ubo_layout_binding.pImmutableSamplers = nullptr;
-	ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	// The fragment shaders read the object ID
+	ubo_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	if(mesh_shader_enabled)
+	{
+		ubo_layout_binding.stageFlags |= VK_SHADER_STAGE_MESH_BIT_EXT;
+	}
 
 	VkDescriptorSetLayoutBinding sampler_layout_binding{};
 	sampler_layout_binding.binding = 1;
@@ -753,14 +2121,12 @@ void vkpg::VulkanSwapChain::CreateDescriptorSetLayout()
 	sampler_layout_binding.pImmutableSamplers = nullptr;
 	sampler_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = {ubo_layout_binding, sampler_layout_binding};
-	VkDescriptorSetLayoutCreateInfo layout_info{};
-	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-	layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
-	layout_info.pBindings = bindings.data();
+	descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout({ubo_layout_binding, sampler_layout_binding});
+}
 
-	auto result = vkCreateDescriptorSetLayout(vulkan_device.logical_device, &layout_info, nullptr, &descriptor_set_layout);
-	CheckVkResult(result, "Failed to create descriptor set layout");
+void vkpg::VulkanSwapChain::CreateMipGenerator()
+{
+	mip_generator.Create();
 }
 
 void vkpg::VulkanSwapChain::CreateTextureImage()
@@ -783,24 +2149,78 @@ void vkpg::VulkanSwapChain::CreateTextureImage()
 	                           staging_buffer, staging_buffer_memory);
 
 	void *data;
-	vkMapMemory(vulkan_device.logical_device, staging_buffer_memory, 0, image_size, 0, &data);
+	vulkan_device.dispatch.map_memory(vulkan_device.logical_device, staging_buffer_memory, 0, image_size, 0, &data);
 	memcpy(data, pixels, static_cast<size_t>(image_size));
-	vkUnmapMemory(vulkan_device.logical_device, staging_buffer_memory);
+	vulkan_device.dispatch.unmap_memory(vulkan_device.logical_device, staging_buffer_memory);
 
 	stbi_image_free(pixels);
 
+	// Generated with compute where the format allows it, the blits are the fallback
+	bool compute_mipmaps = mip_generator.IsSupported(VK_FORMAT_R8G8B8A8_SRGB);
+	VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	VkImageCreateFlags flags = 0;
+	if(compute_mipmaps)
+	{
+		usage |= vkpg::MipGenerator::GetImageUsage();
+		flags |= vkpg::MipGenerator::GetImageFlags(VK_FORMAT_R8G8B8A8_SRGB);
+	}
+
 	CreateImage(tex_width, tex_height, mip_levels, VK_SAMPLE_COUNT_1_BIT, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-	            VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-	            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image, texture_image_memory);
+	            usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, texture_image, texture_image_memory, flags);
+
+	// Level 0 is uploaded, the others are blitted from the level above or written by the mip generator, which takes
+	// level 0 as the upload leaves it
+	uint32_t graph_levels = compute_mipmaps ? 1 : mip_levels;
+	vkpg::ImageState sampled_state{VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT};
+
+	vkpg::RenderGraph upload_graph(vulkan_device);
+	std::vector<vkpg::RenderGraph::Resource> levels;
+	for(uint32_t level = 0; level < graph_levels; level++)
+	{
+		levels.push_back(upload_graph.ImportImageLevel("texture level " + std::to_string(level), texture_image, VK_IMAGE_ASPECT_COLOR_BIT, level,
+		                                               {}, compute_mipmaps ? std::nullopt : std::optional<vkpg::ImageState>(sampled_state)));
+	}
+
+	auto upload = upload_graph.AddPass("upload", VK_PIPELINE_STAGE_TRANSFER_BIT, [&](VkCommandBuffer command_buffer)
+	{
+		CopyBufferToImage(command_buffer, staging_buffer, texture_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height));
+	});
+	upload_graph.Write(upload, levels[0], ImageUsage::TransferDestination);
+
+	if(!compute_mipmaps)
+	{
+		AddMipmapPasses(upload_graph, levels, texture_image, VK_FORMAT_R8G8B8A8_SRGB, tex_width, tex_height);
+	}
+
+	upload_graph.Compile();
+
+	VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
+	upload_graph.Execute(command_buffer);
+
+	std::optional<vkpg::MipGenerator::Target> target;
+	if(compute_mipmaps)
+	{
+		VkExtent2D tex_extent{static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height)};
+		target = mip_generator.CreateTarget(texture_image, VK_FORMAT_R8G8B8A8_SRGB, tex_extent, mip_levels);
+
+		vkpg::ImageState copied_state;
+		copied_state.layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		copied_state.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		copied_state.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+		mip_generator.Record(command_buffer, *target, copied_state, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	}
 
-	TransitionImageLayout(texture_image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mip_levels);
-	CopyBufferToImage(staging_buffer, texture_image, static_cast<uint32_t>(tex_width), static_cast<uint32_t>(tex_height));
-	//transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+	EndSingleTimeCommands(command_pool, command_buffer);
+
+	if(target)
+	{
+		mip_generator.DestroyTarget(*target);
+	}
+	upload_graph.Cleanup();
 
 	vkDestroyBuffer(vulkan_device.logical_device, staging_buffer, nullptr);
 	vkFreeMemory(vulkan_device.logical_device, staging_buffer_memory, nullptr);
-
-	GenerateMipmaps(texture_image, VK_FORMAT_R8G8B8A8_SRGB, tex_width, tex_height, mip_levels);
 }
 
 void vkpg::VulkanSwapChain::CreateTextureImageView()
@@ -831,6 +2251,359 @@ void vkpg::VulkanSwapChain::CreateTextureSampler()
 	CheckVkResult(result, "Failed to create texture sampler");
 }
 
+void vkpg::VulkanSwapChain::CreateBindlessDescriptorSetLayout()
+{
+	if(!bindless_enabled)
+	{
+		return;
+	}
+
+	VkPhysicalDeviceProperties physical_device_properties;
+	vkGetPhysicalDeviceProperties(vulkan_device.physical_device, &physical_device_properties);
+	const auto& limits = physical_device_properties.limits;
+
+	// Set 0 already holds one combined image sampler for the fragment stage
+	bindless_texture_capacity = std::min({MAX_BINDLESS_TEXTURES,
+	                                      limits.maxPerStageDescriptorSamplers - 1,
+	                                      limits.maxPerStageDescriptorSampledImages - 1,
+	                                      limits.maxDescriptorSetSamplers - 1,
+	                                      limits.maxDescriptorSetSampledImages - 1});
+
+	VkDescriptorSetLayoutBinding textures_layout_binding{};
+	textures_layout_binding.binding = 0;
+	textures_layout_binding.descriptorCount = bindless_texture_capacity;
+	textures_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	textures_layout_binding.pImmutableSamplers = nullptr;
+	textures_layout_binding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	VkDescriptorBindingFlags binding_flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
+
+	bindless_descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout({textures_layout_binding},
+	                                                                                   VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT,
+	                                                                                   {binding_flags});
+}
+
+void vkpg::VulkanSwapChain::CreateBindlessDescriptorPool()
+{
+	if(!bindless_enabled)
+	{
+		return;
+	}
+
+	DescriptorAllocator::PoolSizes pool_sizes{{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, static_cast<float>(bindless_texture_capacity)}};
+
+	bindless_descriptor_pool = DescriptorAllocator::CreatePool(vulkan_device.logical_device, pool_sizes, 1,
+	                                                           VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT);
+}
+
+void vkpg::VulkanSwapChain::CreateBindlessDescriptorSet()
+{
+	if(!bindless_enabled)
+	{
+		return;
+	}
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = bindless_descriptor_pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &bindless_descriptor_set_layout;
+
+	auto result = vulkan_device.dispatch.allocate_descriptor_sets(vulkan_device.logical_device, &alloc_info, &bindless_descriptor_set);
+	CheckVkResult(result, "Failed to allocate bindless descriptor set");
+
+	bindless_texture_count = 0;
+	texture_material_index = RegisterBindlessTexture(texture_image_view, texture_sampler);
+
+	// There is only the model's texture, the materials differ in their pipeline state
+	for(auto& material : materials)
+	{
+		material.texture_index = texture_material_index;
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateIndirectBuffer()
+{
+	if(!bindless_enabled)
+	{
+		return;
+	}
+
+	if(draw_commands.empty())
+	{
+		std::vector<MeshLod> mesh_lods = lods;
+		if(mesh_lods.empty())
+		{
+			mesh_lods.push_back({0, static_cast<uint32_t>(indices.size()), 0.0f});
+		}
+
+		for(const auto& lod : mesh_lods)
+		{
+			VkDrawIndexedIndirectCommand draw_command{};
+			draw_command.indexCount = lod.index_count;
+			draw_command.instanceCount = 1;
+			draw_command.firstIndex = lod.first_index;
+			draw_command.vertexOffset = 0;
+			draw_command.firstInstance = texture_material_index;
+			draw_commands.push_back(draw_command);
+		}
+	}
+
+	CreateVkBuffer(vulkan_device, draw_commands, indirect_buffer, indirect_buffer_memory, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT);
+}
+
+void vkpg::VulkanSwapChain::CreateAsyncCompute()
+{
+	if(async_compute_enabled)
+	{
+		async_compute.Create(static_cast<uint32_t>(images.size()));
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateMeshletResources()
+{
+	if(!meshlets_enabled || meshlet_mesh.meshlets.empty())
+	{
+		return;
+	}
+
+	CreateVkBuffer(vulkan_device, meshlet_mesh.meshlets, meshlet_buffer, meshlet_buffer_memory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	CreateVkBuffer(vulkan_device, meshlet_mesh.vertices, meshlet_vertex_buffer, meshlet_vertex_buffer_memory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	CreateVkBuffer(vulkan_device, meshlet_mesh.triangles, meshlet_triangle_buffer, meshlet_triangle_buffer_memory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	if(async_compute_enabled)
+	{
+		// Only the culling pass reads them, so they move to the compute queue for good. Both halves wait for their
+		// queue to be idle, which orders the release before the acquire.
+		std::vector<VkBuffer> buffers{meshlet_buffer, meshlet_vertex_buffer, meshlet_triangle_buffer};
+
+		auto command_buffer = BeginSingleTimeCommands(command_pool);
+		async_compute.Release(command_buffer, vkpg::QueueTransfer::GraphicsToCompute, buffers,
+		                      VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_WRITE_BIT);
+		EndSingleTimeCommands(command_pool, command_buffer);
+
+		async_compute.RunOnce([&](VkCommandBuffer compute_buffer)
+		{
+			async_compute.Acquire(compute_buffer, vkpg::QueueTransfer::GraphicsToCompute, buffers,
+			                      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+		});
+	}
+
+	// Room for every triangle of the largest LOD, in case nothing is culled
+	VkDeviceSize culled_index_buffer_size = sizeof(uint32_t) * 3 * meshlet_mesh.GetMaxTriangleCount();
+
+	culled_index_buffers.resize(images.size(), VK_NULL_HANDLE);
+	culled_index_buffers_memory.resize(images.size(), VK_NULL_HANDLE);
+	meshlet_draw_buffers.resize(images.size());
+	meshlet_draw_buffers_memory.resize(images.size());
+	meshlet_draw_data.resize(images.size());
+	meshlet_descriptor_sets.resize(images.size());
+	meshlet_results_released.assign(images.size(), false);
+
+	for(size_t i = 0; i < images.size(); i++)
+	{
+		if(!mesh_shader_enabled)
+		{
+			vulkan_device.CreateBuffer(culled_index_buffer_size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, culled_index_buffers[i], culled_index_buffers_memory[i]);
+		}
+
+		// Reset by the host before every frame and read back afterwards, so it stays mapped
+		vulkan_device.CreateBuffer(sizeof(MeshletDrawData), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                           meshlet_draw_buffers[i], meshlet_draw_buffers_memory[i]);
+
+		void *data;
+		vulkan_device.dispatch.map_memory(vulkan_device.logical_device, meshlet_draw_buffers_memory[i], 0, sizeof(MeshletDrawData), 0, &data);
+		meshlet_draw_data[i] = static_cast<MeshletDrawData*>(data);
+		*meshlet_draw_data[i] = {};
+
+		meshlet_descriptor_sets[i] = descriptor_allocator.Allocate(meshlet_descriptor_set_layout);
+
+		std::array<VkDescriptorBufferInfo, 6> buffer_infos{};
+		buffer_infos[0] = {meshlet_buffer, 0, VK_WHOLE_SIZE};
+		buffer_infos[1] = {meshlet_vertex_buffer, 0, VK_WHOLE_SIZE};
+		buffer_infos[2] = {meshlet_triangle_buffer, 0, VK_WHOLE_SIZE};
+		buffer_infos[3] = {vertex_buffer, 0, VK_WHOLE_SIZE};
+		buffer_infos[4] = {culled_index_buffers[i], 0, VK_WHOLE_SIZE};
+		buffer_infos[5] = {meshlet_draw_buffers[i], 0, VK_WHOLE_SIZE};
+
+		// Each path leaves the binding it doesn't use empty
+		std::vector<VkWriteDescriptorSet> descriptor_writes;
+		for(uint32_t binding = 0; binding < buffer_infos.size(); binding++)
+		{
+			if((binding == 3 && !mesh_shader_enabled) || (binding == 4 && mesh_shader_enabled))
+			{
+				continue;
+			}
+
+			VkWriteDescriptorSet descriptor_write{};
+			descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			descriptor_write.dstSet = meshlet_descriptor_sets[i];
+			descriptor_write.dstBinding = binding;
+			descriptor_write.dstArrayElement = 0;
+			descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			descriptor_write.descriptorCount = 1;
+			descriptor_write.pBufferInfo = &buffer_infos[binding];
+			descriptor_writes.push_back(descriptor_write);
+		}
+
+		vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, static_cast<uint32_t>(descriptor_writes.size()),
+		                       descriptor_writes.data(), 0, nullptr);
+	}
+}
+
+void vkpg::VulkanSwapChain::CreatePickResources()
+{
+	if(!object_id_enabled)
+	{
+		return;
+	}
+
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	bindings[0].pImmutableSamplers = nullptr;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].pImmutableSamplers = nullptr;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	pick_descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(glm::ivec2);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &pick_descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &pick_pipeline_layout);
+	CheckVkResult(result, "Failed to create pick pipeline layout");
+
+	pick_buffers.resize(images.size());
+	pick_buffers_memory.resize(images.size());
+	pick_data.resize(images.size());
+	pick_pending.assign(images.size(), false);
+
+	for(size_t i = 0; i < images.size(); i++)
+	{
+		vulkan_device.CreateBuffer(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		                           pick_buffers[i], pick_buffers_memory[i]);
+
+		void *data;
+		vulkan_device.dispatch.map_memory(vulkan_device.logical_device, pick_buffers_memory[i], 0, sizeof(uint32_t), 0, &data);
+		pick_data[i] = static_cast<uint32_t*>(data);
+	}
+}
+
+void vkpg::VulkanSwapChain::CreateFxaaPipeline()
+{
+	// Always created, so FXAA can be turned on at runtime
+	std::vector<VkDescriptorSetLayoutBinding> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].descriptorCount = 1;
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].pImmutableSamplers = nullptr;
+	bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	bindings[1].binding = 1;
+	bindings[1].descriptorCount = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	bindings[1].pImmutableSamplers = nullptr;
+	bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	fxaa_descriptor_set_layout = descriptor_layout_cache.CreateDescriptorSetLayout(bindings);
+
+	VkPushConstantRange push_constant_range{};
+	push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	push_constant_range.offset = 0;
+	push_constant_range.size = sizeof(FxaaConstants);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &fxaa_descriptor_set_layout;
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &push_constant_range;
+
+	auto result = vkCreatePipelineLayout(vulkan_device.logical_device, &pipeline_layout_info, nullptr, &fxaa_pipeline_layout);
+	CheckVkResult(result, "Failed to create FXAA pipeline layout");
+
+	fxaa_pipeline = pipelines.GetComputePipeline("shaders/fxaa.comp.spv", fxaa_pipeline_layout);
+
+	// Edge searches step outside the image, those samples repeat the border instead of wrapping around
+	VkSamplerCreateInfo sampler_info{};
+	sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	sampler_info.magFilter = VK_FILTER_LINEAR;
+	sampler_info.minFilter = VK_FILTER_LINEAR;
+	sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	sampler_info.maxLod = 0.0f;
+
+	result = vkCreateSampler(vulkan_device.logical_device, &sampler_info, nullptr, &fxaa_sampler);
+	CheckVkResult(result, "Failed to create FXAA sampler");
+}
+
+void vkpg::VulkanSwapChain::RequestObjectId(uint32_t x, uint32_t y)
+{
+	if(object_id_enabled)
+	{
+		requested_pick = VkOffset2D{static_cast<int32_t>(x), static_cast<int32_t>(y)};
+	}
+}
+
+std::optional<uint32_t> vkpg::VulkanSwapChain::TakeObjectId()
+{
+	auto object_id = picked_object_id;
+	picked_object_id.reset();
+	return object_id;
+}
+
+uint32_t vkpg::VulkanSwapChain::RegisterBindlessTexture(VkImageView image_view, VkSampler sampler)
+{
+	if(bindless_texture_count >= bindless_texture_capacity)
+	{
+		throw std::runtime_error("Bindless texture table is full (" + std::to_string(bindless_texture_capacity) + " textures)");
+	}
+
+	uint32_t index = bindless_texture_count++;
+
+	VkDescriptorImageInfo image_info{};
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_info.imageView = image_view;
+	image_info.sampler = sampler;
+
+	// The set is update-after-bind, so it can be written while recorded command buffers still reference it
+	VkWriteDescriptorSet descriptor_write{};
+	descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptor_write.dstSet = bindless_descriptor_set;
+	descriptor_write.dstBinding = 0;
+	descriptor_write.dstArrayElement = index;
+	descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	descriptor_write.descriptorCount = 1;
+	descriptor_write.pImageInfo = &image_info;
+
+	vulkan_device.dispatch.update_descriptor_sets(vulkan_device.logical_device, 1, &descriptor_write, 0, nullptr);
+
+	return index;
+}
+
+void vkpg::VulkanSwapChain::ResetFrameDescriptors(uint32_t image_index)
+{
+	frame_descriptor_allocators[image_index].ResetPools();
+}
+
 vkpg::VulkanSwapChain::SwapChainSupportDetails vkpg::VulkanSwapChain::QuerySwapChainSupport(VkPhysicalDevice device)
 {
 	SwapChainSupportDetails details;
@@ -903,20 +2676,6 @@ VkExtent2D vkpg::VulkanSwapChain::ChooseSwapExtent(const VkSurfaceCapabilitiesKH
 	return actual_extent;
 }
 
-VkShaderModule vkpg::VulkanSwapChain::CreateShaderModule(const std::vector<char>& code)
-{
-	VkShaderModuleCreateInfo create_info{};
-	create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-	create_info.codeSize = code.size();
-	create_info.pCode = reinterpret_cast<const uint32_t*>(code.data());
-
-	VkShaderModule shader_module;
-	auto result = vkCreateShaderModule(vulkan_device.logical_device, &create_info, nullptr, &shader_module);
-	CheckVkResult(result, "Failed to create shader module");
-
-	return shader_module;
-}
-
 VkFormat vkpg::VulkanSwapChain::FindSupportedFormat(const std::vector<VkFormat>& candidates,
                                                     VkImageTiling tiling, VkFormatFeatureFlags features)
 {
@@ -964,10 +2723,12 @@ VkImageView vkpg::VulkanSwapChain::CreateImageView(VkImage image, VkFormat forma
 
 void vkpg::VulkanSwapChain::CreateImage(uint32_t width, uint32_t height, uint32_t mip_levels, VkSampleCountFlagBits num_samples,
                                         VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage,
-                                        VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory)
+                                        VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory,
+                                        VkImageCreateFlags flags)
 {
 	VkImageCreateInfo image_info{};
 	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.flags = flags;
 	image_info.imageType = VK_IMAGE_TYPE_2D;
 	image_info.extent.width = width;
 	image_info.extent.height = height;
@@ -987,6 +2748,13 @@ void vkpg::VulkanSwapChain::CreateImage(uint32_t width, uint32_t height, uint32_
 	VkMemoryRequirements mem_requirements;
 	vkGetImageMemoryRequirements(vulkan_device.logical_device, image, &mem_requirements);
 
+	// Lazily allocated memory is only a hint, desktop GPUs don't have it and get plain device local memory
+	if((properties & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) &&
+	   !vulkan_device.HasMemoryType(mem_requirements.memoryTypeBits, properties))
+	{
+		properties &= ~VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
+	}
+
 	VkMemoryAllocateInfo alloc_info{};
 	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
 	alloc_info.allocationSize = mem_requirements.size;
@@ -1013,22 +2781,22 @@ VkCommandBuffer vkpg::VulkanSwapChain::BeginSingleTimeCommands(VkCommandPool poo
 	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 
-	vkBeginCommandBuffer(command_buffer, &begin_info);
+	vulkan_device.dispatch.begin_command_buffer(command_buffer, &begin_info);
 
 	return command_buffer;
 }
 
 void vkpg::VulkanSwapChain::EndSingleTimeCommands(VkCommandPool pool, VkCommandBuffer command_buffer)
 {
-	vkEndCommandBuffer(command_buffer);
+	vulkan_device.dispatch.end_command_buffer(command_buffer);
 
 	VkSubmitInfo submit_info{};
 	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submit_info.commandBufferCount = 1;
 	submit_info.pCommandBuffers = &command_buffer;
 
-	vkQueueSubmit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
-	vkQueueWaitIdle(graphics_queue);
+	vulkan_device.dispatch.queue_submit(graphics_queue, 1, &submit_info, VK_NULL_HANDLE);
+	vulkan_device.dispatch.queue_wait_idle(graphics_queue);
 
 	vkFreeCommandBuffers(vulkan_device.logical_device, pool, 1, &command_buffer);
 }
@@ -1039,63 +2807,13 @@ void vkpg::VulkanSwapChain::CopyBuffer(VkBuffer source, VkBuffer destination, Vk
 
 	VkBufferCopy copyRegion{};
 	copyRegion.size = size;
-	vkCmdCopyBuffer(command_buffer, source, destination, 1, &copyRegion);
-
-	EndSingleTimeCommands(command_pool, command_buffer);
-}
-
-void vkpg::VulkanSwapChain::TransitionImageLayout(VkImage image, VkImageLayout old_layout,
-                                                  VkImageLayout new_layout, uint32_t mip_levels)
-{
-	VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = old_layout;
-	barrier.newLayout = new_layout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = mip_levels;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags source_stage;
-	VkPipelineStageFlags destination_stage;
-
-	if(old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if(old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-			new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else
-	{
-		throw std::invalid_argument("Unsupported layout transition");
-	}
-
-	vkCmdPipelineBarrier(command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	vulkan_device.dispatch.cmd_copy_buffer(command_buffer, source, destination, 1, &copyRegion);
 
 	EndSingleTimeCommands(command_pool, command_buffer);
 }
 
-void vkpg::VulkanSwapChain::CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void vkpg::VulkanSwapChain::CopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
 {
-	VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
-
 	VkBufferImageCopy region{};
 	region.bufferOffset = 0;
 	region.bufferRowLength = 0;
@@ -1107,13 +2825,11 @@ void vkpg::VulkanSwapChain::CopyBufferToImage(VkBuffer buffer, VkImage image, ui
 	region.imageOffset = {0, 0, 0};
 	region.imageExtent = {width, height, 1};
 
-	vkCmdCopyBufferToImage(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	EndSingleTimeCommands(command_pool, command_buffer);
+	vulkan_device.dispatch.cmd_copy_buffer_to_image(command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
 }
 
-void vkpg::VulkanSwapChain::GenerateMipmaps(VkImage image, VkFormat image_format,
-                                            int32_t tex_width, int32_t tex_height, uint32_t mip_levels)
+void vkpg::VulkanSwapChain::AddMipmapPasses(vkpg::RenderGraph& graph, const std::vector<vkpg::RenderGraph::Resource>& levels, VkImage image,
+                                            VkFormat image_format, int32_t tex_width, int32_t tex_height)
 {
 	// Check if image format supports linear blitting
 	VkFormatProperties format_properties;
@@ -1124,35 +2840,11 @@ void vkpg::VulkanSwapChain::GenerateMipmaps(VkImage image, VkFormat image_format
 		throw std::runtime_error("texture image format does not support linear blitting");
 	}
 
-	VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
-
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.image = image;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-	barrier.subresourceRange.levelCount = 1;
-
 	int32_t mip_width = tex_width;
 	int32_t mip_height = tex_height;
 
-	for(uint32_t i = 1; i < mip_levels; i++)
+	for(uint32_t i = 1; i < levels.size(); i++)
 	{
-		barrier.subresourceRange.baseMipLevel = i - 1;
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-
-		vkCmdPipelineBarrier(command_buffer,
-		                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-		                     0, nullptr,
-		                     0, nullptr,
-		                     1, &barrier);
-
 		VkImageBlit blit{};
 		blit.srcOffsets[0] = {0, 0, 0};
 		blit.srcOffsets[1] = {mip_width, mip_height, 1};
@@ -1167,38 +2859,19 @@ void vkpg::VulkanSwapChain::GenerateMipmaps(VkImage image, VkFormat image_format
 		blit.dstSubresource.baseArrayLayer = 0;
 		blit.dstSubresource.layerCount = 1;
 
-		vkCmdBlitImage(command_buffer,
-		               image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-		               image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		               1, &blit,
-		               VK_FILTER_LINEAR);
-
-		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		vkCmdPipelineBarrier(command_buffer,
-		                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-		                     0, nullptr,
-		                     0, nullptr,
-		                     1, &barrier);
+		// The graph moves the level above into the transfer source layout once it is written
+		auto pass = graph.AddPass("mip " + std::to_string(i), VK_PIPELINE_STAGE_TRANSFER_BIT, [this, image, blit](VkCommandBuffer command_buffer)
+		{
+			vulkan_device.dispatch.cmd_blit_image(command_buffer,
+			               image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+			               image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			               1, &blit,
+			               VK_FILTER_LINEAR);
+		});
+		graph.Read(pass, levels[i - 1], ImageUsage::TransferSource);
+		graph.Write(pass, levels[i], ImageUsage::TransferDestination);
 
 		if(mip_width > 1) mip_width /= 2;
 		if(mip_height > 1) mip_height /= 2;
 	}
-
-	barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-	vkCmdPipelineBarrier(command_buffer,
-	                     VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-	                     0, nullptr,
-	                     0, nullptr,
-	                     1, &barrier);
-
-	EndSingleTimeCommands(command_pool, command_buffer);
 }
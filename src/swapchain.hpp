@@ -1,6 +1,17 @@
 #pragma once
 
+#include "async_compute.hpp"
+#include "capture.hpp"
+#include "depth_pyramid.hpp"
+#include "descriptors.hpp"
 #include "device.hpp"
+#include "mesh_simplifier.hpp"
+#include "meshlet.hpp"
+#include "mip_generator.hpp"
+#include "pipeline.hpp"
+#include "profiler.hpp"
+#include "render_graph.hpp"
+#include "vertex.hpp"
 #include "window.hpp"
 
 #include <vulkan/vulkan.h>
@@ -8,6 +19,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/hash.hpp>
 
+#include <array>
+#include <optional>
 #include <vector>
 #include <cstring>
 
@@ -19,65 +32,30 @@ struct UniformBufferObject
 	glm::mat4 model;
 	glm::mat4 view;
 	glm::mat4 projection;
+	// Written into the object ID attachment, 0 is left for the background
+	uint32_t object_id;
 };
 
-struct Vertex
+// Push constants of fxaa.comp
+struct FxaaConstants
 {
-	glm::vec3 position;
-	glm::vec3 color;
-	glm::vec2 texture_coordinates;
-
-	static VkVertexInputBindingDescription GetBindingDescription()
-	{
-		VkVertexInputBindingDescription binding_description{};
-		binding_description.binding = 0;
-		binding_description.stride = sizeof(Vertex);
-		binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-		return binding_description;
-	}
-
-	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
-
-		attribute_descriptions[0].binding = 0;
-		attribute_descriptions[0].location = 0;
-		attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attribute_descriptions[0].offset = offsetof(Vertex, position);
-
-		attribute_descriptions[1].binding = 0;
-		attribute_descriptions[1].location = 1;
-		attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attribute_descriptions[1].offset = offsetof(Vertex, color);
-
-		attribute_descriptions[2].binding = 0;
-		attribute_descriptions[2].location = 2;
-		attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attribute_descriptions[2].offset = offsetof(Vertex, texture_coordinates);
-
-		return attribute_descriptions;
-	}
-
-	bool operator==(const Vertex& other) const
-	{
-		return position == other.position && color == other.color && texture_coordinates == other.texture_coordinates;
-	}
+	glm::vec2 inverse_size;
+	// Center of the last texel of the rendered part of the scene image
+	glm::vec2 max_uv;
+	glm::ivec2 render_size;
 };
 
-} // namespace vkpg
-
-namespace std {
-template<> struct hash<vkpg::Vertex>
-	{
-		size_t operator()(vkpg::Vertex const& vertex) const
-		{
-			return ((hash<glm::vec3>()(vertex.position) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texture_coordinates) << 1);
-		}
-	};
-} // namespace std
-
-namespace vkpg
+// Anti-aliasing tier, see VulkanSwapChain::SetAntiAliasing
+struct AntiAliasing
 {
+	// Lowered to what the device supports, 1 renders straight into the target without a resolve
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_4_BIT;
+	// Shades a fraction of the samples of a pixel instead of once per pixel, only does something with MSAA
+	bool sample_shading = false;
+	// Runs FXAA in a compute pass over the scene before it is copied into the swap chain image
+	bool fxaa = false;
+};
+
 class VulkanSwapChain
 {
 private:
@@ -93,18 +71,28 @@ public:
 	void Create();
 	void Cleanup();
 
+	// Size dependent objects: swap chain, its image views, attachments, framebuffers and command buffers
+	void CleanupSwapChain();
+	// Everything else, only rebuilt when the surface format or image count changes
+	void CleanupResources();
+
 	void Recreate();
 
 	void CreateImageViews();
 	void CreateRenderPass();
 	void CreateUiRenderPass();
+	void CreatePipelineCache();
+	void DestroyPipelineCache();
 	void CreateGraphicsPipeline();
+	// Before CreateDepthResources, which builds the pyramid's images for the depth attachment
+	void CreateDepthPyramid();
 	void CreateColorResources();
 	void CreateDepthResources();
+	void CreateSceneResources();
 	void CreateFramebuffers();
 	void CreateUiFramebuffers();
 	void CreateUniformBuffers();
-	void CreateDescriptorPool();
+	void CreateDescriptorAllocators();
 	void CreateUiDescriptorPool();
 	void CreateDescriptorSets();
 	void CreateCommandBuffers();
@@ -114,32 +102,86 @@ public:
 	void CreateCommandPool();
 	void CreateUiCommandPool();
 	void CreateDescriptorSetLayout();
+	// Before CreateTextureImage, falls back to blits for formats it can't write
+	void CreateMipGenerator();
 	void CreateTextureImage();
 	void CreateTextureImageView();
 	void CreateTextureSampler();
+	void CreateBindlessDescriptorSetLayout();
+	void CreateBindlessDescriptorPool();
+	void CreateBindlessDescriptorSet();
+	void CreateIndirectBuffer();
+	void CreateMeshletPipelines();
+	// Before CreateMeshletResources, which hands the culling inputs to the compute queue
+	void CreateAsyncCompute();
+	void CreateMeshletResources();
+	// Prints the size of the multisampled color and depth attachments and how much of the lazily allocated ones
+	// is actually backed. That is only known once frames have been rendered, OnFramePresented calls it after a
+	// few of them and the GPU window on demand.
+	void ReportAttachmentMemory() const;
+	void OnFramePresented();
+	void CreateObjectIdResources();
+	void CreateCaptureResources();
+	void CreatePickResources();
+	void CreateFxaaPipeline();
+	// Declares the scene pass with dynamic rendering and the passes after it, after the scene resources are created
+	void CreateRenderGraph();
+	void CreateProfiler();
+
+	// Switches the tier at runtime. Waits for the device and rebuilds the render pass, the scene pipelines and the
+	// attachments, the swap chain itself is kept. The sample count stays fixed while the UI is drawn in a subpass.
+	void SetAntiAliasing(const vkpg::AntiAliasing& settings);
+
+	// The scene is rendered into scene_image and copied into the swap chain image afterwards
+	bool IsSceneOffscreen() const;
+
+	// Records the scene for an image, call once its previous frame has finished
+	void RecordCommandBuffer(uint32_t image_index);
+
+	// Around the UI draws when they aren't recorded in the scene's subpass, the image is left ready to present
+	void BeginUiPass(VkCommandBuffer command_buffer, uint32_t image_index);
+	void EndUiPass(VkCommandBuffer command_buffer, uint32_t image_index);
+
+	VkFormat GetImageFormat() const;
+
+	// Size the scene is rendered at, smaller than extent when dynamic resolution scales it down
+	VkExtent2D GetRenderExtent() const;
+
+	uint32_t RegisterBindlessTexture(VkImageView image_view, VkSampler sampler);
+
+	// Releases the transient descriptor sets of an image, call once its previous frame has finished
+	void ResetFrameDescriptors(uint32_t image_index);
+
+	// Reads the object ID at a pixel of the swap chain image with the next recorded frame. The result is there once
+	// that image is recorded again, so picking never waits for the GPU. A newer request replaces a pending one.
+	void RequestObjectId(uint32_t x, uint32_t y);
+	// The last finished request, empty until one finishes and after it was taken
+	std::optional<uint32_t> TakeObjectId();
 
 	SwapChainSupportDetails QuerySwapChainSupport(VkPhysicalDevice device);
 	VkSurfaceFormatKHR ChooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
 	VkPresentModeKHR ChooseSwapPresentMode(const std::vector<VkPresentModeKHR>& available_present_modes);
 	VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
 
-	VkShaderModule CreateShaderModule(const std::vector<char>& code);
 	VkFormat FindSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat FindDepthFormat();
 
 	VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, int32_t mip_levels);
 	void CreateImage(uint32_t width, uint32_t height, uint32_t mip_levels, VkSampleCountFlagBits num_samples, VkFormat format, VkImageTiling tiling,
-	                 VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory);
+	                 VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& image_memory,
+	                 VkImageCreateFlags flags = 0);
 
 	VkCommandBuffer BeginSingleTimeCommands(VkCommandPool pool);
 	void EndSingleTimeCommands(VkCommandPool pool, VkCommandBuffer command_buffer);
 
 	void CopyBuffer(VkBuffer source, VkBuffer destination, VkDeviceSize size);
 
-	void TransitionImageLayout(VkImage image, VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels);
-	void CopyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+	// Into level 0, which has to be in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
+	void CopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
 
-	void GenerateMipmaps(VkImage image, VkFormat image_format, int32_t tex_width, int32_t tex_height, uint32_t mip_levels);
+	// A blit per level after the first, each reads the level above. levels are the image's levels imported one by one.
+	void AddMipmapPasses(vkpg::RenderGraph& graph, const std::vector<vkpg::RenderGraph::Resource>& levels, VkImage image,
+	                     VkFormat image_format, int32_t tex_width, int32_t tex_height);
 
 	VkSwapchainKHR swap_chain;
 
@@ -154,23 +196,108 @@ public:
 
 	std::vector<Vertex> vertices;
 	std::vector<uint32_t> indices;
+	// One per vertex, kept on the CPU for the compact format, the full one doesn't upload them
+	std::vector<glm::vec3> normals;
+
+	// Index ranges of the mesh LODs, empty means a single LOD over all indices. lod_index is drawn.
+	std::vector<vkpg::MeshLod> lods;
+	uint32_t lod_index = 0;
+
+	// Uploads vertices as CompactVertex, has to be set before the pipeline and vertex buffer are created
+	bool compact_vertices_enabled = false;
+	// Multiplied in front of the model matrix, undoes the position quantization of compact vertices
+	glm::mat4 position_dequantization{1.0f};
+
+	// With bindless textures every draw goes through one indirect call, firstInstance carries the material index.
+	// The commands are grouped by LOD, every LOD has the same number of draws.
+	bool bindless_enabled = false;
+	std::vector<VkDrawIndexedIndirectCommand> draw_commands;
+
+	// Draws the current LOD as meshlets culled on the GPU: with a task and a mesh shader when the device has them
+	// (and bindless textures), otherwise a compute pass compacts the visible triangles into a per image index buffer.
+	// meshlets_enabled has to be set before Create(), meshlet_mesh before CreateMeshletResources().
+	bool meshlets_enabled = false;
+	bool mesh_shader_enabled = false;
+	vkpg::MeshletMesh meshlet_mesh;
+
+	// Model space culling inputs, set every frame before recording
+	std::array<glm::vec4, 6> meshlet_frustum_planes{};
+	glm::vec3 meshlet_camera_position{};
+	bool meshlet_frustum_culling = true;
+	bool meshlet_cone_culling = true;
+
+	// Counted by the GPU, read back when the image is recorded again
+	uint32_t visible_meshlets = 0;
+	uint32_t visible_triangles = 0;
 
 	std::vector<VkImage> images;
 	VkExtent2D extent;
 
 	std::vector<VkDeviceMemory> uniform_buffers_memory;
 
-	VkDescriptorPool descriptor_pool;
 	VkDescriptorPool ui_descriptor_pool;
 
+	vkpg::DescriptorLayoutCache descriptor_layout_cache;
+	vkpg::DescriptorAllocator descriptor_allocator;
+
+	// Transient sets that live for one frame of the matching swap chain image
+	std::vector<vkpg::DescriptorAllocator> frame_descriptor_allocators;
+
 	VkRenderPass render_pass;
 	VkRenderPass ui_render_pass;
 
 	VkPipelineCache pipeline_cache{nullptr};
+	vkpg::PipelineCache pipelines;
+	vkpg::MipGenerator mip_generator;
+
+	// The first material is compiled right away and is the fallback, the others are compiled in the background
+	std::vector<vkpg::Material> materials;
+	// The material the scene is drawn with, the first one is used until its pipeline is ready
+	size_t active_material = 0;
 
 	uint32_t image_count{};
 
+	// Requested tier, set before Create(). msaa_samples and fxaa_enabled are what is actually used.
+	vkpg::AntiAliasing anti_aliasing;
 	VkSampleCountFlagBits msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+	bool fxaa_enabled = false;
+
+	// The scene goes to an offscreen target at render_scale * extent and is upscaled into the swap chain image
+	// before the UI pass. Has to be set before Create(), it is turned off if the surface format can't be blitted.
+	bool dynamic_resolution_enabled = false;
+	float render_scale = 1.0f;
+
+	// The scene pass also writes UniformBufferObject::object_id into a multisampled R32_UINT attachment, which
+	// RequestObjectId reads from. Has to be set before Create(), MSAA is lowered to what the device can sample.
+	bool object_id_enabled = false;
+
+	// Draws the UI as a second subpass of the scene render pass instead of in ui_render_pass, which saves storing
+	// the swap chain image and loading it again. Has to be set before Create(), not available with dynamic resolution.
+	bool ui_subpass_enabled = false;
+
+	// Renders with vkCmdBeginRendering and synchronization2 barriers instead of render passes and framebuffers, so
+	// pipelines only depend on attachment formats. Has to be set before Create(), it is turned off if the device
+	// lacks either and turns the UI subpass off.
+	bool dynamic_rendering_enabled = false;
+
+	// Runs the compute meshlet culling on the dedicated compute queue. Has to be set before Create(), it is turned
+	// off without such a queue or without compute culling.
+	bool async_compute_enabled = false;
+
+	vkpg::GpuProfiler profiler;
+	// Render extent every image was last recorded at, the profiler's results of an image come from that recording
+	std::vector<VkExtent2D> recorded_render_extents;
+	// Screenshots and image sequences of the scene, without the UI
+	vkpg::FrameCapture capture;
+	// The frame's graphics submission has to wait on its semaphore
+	vkpg::AsyncCompute async_compute;
+
+	// Stores the scene depth and reduces it into a min/max pyramid after the scene pass, for occlusion culling and
+	// screen space effects of the next passes and frames. Has to be set before Create(), it is turned off if the
+	// device can't sample the depth format or store rg32f, and limits MSAA to sample counts depth can be sampled with.
+	bool depth_pyramid_enabled = false;
+	// Rebuilt every frame, readers in compute and fragment shaders are synchronized with
+	vkpg::DepthPyramid depth_pyramid;
 
 	std::vector<VkFramebuffer> ui_framebuffers;
 
@@ -180,17 +307,56 @@ private:
 	VkSurfaceKHR& surface;
 
 	VkFormat image_format;
+	VkFormat depth_format;
 
 	std::vector<VkImageView> image_views;
 	std::vector<VkFramebuffer> framebuffers;
 
-	VkImage depth_image;
-	VkDeviceMemory depth_image_memory;
-	VkImageView depth_image_view;
-
-	VkImage color_image;
-	VkDeviceMemory color_image_memory;
-	VkImageView color_image_view;
+	// Owned by the render graph instead when AreAttachmentsAliased, unless the depth pyramid reads it
+	VkImage depth_image{VK_NULL_HANDLE};
+	VkDeviceMemory depth_image_memory{VK_NULL_HANDLE};
+	VkImageView depth_image_view{VK_NULL_HANDLE};
+
+	// Only there with MSAA, and like depth only without AreAttachmentsAliased
+	VkImage color_image{VK_NULL_HANDLE};
+	VkDeviceMemory color_image_memory{VK_NULL_HANDLE};
+	VkImageView color_image_view{VK_NULL_HANDLE};
+
+	// Presented frames since the attachments were created, their memory is reported once it reaches the constant
+	static constexpr uint32_t attachment_memory_report_frames = 60;
+	uint32_t frames_since_attachments = 0;
+
+	VkImage scene_image{VK_NULL_HANDLE};
+	VkDeviceMemory scene_image_memory{VK_NULL_HANDLE};
+	VkImageView scene_image_view{VK_NULL_HANDLE};
+
+	// Passes up to the UI: the scene pass with dynamic rendering, FXAA and the copy into the swap chain image
+	vkpg::RenderGraph render_graph;
+	vkpg::RenderGraph::Resource graph_swap_chain_image = 0;
+	// Attachments of the scene pass, the target is the swap chain image or the offscreen scene image
+	vkpg::RenderGraph::Resource graph_scene_target = 0;
+	vkpg::RenderGraph::Resource graph_color_image = 0;
+	vkpg::RenderGraph::Resource graph_depth_image = 0;
+	// FXAA output, a float format because sRGB formats can't be stored to
+	vkpg::RenderGraph::Resource graph_fxaa_image = 0;
+	// Per frame inputs of the graph's passes, set before it is executed
+	uint32_t graph_image_index = 0;
+	VkExtent2D graph_render_extent{};
+
+	VkDescriptorSetLayout fxaa_descriptor_set_layout{VK_NULL_HANDLE};
+	VkPipelineLayout fxaa_pipeline_layout{VK_NULL_HANDLE};
+	VkPipeline fxaa_pipeline{VK_NULL_HANDLE};
+	VkSampler fxaa_sampler{VK_NULL_HANDLE};
+
+	// The surface format can be blitted into with linear filtering, needed for dynamic resolution and FXAA
+	bool blit_supported = false;
+
+	// Swap chain images can be copied from, needed for capturing
+	bool capture_usage_supported = false;
+
+	VkImage object_id_image{VK_NULL_HANDLE};
+	VkDeviceMemory object_id_image_memory{VK_NULL_HANDLE};
+	VkImageView object_id_image_view{VK_NULL_HANDLE};
 
 	std::vector<VkBuffer> uniform_buffers;
 
@@ -203,7 +369,6 @@ private:
 
 	VkDescriptorSetLayout descriptor_set_layout;
 	VkPipelineLayout pipeline_layout;
-	VkPipeline graphics_pipeline;
 
 	VkImageView texture_image_view;
 	VkSampler texture_sampler;
@@ -212,6 +377,88 @@ private:
 	VkImage texture_image;
 	VkDeviceMemory texture_image_memory;
 
+	VkDescriptorSetLayout bindless_descriptor_set_layout{VK_NULL_HANDLE};
+	VkDescriptorPool bindless_descriptor_pool{VK_NULL_HANDLE};
+	VkDescriptorSet bindless_descriptor_set{VK_NULL_HANDLE};
+	uint32_t bindless_texture_capacity{};
+	uint32_t bindless_texture_count{};
+	uint32_t texture_material_index{};
+
+	VkBuffer indirect_buffer{VK_NULL_HANDLE};
+	VkDeviceMemory indirect_buffer_memory{VK_NULL_HANDLE};
+
+	VkDescriptorSetLayout meshlet_descriptor_set_layout{VK_NULL_HANDLE};
+	VkPipelineLayout meshlet_cull_pipeline_layout{VK_NULL_HANDLE};
+	VkPipelineLayout meshlet_pipeline_layout{VK_NULL_HANDLE};
+	VkPipeline meshlet_cull_pipeline{VK_NULL_HANDLE};
+	VkPipeline meshlet_pipeline{VK_NULL_HANDLE};
+
+	VkBuffer meshlet_buffer{VK_NULL_HANDLE};
+	VkDeviceMemory meshlet_buffer_memory{VK_NULL_HANDLE};
+	VkBuffer meshlet_vertex_buffer{VK_NULL_HANDLE};
+	VkDeviceMemory meshlet_vertex_buffer_memory{VK_NULL_HANDLE};
+	VkBuffer meshlet_triangle_buffer{VK_NULL_HANDLE};
+	VkDeviceMemory meshlet_triangle_buffer_memory{VK_NULL_HANDLE};
+
+	// Per swap chain image, the draw buffers stay mapped
+	std::vector<VkBuffer> culled_index_buffers;
+	std::vector<VkDeviceMemory> culled_index_buffers_memory;
+	std::vector<VkBuffer> meshlet_draw_buffers;
+	std::vector<VkDeviceMemory> meshlet_draw_buffers_memory;
+	std::vector<vkpg::MeshletDrawData*> meshlet_draw_data;
+	std::vector<VkDescriptorSet> meshlet_descriptor_sets;
+	// With async compute, whether the graphics queue released the image's culling results to the compute queue
+	std::vector<bool> meshlet_results_released;
+
+	VkDescriptorSetLayout pick_descriptor_set_layout{VK_NULL_HANDLE};
+	VkPipelineLayout pick_pipeline_layout{VK_NULL_HANDLE};
+
+	// Per swap chain image, one mapped uint each. pick_pending marks the ones a readback was recorded into.
+	std::vector<VkBuffer> pick_buffers;
+	std::vector<VkDeviceMemory> pick_buffers_memory;
+	std::vector<uint32_t*> pick_data;
+	std::vector<bool> pick_pending;
+
+	std::optional<VkOffset2D> requested_pick;
+	std::optional<uint32_t> picked_object_id;
+
+	// Lowers the requested tier to what the device and the enabled features allow
+	void ChooseAntiAliasing();
+	uint32_t GetObjectIdAttachment() const;
+	// With the stencil aspect for formats that have one, layout transitions have to cover both
+	VkImageAspectFlags GetDepthAspect() const;
+	// Color, depth, scene and object ID images and the render graph with its images
+	void DestroyAttachments();
+
+	// Fills in the state that depends on the render pass and the anti-aliasing tier
+	vkpg::PipelineState GetTargetPipelineState(vkpg::PipelineState state, VkPipelineLayout layout) const;
+	// The pipelines the scene pass draws with, rebuilt when the render pass changes
+	void CreateScenePipelines();
+	// Polls the materials that are still compiling, called once per frame
+	void UpdateMaterialPipelines();
+	const vkpg::Material& GetDrawMaterial() const;
+
+	// The scene render pass, or with dynamic rendering the rendering scope of the render graph's scene pass
+	void BeginScenePass(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent);
+	void EndScenePass(VkCommandBuffer command_buffer);
+	void RecordSceneDraws(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent);
+	// Declares the scene pass and its attachments in the render graph, for dynamic rendering
+	void AddScenePass(vkpg::RenderGraph::Resource target);
+	// The graph creates the transient attachments and places them in memory with its other images. Where the device
+	// has lazily allocated memory they keep that instead, it is never committed on tilers.
+	bool AreAttachmentsAliased() const;
+	void RecordImageBarriers(VkCommandBuffer command_buffer, const std::vector<VkImageMemoryBarrier2>& barriers) const;
+
+	void RecordFxaa(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent);
+	void RecordUpscale(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent, VkImage source);
+
+	vkpg::MeshLod GetCurrentLod() const;
+
+	vkpg::MeshletConstants GetMeshletConstants() const;
+	void RecordMeshletCulling(VkCommandBuffer command_buffer, uint32_t image_index);
+
+	void RecordObjectIdReadback(VkCommandBuffer command_buffer, uint32_t image_index, VkExtent2D render_extent);
+
 	template <typename T>
 	void CreateVkBuffer(vkpg::VulkanDevice& vulkan_device, const std::vector<T>& input, VkBuffer& buffer,
 	                    VkDeviceMemory& buffer_memory, VkBufferUsageFlags usage_flags)
@@ -225,9 +472,9 @@ private:
 		                           staging_buffer, staging_buffer_memory);
 
 		void *data;
-		vkMapMemory(vulkan_device.logical_device, staging_buffer_memory, 0, buffer_size, 0, &data);
+		vulkan_device.dispatch.map_memory(vulkan_device.logical_device, staging_buffer_memory, 0, buffer_size, 0, &data);
 		std::memcpy(data, input.data(), static_cast<size_t>(buffer_size));
-		vkUnmapMemory(vulkan_device.logical_device, staging_buffer_memory);
+		vulkan_device.dispatch.unmap_memory(vulkan_device.logical_device, staging_buffer_memory);
 
 		vulkan_device.CreateBuffer(buffer_size, usage_flags | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
 		                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, buffer, buffer_memory);
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan_core.h>
 
 #include <experimental/source_location>
+#include <functional>
 #include <stdexcept>
 #include <string>
 #include <vector>
@@ -36,4 +37,10 @@ inline void glfwError(const std::string& message, const std::experimental::sourc
 	Error(message + "(" + error_description + ")", location);
 }
 
+template <typename T>
+inline void HashCombine(size_t& seed, const T& value)
+{
+	seed ^= std::hash<T>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
 std::vector<char> ReadFile(const std::string& filename);
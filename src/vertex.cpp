@@ -0,0 +1,98 @@
+#include "vertex.hpp"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+glm::mat4 vkpg::CompactMesh::GetDequantizationMatrix() const
+{
+	auto size = bounds_max - bounds_min;
+	for(int i = 0; i < 3; i++)
+	{
+		// Flat axis, every quantized coordinate is 0 there
+		if(size[i] <= 0.0f)
+		{
+			size[i] = 1.0f;
+		}
+	}
+
+	return glm::scale(glm::translate(glm::mat4(1.0f), bounds_min), size);
+}
+
+vkpg::CompactMesh vkpg::CompressVertices(const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& normals)
+{
+	CompactMesh mesh;
+	mesh.vertices.resize(vertices.size());
+
+	if(vertices.empty())
+	{
+		return mesh;
+	}
+
+	mesh.bounds_min = mesh.bounds_max = vertices.front().position;
+	for(const auto& vertex : vertices)
+	{
+		mesh.bounds_min = glm::min(mesh.bounds_min, vertex.position);
+		mesh.bounds_max = glm::max(mesh.bounds_max, vertex.position);
+	}
+
+	auto size = mesh.bounds_max - mesh.bounds_min;
+	auto inverse_size = glm::vec3(size.x > 0.0f ? 1.0f / size.x : 0.0f,
+	                              size.y > 0.0f ? 1.0f / size.y : 0.0f,
+	                              size.z > 0.0f ? 1.0f / size.z : 0.0f);
+
+	for(size_t i = 0; i < vertices.size(); i++)
+	{
+		const auto& vertex = vertices[i];
+		auto& compact_vertex = mesh.vertices[i];
+
+		auto position = glm::clamp((vertex.position - mesh.bounds_min) * inverse_size, 0.0f, 1.0f);
+		compact_vertex.position[0] = glm::packUnorm1x16(position.x);
+		compact_vertex.position[1] = glm::packUnorm1x16(position.y);
+		compact_vertex.position[2] = glm::packUnorm1x16(position.z);
+		compact_vertex.position[3] = 0;
+
+		auto normal = EncodeOctahedral(normals.empty() ? glm::vec3(0.0f) : normals[i]);
+		compact_vertex.normal[0] = static_cast<int16_t>(glm::packSnorm1x16(normal.x));
+		compact_vertex.normal[1] = static_cast<int16_t>(glm::packSnorm1x16(normal.y));
+
+		compact_vertex.texture_coordinates[0] = glm::packHalf1x16(vertex.texture_coordinates.x);
+		compact_vertex.texture_coordinates[1] = glm::packHalf1x16(vertex.texture_coordinates.y);
+	}
+
+	return mesh;
+}
+
+glm::vec2 vkpg::EncodeOctahedral(glm::vec3 normal)
+{
+	auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if(length == 0.0f)
+	{
+		return {0.0f, 0.0f};
+	}
+
+	normal /= length;
+
+	glm::vec2 encoded{normal.x, normal.y};
+	if(normal.z < 0.0f)
+	{
+		// Fold the lower hemisphere over the diagonals
+		encoded.x = (1.0f - std::abs(normal.y)) * (normal.x >= 0.0f ? 1.0f : -1.0f);
+		encoded.y = (1.0f - std::abs(normal.x)) * (normal.y >= 0.0f ? 1.0f : -1.0f);
+	}
+
+	return encoded;
+}
+
+glm::vec3 vkpg::DecodeOctahedral(glm::vec2 encoded)
+{
+	glm::vec3 normal{encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y)};
+
+	auto t = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -t : t;
+	normal.y += normal.y >= 0.0f ? -t : t;
+
+	return glm::normalize(normal);
+}
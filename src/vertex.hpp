@@ -0,0 +1,129 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace vkpg
+{
+
+struct Vertex
+{
+	glm::vec3 position;
+	glm::vec3 color;
+	glm::vec2 texture_coordinates;
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription binding_description{};
+		binding_description.binding = 0;
+		binding_description.stride = sizeof(Vertex);
+		binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return binding_description;
+	}
+
+	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
+
+		attribute_descriptions[0].binding = 0;
+		attribute_descriptions[0].location = 0;
+		attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attribute_descriptions[0].offset = offsetof(Vertex, position);
+
+		attribute_descriptions[1].binding = 0;
+		attribute_descriptions[1].location = 1;
+		attribute_descriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
+		attribute_descriptions[1].offset = offsetof(Vertex, color);
+
+		attribute_descriptions[2].binding = 0;
+		attribute_descriptions[2].location = 2;
+		attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
+		attribute_descriptions[2].offset = offsetof(Vertex, texture_coordinates);
+
+		return attribute_descriptions;
+	}
+
+	bool operator==(const Vertex& other) const
+	{
+		return position == other.position && color == other.color && texture_coordinates == other.texture_coordinates;
+	}
+};
+
+// 16 bytes instead of 32: position is unorm16 inside the mesh bounds, the normal is octahedral snorm16,
+// texture coordinates are half floats and the constant color is dropped
+struct CompactVertex
+{
+	uint16_t position[4];
+	int16_t normal[2];
+	uint16_t texture_coordinates[2];
+
+	static VkVertexInputBindingDescription GetBindingDescription()
+	{
+		VkVertexInputBindingDescription binding_description{};
+		binding_description.binding = 0;
+		binding_description.stride = sizeof(CompactVertex);
+		binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+		return binding_description;
+	}
+
+	// Locations match Vertex where they overlap, the normal takes the color's place
+	static std::array<VkVertexInputAttributeDescription, 3> GetAttributeDescriptions()
+	{
+		std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
+
+		attribute_descriptions[0].binding = 0;
+		attribute_descriptions[0].location = 0;
+		attribute_descriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+		attribute_descriptions[0].offset = offsetof(CompactVertex, position);
+
+		attribute_descriptions[1].binding = 0;
+		attribute_descriptions[1].location = 1;
+		attribute_descriptions[1].format = VK_FORMAT_R16G16_SNORM;
+		attribute_descriptions[1].offset = offsetof(CompactVertex, normal);
+
+		attribute_descriptions[2].binding = 0;
+		attribute_descriptions[2].location = 2;
+		attribute_descriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+		attribute_descriptions[2].offset = offsetof(CompactVertex, texture_coordinates);
+
+		return attribute_descriptions;
+	}
+};
+
+static_assert(sizeof(CompactVertex) == 16);
+
+struct CompactMesh
+{
+	std::vector<CompactVertex> vertices;
+
+	// Quantized positions are relative to these bounds
+	glm::vec3 bounds_min{0.0f};
+	glm::vec3 bounds_max{0.0f};
+
+	// Maps unorm positions back to model space, goes in front of the model matrix
+	glm::mat4 GetDequantizationMatrix() const;
+};
+
+// normals is either empty or has one entry per vertex
+CompactMesh CompressVertices(const std::vector<Vertex>& vertices, const std::vector<glm::vec3>& normals);
+
+glm::vec2 EncodeOctahedral(glm::vec3 normal);
+glm::vec3 DecodeOctahedral(glm::vec2 encoded);
+
+} // namespace vkpg
+
+namespace std {
+template<> struct hash<vkpg::Vertex>
+	{
+		size_t operator()(vkpg::Vertex const& vertex) const
+		{
+			return ((hash<glm::vec3>()(vertex.position) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texture_coordinates) << 1);
+		}
+	};
+} // namespace std
@@ -19,6 +19,13 @@ void error_callback(int code, const char* description)
     std::cout << "code=" << code << " description=" << description << std::endl;
 }
 
+void vkpg::VulkanWindow::SetFixedSize(uint32_t width, uint32_t height)
+{
+	this->width = width;
+	this->height = height;
+	resizable = false;
+}
+
 void vkpg::VulkanWindow::Init()
 {
 	if(glfwInit() == GLFW_FALSE)
@@ -35,6 +42,9 @@ void vkpg::VulkanWindow::Init()
 
 	// Don't create an OpenGL context
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+	glfwWindowHint(GLFW_RESIZABLE, resizable ? GLFW_TRUE : GLFW_FALSE);
+	// A fixed size is meant in pixels, so a Retina display doesn't double the framebuffer
+	glfwWindowHint(GLFW_COCOA_RETINA_FRAMEBUFFER, resizable ? GLFW_TRUE : GLFW_FALSE);
 
 	window = glfwCreateWindow(width, height, "Vulkan Playground", nullptr, nullptr);
 	if(window == nullptr)
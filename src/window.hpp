@@ -18,6 +18,8 @@ public:
 	using CursorPositionCallbackFunction = std::function<void(void*, int, int)>;
 
 	VulkanWindow(vkpg::VulkanSwapChain& swap_chain, VkSurfaceKHR& surface, const VkInstance& instance);
+	// Before Init, the window gets exactly this size and can't be resized
+	void SetFixedSize(uint32_t width, uint32_t height);
 	void Init();
 	void CreateSurface();
 	void Cleanup();
@@ -55,6 +57,7 @@ private:
 
 	uint32_t width = 800;
 	uint32_t height = 600;
+	bool resizable = true;
 };
 
 } // namespace vkpg